@@ -0,0 +1,38 @@
+project "JobSystemBenchmark"
+    kind "ConsoleApp"
+    language "C++"
+    cppdialect "C++20"
+    staticruntime "on"
+    location "%{wks.location}/%{prj.name}"
+    targetdir "%{wks.location}/Bin/%{cfg.buildcfg}"
+
+    files {
+        "**.h",
+        "**.cpp",
+    }
+
+    dependson {
+        "Core",
+    }
+
+    links {
+        "Core",
+    }
+
+    includedirs {
+        enginepath(""),
+        enginepath("Core"),
+        thirdpartypath("spdlog/include"),
+        thirdpartypath("mpmc/include"),
+    }
+
+    filter "system:windows"
+        systemversion "latest"
+
+    filter "configurations:Debug"
+        runtime "Debug"
+        symbols "on"
+
+    filter "configurations:Release"
+        runtime "Release"
+        optimize "on"
@@ -0,0 +1,438 @@
+#include "CoreCommon.h"
+
+#include <chrono>
+
+import HorizonEngine.Core;
+
+#define HE_JOB_SYSTEM_NUM_FIBIERS 256
+#define HE_JOB_SYSTEM_FIBER_STACK_SIZE (HE_JOB_SYSTEM_NUM_FIBIERS * 1024)
+
+using namespace HE;
+
+/**
+ * Compares the single shared job queue with per-worker work-stealing deques as job granularity shrinks.
+ * The total amount of work is fixed, only the number of iterations per job changes.
+ */
+
+static constexpr uint64 TotalWorkIterations = 1ull << 26;
+static constexpr uint32 JobsPerBatch = JOB_SYSTEM_WORKER_QUEUE_CAPACITY;
+static constexpr uint32 NumRepeats = 5;
+
+struct SpinJobData
+{
+    uint64 iterations;
+    uint64 result;
+};
+
+static void SpinJob(void* data)
+{
+    SpinJobData* spinJobData = (SpinJobData*)data;
+    uint64 x = spinJobData->iterations;
+    for (uint64 i = 0; i < spinJobData->iterations; i++)
+    {
+        x = x * 6364136223846793005ull + 1442695040888963407ull;
+    }
+    spinJobData->result = x;
+}
+
+struct ForkJobData
+{
+    uint32 numJobs;
+    JobSystemJobDecl* jobDecls;
+};
+
+static void ForkJob(void* data)
+{
+    ForkJobData* forkJobData = (ForkJobData*)data;
+
+    // Submitted from a worker, so with work stealing enabled the jobs land in this worker's deque.
+    // Batches are sized to fit in the deque so that none of them overflow into the shared queue.
+    for (uint32 first = 0; first < forkJobData->numJobs; first += JobsPerBatch)
+    {
+        const uint32 count = Math::Min(JobsPerBatch, forkJobData->numJobs - first);
+        JobSystemAtomicCounterHandle counter = JobSystemRunJobs(forkJobData->jobDecls + first, count);
+        JobSystemWaitForCounterAndFree(counter, 0);
+    }
+}
+
+static double RunOnce(uint64 iterationsPerJob)
+{
+    const uint32 numJobs = (uint32)(TotalWorkIterations / iterationsPerJob);
+
+    std::vector<SpinJobData> spinJobData(numJobs, SpinJobData{ iterationsPerJob, 0 });
+    std::vector<JobSystemJobDecl> jobDecls(numJobs);
+    for (uint32 i = 0; i < numJobs; i++)
+    {
+        jobDecls[i] = { SpinJob, &spinJobData[i] };
+    }
+
+    ForkJobData forkJobData = { numJobs, jobDecls.data() };
+    JobSystemJobDecl forkJobDecl = { ForkJob, &forkJobData };
+
+    const auto start = std::chrono::high_resolution_clock::now();
+    JobSystemAtomicCounterHandle counter = JobSystemRunJobs(&forkJobDecl, 1);
+    JobSystemWaitForCounterAndFreeWithoutFiber(counter);
+    const auto end = std::chrono::high_resolution_clock::now();
+
+    return std::chrono::duration<double, std::milli>(end - start).count();
+}
+
+static double RunBest(uint64 iterationsPerJob)
+{
+    double best = std::numeric_limits<double>::max();
+    for (uint32 repeat = 0; repeat < NumRepeats; repeat++)
+    {
+        best = Math::Min(best, RunOnce(iterationsPerJob));
+    }
+    return best;
+}
+
+/**
+ * ParallelFor (lazy binary splitting) against a hand-tuned fixed grain, on a balanced and on an imbalanced workload.
+ * In the imbalanced one the cost of an element grows linearly with its index, so fixed chunks at the end dominate.
+ */
+
+static constexpr uint32 NumElements = 1 << 20;
+
+static uint64 ElementCost(uint32 index, bool imbalanced)
+{
+    return imbalanced ? (1 + (uint64)index * 64 / NumElements) : 32;
+}
+
+static uint64 ProcessElement(uint32 index, bool imbalanced)
+{
+    uint64 x = index;
+    const uint64 cost = ElementCost(index, imbalanced);
+    for (uint64 i = 0; i < cost; i++)
+    {
+        x = x * 6364136223846793005ull + 1442695040888963407ull;
+    }
+    return x;
+}
+
+struct FixedGrainJobData
+{
+    uint32 begin;
+    uint32 end;
+    bool imbalanced;
+    uint64* results;
+};
+
+static void FixedGrainJob(void* data)
+{
+    FixedGrainJobData* jobData = (FixedGrainJobData*)data;
+    for (uint32 i = jobData->begin; i < jobData->end; i++)
+    {
+        jobData->results[i] = ProcessElement(i, jobData->imbalanced);
+    }
+}
+
+struct DataParallelJobData
+{
+    uint32 grain;
+    bool imbalanced;
+    bool useParallelFor;
+    uint64* results;
+};
+
+static void DataParallelJob(void* data)
+{
+    DataParallelJobData* jobData = (DataParallelJobData*)data;
+    uint64* results = jobData->results;
+    const bool imbalanced = jobData->imbalanced;
+
+    if (jobData->useParallelFor)
+    {
+        ParallelFor(0, NumElements, jobData->grain, [=](uint32 i)
+        {
+            results[i] = ProcessElement(i, imbalanced);
+        });
+        return;
+    }
+
+    const uint32 numJobs = CEIL_DIV(NumElements, jobData->grain);
+    std::vector<FixedGrainJobData> fixedGrainJobData(numJobs);
+    std::vector<JobSystemJobDecl> jobDecls(numJobs);
+    for (uint32 i = 0; i < numJobs; i++)
+    {
+        fixedGrainJobData[i] = { i * jobData->grain, Math::Min(NumElements, (i + 1) * jobData->grain), imbalanced, results };
+        jobDecls[i] = { FixedGrainJob, &fixedGrainJobData[i] };
+    }
+    for (uint32 first = 0; first < numJobs; first += JobsPerBatch)
+    {
+        JobSystemAtomicCounterHandle counter = JobSystemRunJobs(jobDecls.data() + first, Math::Min(JobsPerBatch, numJobs - first));
+        JobSystemWaitForCounterAndFree(counter, 0);
+    }
+}
+
+static double RunDataParallelBest(uint32 grain, bool imbalanced, bool useParallelFor)
+{
+    std::vector<uint64> results(NumElements);
+    DataParallelJobData jobData = { grain, imbalanced, useParallelFor, results.data() };
+    JobSystemJobDecl jobDecl = { DataParallelJob, &jobData };
+
+    double best = std::numeric_limits<double>::max();
+    for (uint32 repeat = 0; repeat < NumRepeats; repeat++)
+    {
+        const auto start = std::chrono::high_resolution_clock::now();
+        JobSystemAtomicCounterHandle counter = JobSystemRunJobs(&jobDecl, 1);
+        JobSystemWaitForCounterAndFreeWithoutFiber(counter);
+        const auto end = std::chrono::high_resolution_clock::now();
+        best = Math::Min(best, std::chrono::duration<double, std::milli>(end - start).count());
+    }
+    return best;
+}
+
+static void RunParallelForBenchmark()
+{
+    printf("\nParallelFor (lazy binary splitting) vs. fixed grain, %u elements (best of %u)\n", NumElements, NumRepeats);
+    printf("%12s %12s %16s %16s\n", "workload", "grain", "fixed (ms)", "ParallelFor (ms)");
+
+    for (bool imbalanced : { false, true })
+    {
+        // Hand-tuned fixed grains around the sweet spot, ParallelFor is given the same value as its minimum chunk.
+        for (uint32 grain : { 256u, 1024u, 4096u, 16384u })
+        {
+            const double fixedTime = RunDataParallelBest(grain, imbalanced, false);
+            const double parallelForTime = RunDataParallelBest(grain, imbalanced, true);
+            printf("%12s %12u %16.3f %16.3f\n", imbalanced ? "imbalanced" : "balanced", grain, fixedTime, parallelForTime);
+        }
+        printf("%12s %12s %16s %16.3f\n", imbalanced ? "imbalanced" : "balanced", "auto", "-", RunDataParallelBest(0, imbalanced, true));
+    }
+}
+
+/**
+ * Scheduler scaling: the same five workloads at 1, 2, 4, ... up to the maximum number of worker threads.
+ * Results of reference machines are kept in Results/ so that scheduler regressions show up in review.
+ */
+
+static constexpr uint32 NumEmptyJobs = 1 << 18;
+static constexpr uint32 FibonacciN = 28;
+static constexpr uint32 FibonacciSerialCutoff = 18;
+static constexpr uint32 FanOutWidth = 1024;
+static constexpr uint32 FanOutRounds = 64;
+static constexpr uint64 FanOutJobIterations = 2048;
+static constexpr uint32 NumChains = 16;
+static constexpr uint32 ChainLength = 256;
+static constexpr uint64 ChainTaskIterations = 512;
+static constexpr uint32 NumWaitRoundTrips = 16384;
+
+static void EmptyJob(void* data)
+{
+}
+
+struct EmptyJobsData
+{
+    JobSystemJobDecl* jobDecls;
+};
+
+static void EmptyJobsRootJob(void* data)
+{
+    EmptyJobsData* emptyJobsData = (EmptyJobsData*)data;
+    for (uint32 first = 0; first < NumEmptyJobs; first += JobsPerBatch)
+    {
+        JobSystemAtomicCounterHandle counter = JobSystemRunJobs(emptyJobsData->jobDecls, JobsPerBatch);
+        JobSystemWaitForCounterAndFree(counter, 0);
+    }
+}
+
+static uint64 SerialFibonacci(uint32 n)
+{
+    return (n < 2) ? n : SerialFibonacci(n - 1) + SerialFibonacci(n - 2);
+}
+
+struct FibonacciJobData
+{
+    uint32 n;
+    uint64 result;
+};
+
+static void FibonacciJob(void* data)
+{
+    FibonacciJobData* fibonacciJobData = (FibonacciJobData*)data;
+    if (fibonacciJobData->n <= FibonacciSerialCutoff)
+    {
+        fibonacciJobData->result = SerialFibonacci(fibonacciJobData->n);
+        return;
+    }
+    FibonacciJobData children[2] = { { fibonacciJobData->n - 1, 0 }, { fibonacciJobData->n - 2, 0 } };
+    JobSystemJobDecl jobDecls[2] = { { FibonacciJob, &children[0] }, { FibonacciJob, &children[1] } };
+    JobSystemAtomicCounterHandle counter = JobSystemRunJobs(jobDecls, 2);
+    JobSystemWaitForCounterAndFree(counter, 0);
+    fibonacciJobData->result = children[0].result + children[1].result;
+}
+
+static void FanOutRootJob(void* data)
+{
+    std::vector<SpinJobData> spinJobData(FanOutWidth, SpinJobData{ FanOutJobIterations, 0 });
+    std::vector<JobSystemJobDecl> jobDecls(FanOutWidth);
+    for (uint32 i = 0; i < FanOutWidth; i++)
+    {
+        jobDecls[i] = { SpinJob, &spinJobData[i] };
+    }
+    for (uint32 round = 0; round < FanOutRounds; round++)
+    {
+        JobSystemAtomicCounterHandle counter = JobSystemRunJobs(jobDecls.data(), FanOutWidth);
+        JobSystemWaitForCounterAndFree(counter, 0);
+    }
+}
+
+static void WaitLatencyRootJob(void* data)
+{
+    JobSystemJobDecl jobDecl = { EmptyJob, nullptr };
+    for (uint32 i = 0; i < NumWaitRoundTrips; i++)
+    {
+        JobSystemAtomicCounterHandle counter = JobSystemRunJobs(&jobDecl, 1);
+        JobSystemWaitForCounterAndFree(counter, 0);
+    }
+}
+
+/** Runs the job on a worker and returns the best wall time in milliseconds. */
+static double RunRootJobBest(JobSystemJobFunc jobFunc, void* data)
+{
+    JobSystemJobDecl jobDecl = { jobFunc, data };
+    double best = std::numeric_limits<double>::max();
+    for (uint32 repeat = 0; repeat < NumRepeats; repeat++)
+    {
+        const auto start = std::chrono::high_resolution_clock::now();
+        JobSystemAtomicCounterHandle counter = JobSystemRunJobs(&jobDecl, 1);
+        JobSystemWaitForCounterAndFreeWithoutFiber(counter);
+        const auto end = std::chrono::high_resolution_clock::now();
+        best = Math::Min(best, std::chrono::duration<double, std::milli>(end - start).count());
+    }
+    return best;
+}
+
+static double RunChainsBest()
+{
+    std::vector<SpinJobData> spinJobData(NumChains * ChainLength, SpinJobData{ ChainTaskIterations, 0 });
+    double best = std::numeric_limits<double>::max();
+    for (uint32 repeat = 0; repeat < NumRepeats; repeat++)
+    {
+        JobSystemTaskGraph taskGraph;
+        for (uint32 chain = 0; chain < NumChains; chain++)
+        {
+            for (uint32 i = 0; i < ChainLength; i++)
+            {
+                const JobSystemTaskHandle task = taskGraph.AddTask(SpinJob, &spinJobData[chain * ChainLength + i]);
+                if (i > 0)
+                {
+                    taskGraph.AddDependency(task - 1, task);
+                }
+            }
+        }
+
+        const auto start = std::chrono::high_resolution_clock::now();
+        JobSystemAtomicCounterHandle counter = taskGraph.Run();
+        JobSystemWaitForCounterAndFreeWithoutFiber(counter);
+        const auto end = std::chrono::high_resolution_clock::now();
+        best = Math::Min(best, std::chrono::duration<double, std::milli>(end - start).count());
+    }
+    return best;
+}
+
+static void RunScalingBenchmark(uint32 maxNumWorkerThreads, const char* csvFilename)
+{
+    printf("Scheduler scaling (best of %u)\n", NumRepeats);
+    printf("  empty:   %u empty jobs, ns per job\n", NumEmptyJobs);
+    printf("  fib:     fork/join fibonacci(%u), serial below %u, ms\n", FibonacciN, FibonacciSerialCutoff);
+    printf("  fan-out: %u rounds of %u jobs x %llu iterations, ms\n", FanOutRounds, FanOutWidth, FanOutJobIterations);
+    printf("  chains:  %u task graph chains of %u tasks x %llu iterations, ms\n", NumChains, ChainLength, ChainTaskIterations);
+    printf("  wait:    submit one empty job and JobSystemWaitForCounter on it, ns per round trip\n");
+    printf("%8s %12s %12s %12s %12s %12s\n", "workers", "empty", "fib", "fan-out", "chains", "wait");
+
+    FILE* csv = csvFilename ? fopen(csvFilename, "w") : nullptr;
+    if (csv)
+    {
+        fprintf(csv, "workers,empty_ns_per_job,fib_ms,fan_out_ms,chains_ms,wait_ns\n");
+    }
+
+    std::vector<JobSystemJobDecl> emptyJobDecls(JobsPerBatch, JobSystemJobDecl{ EmptyJob, nullptr });
+    EmptyJobsData emptyJobsData = { emptyJobDecls.data() };
+
+    for (uint32 numWorkerThreads = 1; ; numWorkerThreads = Math::Min(numWorkerThreads * 2, maxNumWorkerThreads))
+    {
+        JobSystemInit(numWorkerThreads, HE_JOB_SYSTEM_NUM_FIBIERS, HE_JOB_SYSTEM_FIBER_STACK_SIZE);
+
+        const double emptyTime = RunRootJobBest(EmptyJobsRootJob, &emptyJobsData) * 1e6 / NumEmptyJobs;
+        FibonacciJobData fibonacciJobData = { FibonacciN, 0 };
+        const double fibonacciTime = RunRootJobBest(FibonacciJob, &fibonacciJobData);
+        ASSERT(fibonacciJobData.result == SerialFibonacci(FibonacciN));
+        const double fanOutTime = RunRootJobBest(FanOutRootJob, nullptr);
+        const double chainsTime = RunChainsBest();
+        const double waitTime = RunRootJobBest(WaitLatencyRootJob, nullptr) * 1e6 / NumWaitRoundTrips;
+
+        JobSystemExit();
+
+        printf("%8u %12.1f %12.3f %12.3f %12.3f %12.1f\n", numWorkerThreads, emptyTime, fibonacciTime, fanOutTime, chainsTime, waitTime);
+        if (csv)
+        {
+            fprintf(csv, "%u,%.1f,%.3f,%.3f,%.3f,%.1f\n", numWorkerThreads, emptyTime, fibonacciTime, fanOutTime, chainsTime, waitTime);
+        }
+
+        if (numWorkerThreads == maxNumWorkerThreads)
+        {
+            break;
+        }
+    }
+
+    if (csv)
+    {
+        fclose(csv);
+    }
+}
+
+/**
+ * Usage: JobSystemBenchmark [--max-workers N] [--csv file]
+ * --max-workers defaults to the number of logical processors. --csv also writes the scaling results to a file.
+ */
+int main(int argc, char** argv)
+{
+    LogSystemInit();
+
+    uint32 numWorkerThreads = GetNumberOfProcessors();
+    const char* csvFilename = nullptr;
+    for (int i = 1; i < argc; i++)
+    {
+        if (strcmp(argv[i], "--max-workers") == 0 && i + 1 < argc)
+        {
+            numWorkerThreads = (uint32)atoi(argv[++i]);
+        }
+        else if (strcmp(argv[i], "--csv") == 0 && i + 1 < argc)
+        {
+            csvFilename = argv[++i];
+        }
+    }
+    // Every worker holds a fiber, the rest of the pool is left for waiting jobs.
+    numWorkerThreads = Math::Clamp(numWorkerThreads, 1u, Math::Min((uint32)JOB_SYSTEM_MAX_NUM_WORKER_THREADS, (uint32)HE_JOB_SYSTEM_NUM_FIBIERS / 2));
+
+    RunScalingBenchmark(numWorkerThreads, csvFilename);
+    printf("\n");
+
+    JobSystemInit(numWorkerThreads, HE_JOB_SYSTEM_NUM_FIBIERS, HE_JOB_SYSTEM_FIBER_STACK_SIZE);
+
+    printf("Job granularity scaling, %u worker threads, %llu total iterations (best of %u)\n", numWorkerThreads, TotalWorkIterations, NumRepeats);
+    printf("%16s %10s %16s %16s %10s\n", "iterations/job", "jobs", "global (ms)", "stealing (ms)", "speedup");
+
+    for (uint64 iterationsPerJob = 1ull << 16; iterationsPerJob >= (1ull << 6); iterationsPerJob >>= 2)
+    {
+        JobSystemSetWorkStealingEnabled(false);
+        const double globalQueueTime = RunBest(iterationsPerJob);
+
+        JobSystemSetWorkStealingEnabled(true);
+        const double workStealingTime = RunBest(iterationsPerJob);
+
+        printf("%16llu %10llu %16.3f %16.3f %9.2fx\n",
+            iterationsPerJob,
+            TotalWorkIterations / iterationsPerJob,
+            globalQueueTime,
+            workStealingTime,
+            globalQueueTime / workStealingTime);
+    }
+
+    RunParallelForBenchmark();
+
+    JobSystemExit();
+    LogSystemExit();
+    return 0;
+}
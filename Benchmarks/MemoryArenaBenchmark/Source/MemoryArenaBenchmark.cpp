@@ -0,0 +1,238 @@
+#include "CoreCommon.h"
+
+#include <chrono>
+#include <thread>
+
+import HorizonEngine.Core;
+
+using namespace HE;
+
+/**
+ * Compares PoolArena with HeapArena (_aligned_malloc) on the allocation patterns of engine objects:
+ * render graph nodes and render commands that are allocated one at a time and freed together,
+ * and long-lived objects of mixed sizes that are allocated and freed in random order.
+ * Compares TlsfArena with HeapArena on asset data loaded and unloaded over a long session.
+ */
+
+static constexpr uint32 NumRepeats = 5;
+
+/** Sizes seen in a frame of the default render pipeline: commands, passes with their lambdas, textures and buffers. */
+static constexpr uint64 FrameObjectSizes[] = { 48, 64, 96, 160, 256, 416, 640, 1024 };
+static constexpr uint32 NumFrameObjects = 4096;
+static constexpr uint32 NumFrames = 64;
+
+static constexpr uint32 NumChurnOperations = 1 << 20;
+static constexpr uint32 MaxNumLiveObjects = 4096;
+
+struct Allocation
+{
+    void* ptr;
+    uint64 size;
+};
+
+static uint32 NextRandom(uint32& state)
+{
+    state = state * 1664525u + 1013904223u;
+    return state >> 8;
+}
+
+/** Allocates a frame worth of objects, then frees all of them, like a render graph does between Execute() and Clear(). */
+static void RunFrames(MemoryArena* arena, uint32 seed)
+{
+    std::vector<Allocation> allocations(NumFrameObjects);
+    uint32 random = seed;
+    for (uint32 frame = 0; frame < NumFrames; frame++)
+    {
+        for (Allocation& allocation : allocations)
+        {
+            allocation.size = FrameObjectSizes[NextRandom(random) % std::size(FrameObjectSizes)];
+            allocation.ptr = HE_ARENA_ALLOC(arena, allocation.size);
+            *(uint8*)allocation.ptr = (uint8)frame;
+        }
+        for (auto it = allocations.rbegin(); it != allocations.rend(); ++it)
+        {
+            HE_ARENA_FREE(arena, it->ptr, it->size);
+        }
+    }
+}
+
+/** Random allocations and frees of 16 to 2048 bytes around a steady number of live objects. */
+static void RunChurn(MemoryArena* arena, uint32 seed)
+{
+    std::vector<Allocation> live;
+    live.reserve(MaxNumLiveObjects);
+    uint32 random = seed;
+    for (uint32 i = 0; i < NumChurnOperations; i++)
+    {
+        const uint32 r = NextRandom(random);
+        if (live.empty() || (live.size() < MaxNumLiveObjects && (r & 1)))
+        {
+            const uint64 size = 16 + (r >> 1) % 2033;
+            void* ptr = HE_ARENA_ALLOC(arena, size);
+            *(uint8*)ptr = (uint8)i;
+            live.push_back({ ptr, size });
+        }
+        else
+        {
+            const uint32 index = (r >> 1) % (uint32)live.size();
+            HE_ARENA_FREE(arena, live[index].ptr, live[index].size);
+            live[index] = live.back();
+            live.pop_back();
+        }
+    }
+    for (const Allocation& allocation : live)
+    {
+        HE_ARENA_FREE(arena, allocation.ptr, allocation.size);
+    }
+}
+
+using WorkloadFunc = void(*)(MemoryArena* arena, uint32 seed);
+
+/** Runs the workload on numThreads threads at once, all sharing the arena. Returns ns per allocation and free pair. */
+static double RunOnce(MemoryArena* arena, WorkloadFunc workload, uint32 numThreads, uint64 numPairsPerThread)
+{
+    std::vector<std::thread> threads;
+    const auto start = std::chrono::high_resolution_clock::now();
+    for (uint32 i = 0; i < numThreads; i++)
+    {
+        threads.emplace_back(workload, arena, i * 7919 + 1);
+    }
+    for (std::thread& thread : threads)
+    {
+        thread.join();
+    }
+    const auto end = std::chrono::high_resolution_clock::now();
+    return std::chrono::duration<double, std::nano>(end - start).count() / (double)numPairsPerThread;
+}
+
+static double RunBest(MemoryArena* arena, WorkloadFunc workload, uint32 numThreads, uint64 numPairsPerThread)
+{
+    double best = std::numeric_limits<double>::max();
+    for (uint32 repeat = 0; repeat < NumRepeats; repeat++)
+    {
+        best = Math::Min(best, RunOnce(arena, workload, numThreads, numPairsPerThread));
+    }
+    return best;
+}
+
+static void RunWorkload(const char* workloadName, WorkloadFunc workload, uint64 numPairsPerThread, uint32 maxNumThreads)
+{
+    printf("\n%s, ns per alloc/free pair and thread (best of %u)\n", workloadName, NumRepeats);
+    printf("%8s %14s %14s %10s\n", "threads", "HeapArena", "PoolArena", "speedup");
+    HeapArena heapArena("BenchmarkHeapArena");
+    PoolArena poolArena("BenchmarkPoolArena");
+    for (uint32 numThreads = 1; numThreads <= maxNumThreads; numThreads *= 2)
+    {
+        const double heapTime = RunBest(&heapArena, workload, numThreads, numPairsPerThread);
+        const double poolTime = RunBest(&poolArena, workload, numThreads, numPairsPerThread);
+        printf("%8u %14.1f %14.1f %9.2fx\n", numThreads, heapTime, poolTime, heapTime / poolTime);
+    }
+    printf("PoolArena reserved %llu KB\n", poolArena.Reserved() / 1024);
+}
+
+static constexpr uint32 NumAssetOperations = 1 << 18;
+static constexpr uint32 NumLiveAssets = 512;
+static constexpr uint64 MinAssetSize = 1024;
+static constexpr uint32 AssetSizeRangeLog2 = 12;
+static constexpr uint32 NumStreamingSteps = 4;
+
+/**
+ * Keeps NumLiveAssets assets of 1 KB to 4 MB (log-uniform) loaded, unloading a random one and loading another per operation.
+ * Every fourth asset is streamed in, growing with ArenaRealloc() in NumStreamingSteps steps as its data arrives.
+ */
+static void RunAssetChurn(MemoryArena* arena, uint32 seed)
+{
+    std::vector<Allocation> assets(NumLiveAssets, Allocation{ nullptr, 0 });
+    uint32 random = seed;
+    for (uint32 i = 0; i < NumAssetOperations; i++)
+    {
+        Allocation& asset = assets[NextRandom(random) % NumLiveAssets];
+        if (asset.ptr)
+        {
+            HE_ARENA_FREE(arena, asset.ptr, asset.size);
+        }
+        const uint32 r = NextRandom(random);
+        const uint64 size = (MinAssetSize << (r % AssetSizeRangeLog2)) + (r >> 4) % (MinAssetSize << (r % AssetSizeRangeLog2));
+        if ((r >> 20) % 4 == 0)
+        {
+            asset = { nullptr, 0 };
+            for (uint32 step = 1; step <= NumStreamingSteps; step++)
+            {
+                const uint64 newSize = size * step / NumStreamingSteps;
+                asset.ptr = HE_ARENA_REALLOC(arena, asset.ptr, asset.size, newSize);
+                asset.size = newSize;
+                ((uint8*)asset.ptr)[newSize - 1] = (uint8)step;
+            }
+        }
+        else
+        {
+            asset = { HE_ARENA_ALLOC(arena, size), size };
+        }
+        *(uint8*)asset.ptr = (uint8)i;
+    }
+    for (const Allocation& asset : assets)
+    {
+        HE_ARENA_FREE(arena, asset.ptr, asset.size);
+    }
+}
+
+static void RunAssetChurnBenchmark()
+{
+    printf("\nAsset churn, %u live assets of %llu KB to %llu MB, ns per unload/load (best of %u)\n",
+        NumLiveAssets, MinAssetSize / 1024, (MinAssetSize << AssetSizeRangeLog2) / (1024 * 1024), NumRepeats);
+    printf("%14s %14s %10s\n", "HeapArena", "TlsfArena", "speedup");
+    HeapArena heapArena("BenchmarkHeapArena");
+    TlsfArena tlsfArena("BenchmarkTlsfArena", 256ull * 1024 * 1024);
+    const double heapTime = RunBest(&heapArena, RunAssetChurn, 1, NumAssetOperations);
+    const double tlsfTime = RunBest(&tlsfArena, RunAssetChurn, 1, NumAssetOperations);
+    printf("%14.1f %14.1f %9.2fx\n", heapTime, tlsfTime, heapTime / tlsfTime);
+
+    // Fragmentation after a long session of churn followed by unloading every other asset, e.g. when switching levels.
+    std::vector<Allocation> assets(NumLiveAssets, Allocation{ nullptr, 0 });
+    uint32 random = 1;
+    for (uint32 i = 0; i < NumAssetOperations; i++)
+    {
+        Allocation& asset = assets[NextRandom(random) % NumLiveAssets];
+        HE_ARENA_FREE(&tlsfArena, asset.ptr, asset.size);
+        const uint32 r = NextRandom(random);
+        asset.size = (MinAssetSize << (r % AssetSizeRangeLog2)) + (r >> 4) % (MinAssetSize << (r % AssetSizeRangeLog2));
+        asset.ptr = HE_ARENA_ALLOC(&tlsfArena, asset.size);
+    }
+    for (uint32 i = 0; i < NumLiveAssets; i += 2)
+    {
+        HE_ARENA_FREE(&tlsfArena, assets[i].ptr, assets[i].size);
+        assets[i] = { nullptr, 0 };
+    }
+    const TlsfArenaStats stats = tlsfArena.GetStats();
+    printf("TlsfArena: %u pools, %llu MB reserved, %llu MB used in %u blocks, %llu MB free in %u blocks, largest free %llu MB, fragmentation %.3f\n",
+        stats.numPools, stats.reservedBytes >> 20, stats.usedBytes >> 20, stats.numUsedBlocks, stats.freeBytes >> 20, stats.numFreeBlocks, stats.largestFreeBlock >> 20, stats.fragmentation);
+    for (const Allocation& asset : assets)
+    {
+        HE_ARENA_FREE(&tlsfArena, asset.ptr, asset.size);
+    }
+}
+
+/**
+ * Usage: MemoryArenaBenchmark [--max-threads N]
+ * --max-threads defaults to the number of logical processors, thread counts double from 1 up to it.
+ */
+int main(int argc, char** argv)
+{
+    LogSystemInit();
+
+    uint32 maxNumThreads = GetNumberOfProcessors();
+    for (int i = 1; i < argc; i++)
+    {
+        if (strcmp(argv[i], "--max-threads") == 0 && i + 1 < argc)
+        {
+            maxNumThreads = Math::Max(1u, (uint32)atoi(argv[++i]));
+        }
+    }
+
+    RunWorkload("Frame objects, allocated then freed in reverse order", RunFrames, (uint64)NumFrames * NumFrameObjects, maxNumThreads);
+    RunWorkload("Churn, random sizes and order", RunChurn, NumChurnOperations / 2, maxNumThreads);
+    RunAssetChurnBenchmark();
+
+    LogSystemExit();
+    return 0;
+}
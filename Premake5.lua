@@ -48,6 +48,11 @@ function plugin(name)
         }
 end
 
+newoption {
+    trigger = "memory-tracking",
+    description = "Build with HE_MEMORY_TRACKING, which records arena allocations per callsite and enables memory budgets",
+}
+
 workspace "Horizon"
     location "Build"
     configurations {
@@ -75,6 +80,11 @@ filter "configurations:Release"
     }
     optimize "On"
 
+filter "options:memory-tracking"
+    defines {
+        "HE_MEMORY_TRACKING=1",
+    }
+
  
 filter "system:windows"
     platforms "Win64"
@@ -110,6 +120,11 @@ group "ThirdParty"
     include "ThirdParty/yaml-cpp"
 group ""
 
+group "Benchmarks"
+    include "Benchmarks/JobSystemBenchmark"
+    include "Benchmarks/MemoryArenaBenchmark"
+group ""
+
 group "Samples"
     include "Samples/CaptureFrames"
     include "Samples/SkyAtmosphere"
@@ -61,7 +61,7 @@ namespace HE
 	{
 		using namespace HE;
 
-		arena = new LinearArena(nullptr, 1048576);
+		arena = new JobSystemFrameArena("FrameArena", MaxNumSwapChainBuffers, 1048576);
 
 		uint32 initialWindowWidth = 1920;
 		uint32 initialWindowHeight = 1080;
@@ -298,7 +298,7 @@ namespace HE
 
 			RenderBackendPresentSwapChain(renderBackend, swapChain);
 
-			((LinearArena*)arena)->Reset();
+			((JobSystemFrameArena*)arena)->BeginFrame();
 
 			frameCounter++;
 		}
@@ -56,7 +56,7 @@ bool ModelViewerApp::Init()
 {
 	using namespace HE;
 
-	arena = new LinearArena(nullptr, 1048576);
+	arena = new JobSystemFrameArena("FrameArena", MaxNumSwapChainBuffers, 1048576);
 
 	uint32 initialWindowWidth = 1920;
 	uint32 initialWindowHeight = 1080;
@@ -254,7 +254,7 @@ int ModelViewerApp::Run()
 
 		HE::RenderBackendPresentSwapChain(renderBackend, swapChain);
 
-		((HE::LinearArena*)arena)->Reset();
+		((HE::JobSystemFrameArena*)arena)->BeginFrame();
 
 		frameCounter++;
 	}
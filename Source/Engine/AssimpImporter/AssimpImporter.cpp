@@ -41,6 +41,21 @@ namespace HE
 		}
 	}
 
+	struct ReadAssimpFileJobData
+	{
+		Assimp::Importer* importer;
+		const char* filename;
+		uint32 flags;
+		const aiScene* aiScene;
+	};
+
+	/** Parsing blocks on the file, so from a job it runs on an I/O thread. */
+	static void ReadAssimpFileJob(void* data)
+	{
+		ReadAssimpFileJobData* jobData = (ReadAssimpFileJobData*)data;
+		jobData->aiScene = jobData->importer->ReadFile(jobData->filename, jobData->flags);
+	}
+
 	static void ImportAssimpTask(void* data)
 	{
 		ImportAssimpTaskData* taskData = (ImportAssimpTaskData*)data;
@@ -58,7 +73,13 @@ namespace HE
 			aiProcess_ValidateDataStructure;    // Validation
 
 		std::unique_ptr<Assimp::Importer> importer = std::make_unique<Assimp::Importer>();
-		const aiScene* aiScene = importer->ReadFile(taskData->filename, meshImportFlags);
+		ReadAssimpFileJobData readJobData = {
+			.importer = importer.get(),
+			.filename = taskData->filename,
+			.flags = meshImportFlags,
+		};
+		JobSystemRunBlocking(ReadAssimpFileJob, &readJobData);
+		const aiScene* aiScene = readJobData.aiScene;
 
 		std::string dir = std::string(taskData->filename).substr(0, std::string(taskData->filename).find_last_of('/'));
 
@@ -171,32 +192,41 @@ namespace HE
 				element.numIndices = aiMesh->mNumFaces * 3;
 				element.transform = Matrix4x4(1.0f);
 
-				for (uint32 vertexID = 0; vertexID < aiMesh->mNumVertices; vertexID++)
+				mesh->positions.resize(element.baseVertex + element.numVertices);
+				mesh->normals.resize(element.baseVertex + element.numVertices);
+				mesh->tangents.resize(element.baseVertex + element.numVertices);
+				mesh->texCoords.resize(element.baseVertex + element.numVertices);
+				mesh->indices.resize(element.baseIndex + element.numIndices);
+
+				const bool hasTexCoords = aiMesh->HasTextureCoords(0);
+				ParallelFor(0, aiMesh->mNumVertices, 0, [&](uint32 vertexID)
 				{
+					const uint32 index = element.baseVertex + vertexID;
 					Vector3 normal = Vector3(aiMesh->mNormals[vertexID].x, aiMesh->mNormals[vertexID].y, aiMesh->mNormals[vertexID].z);
 					Vector3 tangent = Vector3(aiMesh->mTangents[vertexID].x, aiMesh->mTangents[vertexID].y, aiMesh->mTangents[vertexID].z);
 					Vector3 bitangent = Vector3(aiMesh->mBitangents[vertexID].x, aiMesh->mBitangents[vertexID].y, aiMesh->mBitangents[vertexID].z);
 					float tangentW = glm::dot(glm::cross(normal, tangent), bitangent) > 0.0f ? 1.0f : -1.0f;
-					mesh->positions.emplace_back(Vector3(aiMesh->mVertices[vertexID].x, aiMesh->mVertices[vertexID].y, aiMesh->mVertices[vertexID].z));
-					mesh->normals.emplace_back(normal);
-					mesh->tangents.emplace_back(Vector4(aiMesh->mTangents[vertexID].x, aiMesh->mTangents[vertexID].y, aiMesh->mTangents[vertexID].z, tangentW));
-					if (aiMesh->HasTextureCoords(0))
+					mesh->positions[index] = Vector3(aiMesh->mVertices[vertexID].x, aiMesh->mVertices[vertexID].y, aiMesh->mVertices[vertexID].z);
+					mesh->normals[index] = normal;
+					mesh->tangents[index] = Vector4(aiMesh->mTangents[vertexID].x, aiMesh->mTangents[vertexID].y, aiMesh->mTangents[vertexID].z, tangentW);
+					if (hasTexCoords)
 					{
-						mesh->texCoords.emplace_back(Vector2(aiMesh->mTextureCoords[0][vertexID].x, aiMesh->mTextureCoords[0][vertexID].y));
+						mesh->texCoords[index] = Vector2(aiMesh->mTextureCoords[0][vertexID].x, aiMesh->mTextureCoords[0][vertexID].y);
 					}
 					else
 					{
-						mesh->texCoords.emplace_back(Vector2(0.0f));
+						mesh->texCoords[index] = Vector2(0.0f);
 					}
-				}
+				});
 
-				for (uint32 faceIndex = 0; faceIndex < aiMesh->mNumFaces; faceIndex++)
+				ParallelFor(0, aiMesh->mNumFaces, 0, [&](uint32 faceIndex)
 				{
 					ASSERT(aiMesh->mFaces[faceIndex].mNumIndices == 3);
-					mesh->indices.emplace_back(aiMesh->mFaces[faceIndex].mIndices[0] + element.baseVertex);
-					mesh->indices.emplace_back(aiMesh->mFaces[faceIndex].mIndices[1] + element.baseVertex);
-					mesh->indices.emplace_back(aiMesh->mFaces[faceIndex].mIndices[2] + element.baseVertex);
-				}
+					const uint32 index = element.baseIndex + faceIndex * 3;
+					mesh->indices[index + 0] = aiMesh->mFaces[faceIndex].mIndices[0] + element.baseVertex;
+					mesh->indices[index + 1] = aiMesh->mFaces[faceIndex].mIndices[1] + element.baseVertex;
+					mesh->indices[index + 2] = aiMesh->mFaces[faceIndex].mIndices[2] + element.baseVertex;
+				});
 
 				mesh->numVertices += element.numVertices;
 				mesh->numIndices += element.numIndices;
@@ -50,6 +50,10 @@
 
 #if defined(_MSC_VER)
 #define FORCEINLINE __forceinline
+#define NOINLINE __declspec(noinline)
+#else
+#define FORCEINLINE inline __attribute__((always_inline))
+#define NOINLINE __attribute__((noinline))
 #endif
 
 #define ARRAY_SIZE(a) ((int)(sizeof(a) / sizeof(*(a))))
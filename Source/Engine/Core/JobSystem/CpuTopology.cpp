@@ -0,0 +1,213 @@
+module;
+
+#include "CoreCommon.h"
+
+#include <thread>
+
+#if HE_PLATFORM_WINDOWS
+#include <windows.h>
+#else
+#include <sched.h>
+#include <dirent.h>
+#endif
+
+module HorizonEngine.Core.JobSystem;
+
+import HorizonEngine.Core.Math;
+
+namespace HE
+{
+    /** Maps keys (core, cache or node identifiers of the OS) to dense indices in order of first appearance. */
+    template<typename Key>
+    static uint32 GetDenseIndex(std::map<Key, uint32>& indices, const Key& key)
+    {
+        auto [it, inserted] = indices.try_emplace(key, (uint32)indices.size());
+        return it->second;
+    }
+
+#if HE_PLATFORM_WINDOWS
+    template<typename Func>
+    static void ForEachProcessorInGroupMask(const GROUP_AFFINITY& groupMask, Func&& func)
+    {
+        for (uint32 bit = 0; bit < 64; bit++)
+        {
+            if (groupMask.Mask & ((KAFFINITY)1 << bit))
+            {
+                func((uint32)groupMask.Group * 64 + bit);
+            }
+        }
+    }
+
+    static bool QueryCpuTopology(JobSystemCpuTopology& topology)
+    {
+        DWORD size = 0;
+        GetLogicalProcessorInformationEx(RelationAll, nullptr, &size);
+        if (GetLastError() != ERROR_INSUFFICIENT_BUFFER)
+        {
+            return false;
+        }
+        std::vector<uint8> buffer(size);
+        if (!GetLogicalProcessorInformationEx(RelationAll, (PSYSTEM_LOGICAL_PROCESSOR_INFORMATION_EX)buffer.data(), &size))
+        {
+            return false;
+        }
+
+        std::map<uint32, JobSystemLogicalProcessor> processors;
+        uint32 numCores = 0;
+        uint32 numCacheGroups = 0;
+        uint32 numNumaNodes = 0;
+        for (DWORD offset = 0; offset < size;)
+        {
+            const SYSTEM_LOGICAL_PROCESSOR_INFORMATION_EX* info = (const SYSTEM_LOGICAL_PROCESSOR_INFORMATION_EX*)(buffer.data() + offset);
+            offset += info->Size;
+
+            if (info->Relationship == RelationProcessorCore)
+            {
+                uint32 smtIndex = 0;
+                for (WORD i = 0; i < info->Processor.GroupCount; i++)
+                {
+                    ForEachProcessorInGroupMask(info->Processor.GroupMask[i], [&](uint32 id)
+                    {
+                        JobSystemLogicalProcessor& processor = processors[id];
+                        processor.id = id;
+                        processor.coreIndex = numCores;
+                        processor.smtIndex = smtIndex++;
+                    });
+                }
+                numCores++;
+            }
+            else if (info->Relationship == RelationCache && info->Cache.Level == 3)
+            {
+                ForEachProcessorInGroupMask(info->Cache.GroupMask, [&](uint32 id)
+                {
+                    processors[id].cacheGroupIndex = numCacheGroups;
+                });
+                numCacheGroups++;
+            }
+            else if (info->Relationship == RelationNumaNode)
+            {
+                ForEachProcessorInGroupMask(info->NumaNode.GroupMask, [&](uint32 id)
+                {
+                    processors[id].numaNodeIndex = numNumaNodes;
+                });
+                numNumaNodes++;
+            }
+        }
+
+        topology.numPhysicalCores = numCores;
+        topology.numCacheGroups = Math::Max(numCacheGroups, 1u);
+        topology.numNumaNodes = Math::Max(numNumaNodes, 1u);
+        for (const auto& [id, processor] : processors)
+        {
+            topology.logicalProcessors.push_back(processor);
+        }
+        return numCores > 0;
+    }
+#else
+    static bool ReadSysfsString(const std::string& path, std::string& outValue)
+    {
+        std::ifstream file(path);
+        return (bool)std::getline(file, outValue);
+    }
+
+    static bool QueryCpuTopology(JobSystemCpuTopology& topology)
+    {
+        // Only the processors this process may run on, which respects cpusets and container limits.
+        cpu_set_t cpuSet;
+        CPU_ZERO(&cpuSet);
+        if (sched_getaffinity(0, sizeof(cpuSet), &cpuSet) != 0)
+        {
+            return false;
+        }
+
+        std::map<std::string, uint32> coreIndices;
+        std::map<std::string, uint32> cacheGroupIndices;
+        std::map<uint32, uint32> numaNodeIndices;
+        std::map<uint32, uint32> numSmtSiblings;
+        for (uint32 id = 0; id < CPU_SETSIZE; id++)
+        {
+            if (!CPU_ISSET(id, &cpuSet))
+            {
+                continue;
+            }
+            const std::string cpuPath = "/sys/devices/system/cpu/cpu" + std::to_string(id);
+
+            // SMT siblings share the list, so it identifies the physical core.
+            std::string siblings;
+            if (!ReadSysfsString(cpuPath + "/topology/thread_siblings_list", siblings))
+            {
+                return false;
+            }
+
+            // Without an L3 the package is the closest thing to a shared cache.
+            std::string cacheGroup;
+            for (uint32 cacheIndex = 0; ; cacheIndex++)
+            {
+                const std::string cachePath = cpuPath + "/cache/index" + std::to_string(cacheIndex);
+                std::string level;
+                if (!ReadSysfsString(cachePath + "/level", level))
+                {
+                    break;
+                }
+                if (level == "3")
+                {
+                    ReadSysfsString(cachePath + "/shared_cpu_list", cacheGroup);
+                    break;
+                }
+            }
+            if (cacheGroup.empty())
+            {
+                ReadSysfsString(cpuPath + "/topology/physical_package_id", cacheGroup);
+            }
+
+            uint32 numaNode = 0;
+            if (DIR* dir = opendir(cpuPath.c_str()))
+            {
+                while (dirent* entry = readdir(dir))
+                {
+                    if (strncmp(entry->d_name, "node", 4) == 0)
+                    {
+                        numaNode = (uint32)atoi(entry->d_name + 4);
+                        break;
+                    }
+                }
+                closedir(dir);
+            }
+
+            JobSystemLogicalProcessor processor;
+            processor.id = id;
+            processor.coreIndex = GetDenseIndex(coreIndices, siblings);
+            processor.smtIndex = numSmtSiblings[processor.coreIndex]++;
+            processor.cacheGroupIndex = GetDenseIndex(cacheGroupIndices, cacheGroup);
+            processor.numaNodeIndex = GetDenseIndex(numaNodeIndices, numaNode);
+            topology.logicalProcessors.push_back(processor);
+        }
+
+        topology.numPhysicalCores = (uint32)coreIndices.size();
+        topology.numCacheGroups = (uint32)cacheGroupIndices.size();
+        topology.numNumaNodes = (uint32)numaNodeIndices.size();
+        return topology.numPhysicalCores > 0;
+    }
+#endif
+
+    JobSystemCpuTopology JobSystemQueryCpuTopology()
+    {
+        JobSystemCpuTopology topology = {};
+        if (QueryCpuTopology(topology))
+        {
+            return topology;
+        }
+
+        // Unknown topology, every logical processor is a core of its own.
+        topology = {};
+        const uint32 numLogicalProcessors = Math::Max(std::thread::hardware_concurrency(), 1u);
+        for (uint32 id = 0; id < numLogicalProcessors; id++)
+        {
+            topology.logicalProcessors.push_back({ id, id, 0, 0, 0 });
+        }
+        topology.numPhysicalCores = numLogicalProcessors;
+        topology.numCacheGroups = 1;
+        topology.numNumaNodes = 1;
+        return topology;
+    }
+}
@@ -0,0 +1,308 @@
+module;
+
+#include "CoreCommon.h"
+
+#include <mutex>
+
+#if HE_PLATFORM_WINDOWS
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+module HorizonEngine.Core.JobSystem.Fiber;
+
+/**
+ * Hand-written x86-64 context switch.
+ * HE_FiberSwitchContext(void** from, void* to) pushes the callee-saved registers of the current fiber on its own stack,
+ * stores the stack pointer to *from, loads to as the new stack pointer and pops the registers of the target fiber.
+ * HE_FiberEntryTrampoline is the return address of a freshly initialized fiber, it calls entry(userData) which are preloaded in r12/rbx.
+ *
+ * Win64 additionally saves rdi, rsi, xmm6-xmm15 and the stack base/limit/deallocation stack in the TIB,
+ * which the OS uses to validate the stack during exception dispatch and stack probes.
+ * Both save MXCSR and the x87 control word, like FIBER_FLAG_FLOAT_SWITCH.
+ */
+#if defined(_MSC_VER) && defined(_M_X64)
+
+// MSVC has no x64 inline assembly, the functions are emitted as machine code into the text section.
+#pragma section(".text")
+
+__declspec(allocate(".text")) static const unsigned char gFiberSwitchContextCode[] = {
+    0x55, 0x53, 0x57, 0x56, 0x41, 0x54, 0x41, 0x55, 0x41, 0x56, 0x41, 0x57, 0x65, 0xFF, 0x34, 0x25,
+    0x08, 0x00, 0x00, 0x00, 0x65, 0xFF, 0x34, 0x25, 0x10, 0x00, 0x00, 0x00, 0x65, 0xFF, 0x34, 0x25,
+    0x78, 0x14, 0x00, 0x00, 0x48, 0x81, 0xEC, 0xA8, 0x00, 0x00, 0x00, 0x0F, 0x11, 0x34, 0x24, 0x0F,
+    0x11, 0x7C, 0x24, 0x10, 0x44, 0x0F, 0x11, 0x44, 0x24, 0x20, 0x44, 0x0F, 0x11, 0x4C, 0x24, 0x30,
+    0x44, 0x0F, 0x11, 0x54, 0x24, 0x40, 0x44, 0x0F, 0x11, 0x5C, 0x24, 0x50, 0x44, 0x0F, 0x11, 0x64,
+    0x24, 0x60, 0x44, 0x0F, 0x11, 0x6C, 0x24, 0x70, 0x44, 0x0F, 0x11, 0xB4, 0x24, 0x80, 0x00, 0x00,
+    0x00, 0x44, 0x0F, 0x11, 0xBC, 0x24, 0x90, 0x00, 0x00, 0x00, 0x0F, 0xAE, 0x9C, 0x24, 0xA0, 0x00,
+    0x00, 0x00, 0xD9, 0xBC, 0x24, 0xA4, 0x00, 0x00, 0x00, 0x48, 0x89, 0x21, 0x48, 0x89, 0xD4, 0x0F,
+    0x10, 0x34, 0x24, 0x0F, 0x10, 0x7C, 0x24, 0x10, 0x44, 0x0F, 0x10, 0x44, 0x24, 0x20, 0x44, 0x0F,
+    0x10, 0x4C, 0x24, 0x30, 0x44, 0x0F, 0x10, 0x54, 0x24, 0x40, 0x44, 0x0F, 0x10, 0x5C, 0x24, 0x50,
+    0x44, 0x0F, 0x10, 0x64, 0x24, 0x60, 0x44, 0x0F, 0x10, 0x6C, 0x24, 0x70, 0x44, 0x0F, 0x10, 0xB4,
+    0x24, 0x80, 0x00, 0x00, 0x00, 0x44, 0x0F, 0x10, 0xBC, 0x24, 0x90, 0x00, 0x00, 0x00, 0x0F, 0xAE,
+    0x94, 0x24, 0xA0, 0x00, 0x00, 0x00, 0xD9, 0xAC, 0x24, 0xA4, 0x00, 0x00, 0x00, 0x48, 0x81, 0xC4,
+    0xA8, 0x00, 0x00, 0x00, 0x65, 0x8F, 0x04, 0x25, 0x78, 0x14, 0x00, 0x00, 0x65, 0x8F, 0x04, 0x25,
+    0x10, 0x00, 0x00, 0x00, 0x65, 0x8F, 0x04, 0x25, 0x08, 0x00, 0x00, 0x00, 0x41, 0x5F, 0x41, 0x5E,
+    0x41, 0x5D, 0x41, 0x5C, 0x5E, 0x5F, 0x5B, 0x5D, 0xC3,
+};
+
+// mov rcx, rbx; jmp r12
+__declspec(allocate(".text")) static const unsigned char gFiberEntryTrampolineCode[] = {
+    0x48, 0x89, 0xD9, 0x41, 0xFF, 0xE4,
+};
+
+#define HE_FIBER_ABI_WIN64 1
+static void (* const HE_FiberSwitchContext)(void** from, void* to) = (void(*)(void**, void*))(void*)gFiberSwitchContextCode;
+static const void* const HE_FiberEntryTrampoline = gFiberEntryTrampolineCode;
+
+#elif (defined(__GNUC__) || defined(__clang__)) && defined(__x86_64__)
+
+#if defined(_WIN32)
+#define HE_FIBER_ABI_WIN64 1
+asm(R"(
+.text
+.globl HE_FiberSwitchContext
+HE_FiberSwitchContext:
+    pushq %rbp
+    pushq %rbx
+    pushq %rdi
+    pushq %rsi
+    pushq %r12
+    pushq %r13
+    pushq %r14
+    pushq %r15
+    pushq %gs:0x08
+    pushq %gs:0x10
+    pushq %gs:0x1478
+    subq $0xA8, %rsp
+    movups %xmm6, 0x00(%rsp)
+    movups %xmm7, 0x10(%rsp)
+    movups %xmm8, 0x20(%rsp)
+    movups %xmm9, 0x30(%rsp)
+    movups %xmm10, 0x40(%rsp)
+    movups %xmm11, 0x50(%rsp)
+    movups %xmm12, 0x60(%rsp)
+    movups %xmm13, 0x70(%rsp)
+    movups %xmm14, 0x80(%rsp)
+    movups %xmm15, 0x90(%rsp)
+    stmxcsr 0xA0(%rsp)
+    fnstcw 0xA4(%rsp)
+    movq %rsp, (%rcx)
+    movq %rdx, %rsp
+    movups 0x00(%rsp), %xmm6
+    movups 0x10(%rsp), %xmm7
+    movups 0x20(%rsp), %xmm8
+    movups 0x30(%rsp), %xmm9
+    movups 0x40(%rsp), %xmm10
+    movups 0x50(%rsp), %xmm11
+    movups 0x60(%rsp), %xmm12
+    movups 0x70(%rsp), %xmm13
+    movups 0x80(%rsp), %xmm14
+    movups 0x90(%rsp), %xmm15
+    ldmxcsr 0xA0(%rsp)
+    fldcw 0xA4(%rsp)
+    addq $0xA8, %rsp
+    popq %gs:0x1478
+    popq %gs:0x10
+    popq %gs:0x08
+    popq %r15
+    popq %r14
+    popq %r13
+    popq %r12
+    popq %rsi
+    popq %rdi
+    popq %rbx
+    popq %rbp
+    ret
+
+.globl HE_FiberEntryTrampoline
+HE_FiberEntryTrampoline:
+    movq %rbx, %rcx
+    jmp *%r12
+)");
+#else
+#define HE_FIBER_ABI_SYSV 1
+asm(R"(
+.text
+.globl HE_FiberSwitchContext
+.type HE_FiberSwitchContext, @function
+HE_FiberSwitchContext:
+    pushq %rbp
+    pushq %rbx
+    pushq %r12
+    pushq %r13
+    pushq %r14
+    pushq %r15
+    subq $8, %rsp
+    stmxcsr (%rsp)
+    fnstcw 4(%rsp)
+    movq %rsp, (%rdi)
+    movq %rsi, %rsp
+    ldmxcsr (%rsp)
+    fldcw 4(%rsp)
+    addq $8, %rsp
+    popq %r15
+    popq %r14
+    popq %r13
+    popq %r12
+    popq %rbx
+    popq %rbp
+    ret
+.size HE_FiberSwitchContext, .-HE_FiberSwitchContext
+
+.globl HE_FiberEntryTrampoline
+.type HE_FiberEntryTrampoline, @function
+HE_FiberEntryTrampoline:
+    movq %rbx, %rdi
+    jmp *%r12
+.size HE_FiberEntryTrampoline, .-HE_FiberEntryTrampoline
+.section .note.GNU-stack,"",@progbits
+.text
+)");
+#endif
+
+extern "C" void HE_FiberSwitchContext(void** from, void* to);
+extern "C" void HE_FiberEntryTrampoline();
+
+#else
+#error "User-space fibers are only implemented for x86-64."
+#endif
+
+namespace HE
+{
+    static uint64 GetPageSize()
+    {
+#if HE_PLATFORM_WINDOWS
+        SYSTEM_INFO si;
+        GetSystemInfo(&si);
+        return si.dwPageSize;
+#else
+        return (uint64)sysconf(_SC_PAGESIZE);
+#endif
+    }
+
+    static FiberStack AllocateFiberStack(uint64 stackSize, uint32 sizeClass)
+    {
+        const uint64 pageSize = GetPageSize();
+        const uint64 usableSize = (stackSize + pageSize - 1) & ~(pageSize - 1);
+        const uint64 allocationSize = usableSize + pageSize;
+
+#if HE_PLATFORM_WINDOWS
+        void* allocationBase = VirtualAlloc(NULL, allocationSize, MEM_RESERVE | MEM_COMMIT, PAGE_READWRITE);
+        ASSERT(allocationBase);
+        DWORD oldProtect;
+        VirtualProtect(allocationBase, pageSize, PAGE_NOACCESS, &oldProtect);
+#else
+        void* allocationBase = mmap(nullptr, allocationSize, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_STACK, -1, 0);
+        ASSERT(allocationBase != MAP_FAILED);
+        mprotect(allocationBase, pageSize, PROT_NONE);
+#endif
+
+        FiberStack stack = {};
+        stack.allocationBase = allocationBase;
+        stack.allocationSize = allocationSize;
+        stack.stackLimit = (uint8*)allocationBase + pageSize;
+        stack.stackBase = (uint8*)allocationBase + allocationSize;
+        stack.sizeClass = sizeClass;
+        return stack;
+    }
+
+    static void ReleaseFiberStack(const FiberStack& stack)
+    {
+#if HE_PLATFORM_WINDOWS
+        VirtualFree(stack.allocationBase, 0, MEM_RELEASE);
+#else
+        munmap(stack.allocationBase, stack.allocationSize);
+#endif
+    }
+
+    FiberStackPool::~FiberStackPool()
+    {
+        ReleaseAll();
+    }
+
+    FiberStack FiberStackPool::Allocate(uint64 stackSize)
+    {
+        for (uint32 sizeClass = 0; sizeClass < NumSizeClasses; sizeClass++)
+        {
+            if (stackSize <= SizeClasses[sizeClass])
+            {
+                {
+                    std::lock_guard<std::mutex> lock(mutex);
+                    if (!freeStacks[sizeClass].empty())
+                    {
+                        FiberStack stack = freeStacks[sizeClass].back();
+                        freeStacks[sizeClass].pop_back();
+                        return stack;
+                    }
+                }
+                return AllocateFiberStack(SizeClasses[sizeClass], sizeClass);
+            }
+        }
+        return AllocateFiberStack(stackSize, InvalidSizeClass);
+    }
+
+    void FiberStackPool::Free(const FiberStack& stack)
+    {
+        if (stack.sizeClass == InvalidSizeClass)
+        {
+            ReleaseFiberStack(stack);
+            return;
+        }
+        std::lock_guard<std::mutex> lock(mutex);
+        freeStacks[stack.sizeClass].push_back(stack);
+    }
+
+    void FiberStackPool::ReleaseAll()
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        for (uint32 sizeClass = 0; sizeClass < NumSizeClasses; sizeClass++)
+        {
+            for (const FiberStack& stack : freeStacks[sizeClass])
+            {
+                ReleaseFiberStack(stack);
+            }
+            freeStacks[sizeClass].clear();
+        }
+    }
+
+    void FiberContextInit(FiberContext* context, const FiberStack& stack, FiberContextEntry entry, void* userData)
+    {
+        const uint64 top = (uint64)stack.stackBase & ~uint64(15);
+
+#if HE_FIBER_ABI_WIN64
+        // [xmm6-xmm15, mxcsr, fpucw][deallocation stack][stack limit][stack base][r15][r14][r13][r12][rsi][rdi][rbx][rbp][ret][fake ret][shadow space]
+        // The trampoline is entered with rsp = sp + 0x108 which must be 8 mod 16 like a regular call, followed by 32 bytes of shadow space.
+        uint8* sp = (uint8*)(top - 0x130);
+        memset(sp, 0, 0x130);
+        *(uint32*)(sp + 0xA0) = 0x1F80;
+        *(uint16*)(sp + 0xA4) = 0x037F;
+        *(void**)(sp + 0xA8) = stack.allocationBase;
+        *(void**)(sp + 0xB0) = stack.stackLimit;
+        *(void**)(sp + 0xB8) = stack.stackBase;
+        *(void**)(sp + 0xD8) = (void*)entry;
+        *(void**)(sp + 0xF0) = userData;
+        *(const void**)(sp + 0x100) = (const void*)HE_FiberEntryTrampoline;
+#else
+        // [mxcsr, fpucw][r15][r14][r13][r12][rbx][rbp][ret][fake ret]
+        // The trampoline is entered with rsp = sp + 0x40 which must be 8 mod 16 like a regular call.
+        uint8* sp = (uint8*)(top - 0x48);
+        memset(sp, 0, 0x48);
+        *(uint32*)(sp + 0x00) = 0x1F80;
+        *(uint16*)(sp + 0x04) = 0x037F;
+        *(void**)(sp + 0x20) = (void*)entry;
+        *(void**)(sp + 0x28) = userData;
+        *(const void**)(sp + 0x38) = (const void*)HE_FiberEntryTrampoline;
+#endif
+
+        context->stackPointer = sp;
+        context->userData = userData;
+        context->stack = stack;
+    }
+
+    void FiberContextSwitch(FiberContext* from, FiberContext* to)
+    {
+        HE_FiberSwitchContext(&from->stackPointer, to->stackPointer);
+    }
+}
@@ -0,0 +1,67 @@
+module;
+
+#include "CoreCommon.h"
+
+#include <mutex>
+
+export module HorizonEngine.Core.JobSystem.Fiber;
+
+import HorizonEngine.Core.Types;
+
+export namespace HE
+{
+    /**
+     * Stack of a user-space fiber. Grows down from stackBase to stackLimit.
+     * The page(s) just below stackLimit are a no-access guard so that a stack overflow faults instead of corrupting the neighbouring stack.
+     */
+    struct FiberStack
+    {
+        void* allocationBase;
+        uint64 allocationSize;
+        void* stackLimit;
+        void* stackBase;
+        uint32 sizeClass;
+    };
+
+    /**
+     * Pool of guard-paged fiber stacks in a few size classes.
+     * Requests are rounded up to the nearest size class, larger requests are allocated and released directly.
+     */
+    class FiberStackPool
+    {
+    public:
+        static constexpr uint32 NumSizeClasses = 3;
+        static constexpr uint64 SizeClasses[NumSizeClasses] = { 64 * 1024, 256 * 1024, 1024 * 1024 };
+        static constexpr uint32 InvalidSizeClass = 0xFFFFFFFF;
+        FiberStackPool() = default;
+        ~FiberStackPool();
+        FiberStackPool(const FiberStackPool&) = delete;
+        FiberStackPool& operator=(const FiberStackPool&) = delete;
+        FiberStack Allocate(uint64 stackSize);
+        void Free(const FiberStack& stack);
+        void ReleaseAll();
+    private:
+        std::mutex mutex;
+        std::vector<FiberStack> freeStacks[NumSizeClasses];
+    };
+
+    using FiberContextEntry = void(*)(void*);
+
+    /**
+     * Execution context of a user-space fiber.
+     * While the fiber is suspended, stackPointer points at its saved callee-saved registers.
+     * A context converted from a thread has no stack of its own.
+     */
+    struct FiberContext
+    {
+        void* stackPointer;
+        void* userData;
+        FiberStack stack;
+    };
+
+    /** Prepares the context so that the first switch to it calls entry(userData) on the given stack. The entry must never return. */
+    void FiberContextInit(FiberContext* context, const FiberStack& stack, FiberContextEntry entry, void* userData);
+
+    /** Saves the callee-saved state of the calling fiber into from and resumes to. Costs a few dozen cycles, no kernel transition. */
+    void FiberContextSwitch(FiberContext* from, FiberContext* to);
+}
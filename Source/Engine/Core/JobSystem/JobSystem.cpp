@@ -1,13 +1,47 @@
 module;
 
 #include "CoreCommon.h"
+#include "JobSystemDefinitions.h"
 
+#if HE_PLATFORM_WINDOWS
 #include <windows.h>
+#else
+#include <pthread.h>
+#include <sched.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+#include <linux/futex.h>
+#include <immintrin.h>
+#endif
+
+#include <coroutine>
+#include <mutex>
+
 #include <MPMCQueue.h>
 
+/**
+ * HE_JOB_SYSTEM_USER_SPACE_FIBERS selects the fiber backend.
+ * 1: hand-written context switch on pooled, guard-paged stacks (HorizonEngine.Core.JobSystem.Fiber).
+ * 0: Win32 fibers (CreateFiberEx/SwitchToFiber), Windows only.
+ */
+#ifndef HE_JOB_SYSTEM_USER_SPACE_FIBERS
+#define HE_JOB_SYSTEM_USER_SPACE_FIBERS 1
+#endif
+
+#if !HE_JOB_SYSTEM_USER_SPACE_FIBERS && !HE_PLATFORM_WINDOWS
+#error "Win32 fibers are only available on Windows."
+#endif
+
+#if HE_JOB_SYSTEM_TRACING
+#define HE_JOB_SYSTEM_TRACE(type, name, arg) JobSystemTraceRecord(GetCurrentWorkerThreadIndex(), JobSystemTraceEventType::type, name, arg)
+#else
+#define HE_JOB_SYSTEM_TRACE(type, name, arg)
+#endif
+
 module HorizonEngine.Core.JobSystem;
 
 import HorizonEngine.Core.Logging;
+import HorizonEngine.Core.JobSystem.Fiber;
 
 namespace HE
 {
@@ -22,8 +56,89 @@ namespace HE
     {
         JobSystemJobDecl decl;
         JobSystemAtomicCounterHandle counterHandle;
+        JobSystemJobPriority priority;
+    };
+
+    constexpr uint32 NumJobPriorities = (uint32)JobSystemJobPriority::Count;
+
+    /**
+     * A bounded Chase-Lev work-stealing deque.
+     * The owner worker thread pushes and pops at the bottom (LIFO), other worker threads steal from the top (FIFO).
+     * Reference: Correct and Efficient Work-Stealing for Weak Memory Models, Le et al. 2013.
+     */
+    template<typename T, uint32 Capacity>
+    class WorkStealingDeque
+    {
+    public:
+        STATIC_ASSERT((Capacity & (Capacity - 1)) == 0);
+
+        /** Only called by the owner. Returns false if the deque is full. */
+        bool Push(const T& item)
+        {
+            const int64 b = bottom.load(std::memory_order_relaxed);
+            const int64 t = top.load(std::memory_order_acquire);
+            if (b - t >= (int64)Capacity)
+            {
+                return false;
+            }
+            items[b & (Capacity - 1)] = item;
+            std::atomic_thread_fence(std::memory_order_release);
+            bottom.store(b + 1, std::memory_order_relaxed);
+            return true;
+        }
+
+        /** Only called by the owner. */
+        bool Pop(T& outItem)
+        {
+            const int64 b = bottom.load(std::memory_order_relaxed) - 1;
+            bottom.store(b, std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            int64 t = top.load(std::memory_order_relaxed);
+            if (t > b)
+            {
+                // Empty
+                bottom.store(b + 1, std::memory_order_relaxed);
+                return false;
+            }
+            outItem = items[b & (Capacity - 1)];
+            if (t == b)
+            {
+                // Last item, race against thieves.
+                const bool success = top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed);
+                bottom.store(b + 1, std::memory_order_relaxed);
+                return success;
+            }
+            return true;
+        }
+
+        /** Approximate when called by a thread other than the owner. */
+        bool IsEmpty() const
+        {
+            return bottom.load(std::memory_order_relaxed) <= top.load(std::memory_order_relaxed);
+        }
+
+        /** Called by any thread other than the owner. */
+        bool Steal(T& outItem)
+        {
+            int64 t = top.load(std::memory_order_acquire);
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            const int64 b = bottom.load(std::memory_order_acquire);
+            if (t >= b)
+            {
+                return false;
+            }
+            outItem = items[t & (Capacity - 1)];
+            return top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed);
+        }
+
+    private:
+        alignas(64) std::atomic<int64> top = 0;
+        alignas(64) std::atomic<int64> bottom = 0;
+        alignas(64) T items[Capacity];
     };
 
+    using WorkerJobQueue = WorkStealingDeque<Job, JOB_SYSTEM_WORKER_QUEUE_CAPACITY>;
+
     struct WorkerThread
     {
         uint64 handle;
@@ -35,19 +150,27 @@ namespace HE
         uint64 handle;
     };
 
-    struct Fiber;
-    struct SleepingFiber
-    {
-        uint32 condition;
-        JobSystemAtomicCounterHandle counterHandle;
-        Fiber* fiber;
-    };
-
     struct Fiber
     {
         uint64 handle;
         uint32 index;
-        SleepingFiber sleepingFiberToSchedule;
+        /** Priority of the job currently running on this fiber. */
+        JobSystemJobPriority runningJobPriority;
+#if HE_JOB_SYSTEM_TRACING
+        const char* runningJobName;
+#endif
+        /**
+         * Work left behind by the fiber that switched to this one. It can only be done once the previous fiber's context has been saved,
+         * so it is picked up by this fiber right after the switch, see ProcessPendingFiberActions().
+         */
+        Fiber* fiberToFree;
+        Fiber* fiberToPark;
+        /** fiberToPark waits on this counter, or on parkWaitList if set. */
+        JobSystemAtomicCounterHandle parkCounterHandle;
+        JobSystemWaitList* parkWaitList;
+        /** Intrusive wait list node, valid while the fiber is parked on a counter. */
+        uint32 waitCondition;
+        Fiber* nextWaitingFiber;
     };
 
     typedef void ThreadEntryFunction(void* userData);
@@ -75,22 +198,81 @@ namespace HE
     {
         uint32 index;
         std::atomic<uint32> atomic;
+        /** Fibers and coroutines waiting until the counter reaches their condition. Checked without the lock on every decrement, so it is kept separately. */
+        std::atomic<uint32> numWaiters;
+        std::atomic<bool> waitListLock;
+        Fiber* waitingFibers;
+        JobSystemCounterContinuation* waitingContinuations;
+    };
+
+    /** Counters are allocated in chunks so that handles, which index them, stay valid while the pool grows. */
+    constexpr uint32 AtomicCounterChunkSize = 1024;
+    constexpr uint32 MaxNumAtomicCounterChunks = JOB_SYSTEM_MAX_NUM_COUNTERS / AtomicCounterChunkSize;
+    /** Number of fibers created at once when the pool runs dry. */
+    constexpr uint32 FiberChunkSize = 32;
+
+    struct AtomicCounterChunk
+    {
+        AtomicCounter counters[AtomicCounterChunkSize];
     };
 
     std::atomic<bool> gInitialized;
+    std::atomic<bool> gExitRequested;
     uint32 gWorkerThreadCount;
     WorkerThread gWorkerThreads[JOB_SYSTEM_MAX_NUM_WORKER_THREADS];
+    /** Fibers converted from the worker threads. They are not part of the pool, see WorkerThreadEntry(). */
+    Fiber gWorkerThreadFibers[JOB_SYSTEM_MAX_NUM_WORKER_THREADS];
+    FiberData gWorkerThreadFiberData[JOB_SYSTEM_MAX_NUM_WORKER_THREADS];
     uint32 gWorkerThreadIDs[JOB_SYSTEM_MAX_NUM_WORKER_THREADS];
+    /** Number of fibers created so far, grows up to JOB_SYSTEM_MAX_NUM_FIBERS. Only written with gPoolGrowthMutex held. */
     uint32 gFiberCount;
+    uint32 gFiberStackSize;
     Fiber gFibers[JOB_SYSTEM_MAX_NUM_FIBERS];
-    AtomicCounter gAtomicCounters[JOB_SYSTEM_MAX_NUM_JOBS];
+    /** Chunks are only ever added while the job system runs. A handle is published through gFreeCounterQueue after its chunk. */
+    std::atomic<AtomicCounterChunk*> gAtomicCounterChunks[MaxNumAtomicCounterChunks];
+    uint32 gNumAtomicCounterChunks;
+    std::mutex gPoolGrowthMutex;
     MPMCQueue<uint32> gFreeFiberQueue(JOB_SYSTEM_MAX_NUM_FIBERS);
-    MPMCQueue<SleepingFiber> gSleepingFiberQueue(JOB_SYSTEM_MAX_NUM_FIBERS);
-    MPMCQueue<Job> gJobQueue(JOB_SYSTEM_MAX_NUM_JOBS);
-    MPMCQueue<uint32> gFreeCounterQueue(JOB_SYSTEM_MAX_NUM_JOBS);
-    Semaphore gSemaphores[JOB_SYSTEM_MAX_NUM_WORKER_THREADS];
-    std::map<uint32, uint32> gThreadIdSemaphoreLUT;
-    std::atomic<uint32> gNextWorkerThreadIndex;
+    /** Parked fibers whose counter has reached the condition, resumed by the next worker that looks for work. */
+    MPMCQueue<Fiber*> gReadyFiberQueue(JOB_SYSTEM_MAX_NUM_FIBERS);
+    MPMCQueue<Job> gJobQueues[NumJobPriorities] = {
+        MPMCQueue<Job>(JOB_SYSTEM_MAX_NUM_JOBS),
+        MPMCQueue<Job>(JOB_SYSTEM_MAX_NUM_JOBS),
+        MPMCQueue<Job>(JOB_SYSTEM_MAX_NUM_JOBS),
+    };
+    MPMCQueue<Job> gMainThreadJobQueue(JOB_SYSTEM_MAX_NUM_JOBS);
+    /** Blocking calls (file reads, decoders, importers) run on plain threads of their own, see JobSystemRunIOJobs(). */
+    uint32 gIOThreadCount;
+    WorkerThread gIOThreads[JOB_SYSTEM_MAX_NUM_IO_THREADS];
+    ThreadData gIOThreadData[JOB_SYSTEM_MAX_NUM_IO_THREADS];
+    MPMCQueue<Job> gIOJobQueue(JOB_SYSTEM_MAX_NUM_JOBS);
+    /** Released once per queued I/O job. */
+    Semaphore gIOSemaphore;
+    WorkerJobQueue gWorkerJobQueues[NumJobPriorities][JOB_SYSTEM_MAX_NUM_WORKER_THREADS];
+    /** Steal order of each worker: the workers sharing its L3 cache first, then the others from near to far. */
+    uint8 gStealVictims[JOB_SYSTEM_MAX_NUM_WORKER_THREADS][JOB_SYSTEM_MAX_NUM_WORKER_THREADS];
+    uint32 gNumLocalStealVictims[JOB_SYSTEM_MAX_NUM_WORKER_THREADS];
+    /** Number of workers currently executing a background job, capped so that frame-critical jobs always find a free worker. */
+    std::atomic<uint32> gNumRunningBackgroundJobs;
+    uint32 gMaxNumRunningBackgroundJobs;
+    uint32 gMainThreadID;
+    std::atomic<bool> gWorkStealingEnabled = true;
+    MPMCQueue<uint32> gFreeCounterQueue(JOB_SYSTEM_MAX_NUM_COUNTERS);
+    /** See JobSystemStats. */
+    std::atomic<uint32> gNumCountersInUse;
+    std::atomic<uint32> gMaxNumCountersInUse;
+    std::atomic<uint32> gNumFibersInUse;
+    std::atomic<uint32> gMaxNumFibersInUse;
+    std::atomic<uint32> gMaxNumQueuedJobs;
+    std::atomic<uint32> gNumStalls;
+    /** Idle workers all sleep on the same semaphore, a submission releases it once for as many workers as it needs. */
+    Semaphore gWakeSemaphore;
+    /** Number of workers that are (about to be) asleep on gWakeSemaphore and have not been claimed by a wake-up yet. */
+    std::atomic<uint32> gNumSleepingWorkers;
+    /** Threads outside the pool wait here for room in a full shared queue, one semaphore per priority, see PushJob(). */
+    Semaphore gSubmitterSemaphores[NumJobPriorities];
+    /** Number of submitters that are (about to be) asleep on gSubmitterSemaphores and have not been claimed by a wake-up yet. */
+    std::atomic<uint32> gNumBlockedSubmitters[NumJobPriorities];
     ThreadData gThreadData[JOB_SYSTEM_MAX_NUM_WORKER_THREADS];
     WorkerThreadUserData gWorkerThreadUserData[JOB_SYSTEM_MAX_NUM_WORKER_THREADS];
     FiberData gFiberData[JOB_SYSTEM_MAX_NUM_FIBERS];
@@ -118,11 +300,6 @@ namespace HE
         return GetCurrentThreadId();
     }
 
-    static void SwitchToAnotherFiber(uint64 handle)
-    {
-        SwitchToFiber((void*)handle);
-    }
-
     static uint64 CreateSemaphoreEXT(uint32 initialCount)
     {
         uint64 handle = (uint64)CreateSemaphoreW(NULL, initialCount, INT_MAX, NULL);
@@ -139,20 +316,9 @@ namespace HE
         WaitForSingleObject((HANDLE)semaphore, 0xFFFFFFFF);
     }
 
-    static FiberData* GetCurrentFiberData()
-    {
-        ASSERT(IsThreadAFiber());
-        return (FiberData*)GetFiberData();
-    }
-
-    static uint64 ConvertCurrentThreadToFiber(void* fiber)
-    {
-        return (uint64)ConvertThreadToFiberEx(fiber, FIBER_FLAG_FLOAT_SWITCH);
-    }
-
-    static bool ConvertCurrentFiberToThread()
+    static void DestroySemaphore(uint64 semaphore)
     {
-        return ConvertFiberToThread();
+        CloseHandle((HANDLE)semaphore);
     }
 
     static DWORD WINAPI ThreadProc(LPVOID lpThreadParameter)
@@ -162,18 +328,6 @@ namespace HE
         return 0;
     }
 
-    static VOID WINAPI FiberProc(LPVOID lpFiberParameter)
-    {
-        FiberData* fiberData = (FiberData*)lpFiberParameter;
-        fiberData->fiberEntry(fiberData->userData);
-    }
-
-    static uint64 CreateFiber(uint32 stackSize, FiberData* fiberData)
-    {
-        uint64 handle = (uint64)CreateFiberEx(stackSize, stackSize, FIBER_FLAG_FLOAT_SWITCH, FiberProc, fiberData);
-        return handle;
-    }
-
     static WorkerThread CreateWokerThread(uint32 stackSize, ThreadData* threadData, const wchar_t* description)
     {
         DWORD threadID;
@@ -193,261 +347,1632 @@ namespace HE
 
         return thread;
     }
-#endif
 
-    static uint32 LoadCounter(JobSystemAtomicCounterHandle handle)
+    static void JoinWorkerThread(const WorkerThread& thread)
     {
-        ASSERT(handle);
-        uint32 index = handle - 1;
-        return gAtomicCounters[index].atomic.load(std::memory_order_acquire);
+        WaitForSingleObject((HANDLE)thread.handle, INFINITE);
+        CloseHandle((HANDLE)thread.handle);
     }
 
-    static void StoreCounter(JobSystemAtomicCounterHandle handle, uint32 value)
+    static void SetWorkerThreadAffinity(const WorkerThread& thread, uint32 processorID)
     {
-        ASSERT(handle);
-        uint32 index = handle - 1;
-        gAtomicCounters[index].atomic.store(value);
+        GROUP_AFFINITY affinity = {};
+        affinity.Group = (WORD)(processorID / 64);
+        affinity.Mask = (KAFFINITY)1 << (processorID % 64);
+        SetThreadGroupAffinity((HANDLE)thread.handle, &affinity, nullptr);
     }
-
-    static void FetchSubCounter(JobSystemAtomicCounterHandle handle)
+#else
+    static uint32 GetNumberOfProcessors()
     {
-        ASSERT(handle);
-        uint32 index = handle - 1;
-        gAtomicCounters[index].atomic.fetch_sub(1);
-
+        return (uint32)sysconf(_SC_NPROCESSORS_ONLN);
     }
 
-    static void FreeCounter(JobSystemAtomicCounterHandle handle)
+    static void SuspendCurrentThread(float seconds)
     {
-        ASSERT(handle);
-        uint32 index = handle - 1;
-        gFreeCounterQueue.push(gAtomicCounters[index].index);
+        usleep((useconds_t)(seconds * 1000000.0f + 0.5f));
     }
 
-    static bool FindFreeCounter(uint32& outIndex)
+    static void YieldCPU()
     {
-        return gFreeCounterQueue.try_pop(outIndex);
+        _mm_pause();
     }
 
-    static bool FindFreeFiber(uint32& outIndex)
+    static uint32 GetCurrentThreadID()
     {
-        return gFreeFiberQueue.try_pop(outIndex);
+        return (uint32)syscall(SYS_gettid);
     }
 
-    static void FiberEntry(void* userData)
+    /** Counting semaphore on a futex, so that releasing N waiters is a single FUTEX_WAKE rather than N sem_post calls. */
+    struct FutexSemaphore
     {
-        Fiber* currentFiber = (Fiber*)userData;
+        std::atomic<int32> count;
+    };
 
-        while (!gInitialized)
-        {
-            YieldCPU();
-        }
+    static uint64 CreateSemaphoreEXT(uint32 initialCount)
+    {
+        FutexSemaphore* semaphore = new FutexSemaphore;
+        semaphore->count.store((int32)initialCount);
+        return (uint64)semaphore;
+    }
 
-        SleepingFiber sleepingFiber;
-        Job job;
+    static void SemaphoreAdd(uint64 semaphore, uint32 count)
+    {
+        FutexSemaphore* futexSemaphore = (FutexSemaphore*)semaphore;
+        futexSemaphore->count.fetch_add((int32)count, std::memory_order_release);
+        syscall(SYS_futex, (int32*)&futexSemaphore->count, FUTEX_WAKE_PRIVATE, (int32)count, nullptr, nullptr, 0);
+    }
 
+    static void SemaphoreWait(uint64 semaphore)
+    {
+        FutexSemaphore* futexSemaphore = (FutexSemaphore*)semaphore;
         while (true)
         {
-            if (currentFiber->sleepingFiberToSchedule.fiber != nullptr)
-            {
-                gSleepingFiberQueue.push(currentFiber->sleepingFiberToSchedule);
-                currentFiber->sleepingFiberToSchedule.fiber = nullptr;
-            }
-
-            const bool haveAnySleepingFibers = gSleepingFiberQueue.try_pop(sleepingFiber);
-
-            if (haveAnySleepingFibers)
-            {
-                if (LoadCounter(sleepingFiber.counterHandle) == sleepingFiber.condition)
-                {
-                    gFreeFiberQueue.push(currentFiber->index);
-                    SwitchToAnotherFiber(sleepingFiber.fiber->handle);
-                    continue;
-                }
-                else
-                {
-                    gSleepingFiberQueue.push(sleepingFiber);
-                }
-            }
-
-            // Last in first out (LIFO)
-            if (gJobQueue.try_pop(job))
+            int32 count = futexSemaphore->count.load(std::memory_order_relaxed);
+            while (count > 0)
             {
-                if (job.decl.jobFunc)
+                if (futexSemaphore->count.compare_exchange_weak(count, count - 1, std::memory_order_acquire, std::memory_order_relaxed))
                 {
-                    job.decl.jobFunc(job.decl.data);
+                    return;
                 }
-                FetchSubCounter(job.counterHandle);
-            }
-            else if (!haveAnySleepingFibers)
-            {
-                const uint32 key = GetCurrentThreadID();
-                SemaphoreWait(gSemaphores[gThreadIdSemaphoreLUT[key]].handle);
-            }
-        }
-
-        uint32 threadID = GetCurrentThreadID();
-
-        uint32 threadIndex = 0;
-        for (uint32 i = 0; i < gWorkerThreadCount; i++)
-        {
-            if (gWorkerThreadIDs[i] == threadID)
-            {
-                threadIndex = i;
-                break;
             }
+            // Returns right away if the count changed in the meantime.
+            syscall(SYS_futex, (int32*)&futexSemaphore->count, FUTEX_WAIT_PRIVATE, 0, nullptr, nullptr, 0);
         }
-
-        uint64 fiberHandle = ((Fiber*)GetCurrentFiberData()->userData)->handle;
-        if (fiberHandle != gFibers[threadIndex].handle)
-        {
-            SwitchToAnotherFiber(gFibers[threadIndex].handle);
-        }
-
-        ConvertCurrentFiberToThread();
     }
 
-    static void WorkerThreadEntry(void* userData)
+    static void DestroySemaphore(uint64 semaphore)
     {
-        WorkerThreadUserData* workerThreadUserData = (WorkerThreadUserData*)userData;
-
-        uint32 workerThreadIndex = workerThreadUserData->workerThreadIndex;
-
-        gFiberData[workerThreadIndex].fiberEntry = FiberEntry;
-        gFiberData[workerThreadIndex].userData = &gFibers[workerThreadIndex];
-
-        Fiber& fiber = gFibers[workerThreadIndex];
-        fiber.index = workerThreadIndex;
-        fiber.handle = ConvertCurrentThreadToFiber(&gFiberData[workerThreadIndex]);
-        fiber.sleepingFiberToSchedule.fiber = nullptr;
+        delete (FutexSemaphore*)semaphore;
+    }
 
-        workerThreadUserData->bootAtomic->fetch_sub(1);
+    struct ThreadStartData
+    {
+        ThreadData* threadData;
+        std::atomic<uint32> threadID;
+    };
 
-        FiberEntry(&gFibers[workerThreadIndex]);
+    static void* ThreadProc(void* parameter)
+    {
+        ThreadStartData* startData = (ThreadStartData*)parameter;
+        ThreadData* threadData = startData->threadData;
+        startData->threadID.store(GetCurrentThreadID(), std::memory_order_release);
+        threadData->threadEntry(threadData->userData);
+        return nullptr;
     }
 
-    void JobSystemInit(uint32 numWorkerThreads, uint32 numFibers, uint32 fiberStackSize)
+    static WorkerThread CreateWokerThread(uint32 stackSize, ThreadData* threadData, const wchar_t* description)
     {
-        ASSERT(!gInitialized);
-        ASSERT(numWorkerThreads <= JOB_SYSTEM_MAX_NUM_WORKER_THREADS);
-        ASSERT(numFibers >= numWorkerThreads && (numFibers & (numFibers - 1)) == 0 && numFibers <= JOB_SYSTEM_MAX_NUM_FIBERS);
-
-        std::atomic<uint32> bootAtomic;
-        bootAtomic.store(numWorkerThreads);
+        ThreadStartData startData;
+        startData.threadData = threadData;
+        startData.threadID.store(0);
 
-        for (uint32 workerThreadIndex = 0; workerThreadIndex < numWorkerThreads; workerThreadIndex++)
+        pthread_attr_t attr;
+        pthread_attr_init(&attr);
+        if (stackSize)
         {
-            gWorkerThreadUserData[workerThreadIndex].workerThreadIndex = workerThreadIndex;
-            gWorkerThreadUserData[workerThreadIndex].bootAtomic = &bootAtomic;
-
-            gThreadData[workerThreadIndex].threadEntry = WorkerThreadEntry;
-            gThreadData[workerThreadIndex].userData = &gWorkerThreadUserData[workerThreadIndex];
-
-            wchar description[100];
-            wsprintf(description, L"JobSystem::WorkerThread %d", workerThreadIndex);
-            gWorkerThreads[workerThreadIndex] = CreateWokerThread(0, &gThreadData[workerThreadIndex], description);
-
-            gSemaphores[workerThreadIndex].handle = CreateSemaphoreEXT(0);
-
-            const uint32 key = gWorkerThreads[workerThreadIndex].id;
-            gThreadIdSemaphoreLUT.emplace(key, workerThreadIndex);
+            pthread_attr_setstacksize(&attr, stackSize);
         }
-        gWorkerThreadCount = numWorkerThreads;
+        pthread_t handle;
+        int result = pthread_create(&handle, &attr, ThreadProc, &startData);
+        ASSERT(result == 0);
+        pthread_attr_destroy(&attr);
 
-        while (bootAtomic.load(std::memory_order_acquire) != 0)
+        if (description)
         {
-            SuspendCurrentThread(0.01f);
+            // Linux limits thread names to 15 characters.
+            char name[16] = {};
+            for (uint32 i = 0; i < 15 && description[i]; i++)
+            {
+                name[i] = (char)description[i];
+            }
+            pthread_setname_np(handle, name);
         }
 
-        for (uint32 i = 0; i < JOB_SYSTEM_MAX_NUM_JOBS; i++)
+        // The worker thread ID is only known once the thread runs.
+        while (startData.threadID.load(std::memory_order_acquire) == 0)
         {
-            gAtomicCounters[i].index = i;
-            gFreeCounterQueue.push(i);
+            YieldCPU();
         }
 
-        Fiber fiber = {};
-        for (uint32 fiberIndex = gWorkerThreadCount; fiberIndex < gFiberCount; fiberIndex++)
-        {
-            gFiberData[fiberIndex].fiberEntry = FiberEntry;
-            gFiberData[fiberIndex].userData = &gFibers[fiberIndex];
-
-            fiber.handle = CreateFiber(fiberStackSize, &gFiberData[fiberIndex]);
-            fiber.index = fiberIndex;
-
-            gFibers[fiberIndex] = fiber;
-            gFreeFiberQueue.push(fiberIndex);
-        }
-        gFiberCount = numFibers;
-        gNextWorkerThreadIndex = 0;
+        WorkerThread thread;
+        thread.handle = (uint64)handle;
+        thread.id = startData.threadID.load(std::memory_order_relaxed);
 
-        gInitialized.store(true, std::memory_order_release);
+        return thread;
+    }
 
-        HE_LOG_INFO("Job system init.");
+    static void JoinWorkerThread(const WorkerThread& thread)
+    {
+        pthread_join((pthread_t)thread.handle, nullptr);
     }
 
-    void JobSystemExit()
+    static void SetWorkerThreadAffinity(const WorkerThread& thread, uint32 processorID)
     {
-        ASSERT(gInitialized);
-        HE_LOG_INFO("Job system exit.");
-        // TODO
+        cpu_set_t cpuSet;
+        CPU_ZERO(&cpuSet);
+        CPU_SET(processorID, &cpuSet);
+        pthread_setaffinity_np((pthread_t)thread.handle, sizeof(cpuSet), &cpuSet);
     }
+#endif
 
-    JobSystemAtomicCounterHandle JobSystemRunJobs(JobSystemJobDecl* jobDecls, uint32 numJobs)
+#if HE_JOB_SYSTEM_USER_SPACE_FIBERS
+    FiberStackPool gFiberStackPool;
+
+    /**
+     * Context of the fiber running on this thread.
+     * Fibers migrate between threads, so it is only accessed through non-inlined functions.
+     * Otherwise the compiler may cache the TLS address across a fiber switch.
+     */
+    thread_local FiberContext* tCurrentFiberContext = nullptr;
+
+    static NOINLINE FiberContext* GetCurrentFiberContext()
     {
-        uint32 freeCounterIndex;
-        while (!FindFreeCounter(freeCounterIndex));
+        return tCurrentFiberContext;
+    }
 
-        JobSystemAtomicCounterHandle freeCounter = freeCounterIndex + 1;
-        StoreCounter(freeCounter, numJobs);
+    static NOINLINE void SetCurrentFiberContext(FiberContext* context)
+    {
+        tCurrentFiberContext = context;
+    }
 
-        Job job = {};
-        job.counterHandle = freeCounter;
+    static void SwitchToAnotherFiber(uint64 handle)
+    {
+        FiberContext* from = GetCurrentFiberContext();
+        FiberContext* to = (FiberContext*)handle;
+        SetCurrentFiberContext(to);
+        FiberContextSwitch(from, to);
+    }
 
-        for (uint32 jobIndex = 0; jobIndex < numJobs; jobIndex++)
-        {
-            job.decl = jobDecls[jobIndex];
+    static FiberData* GetCurrentFiberData()
+    {
+        ASSERT(GetCurrentFiberContext());
+        return (FiberData*)GetCurrentFiberContext()->userData;
+    }
 
-            gJobQueue.push(job);
+    static uint64 ConvertCurrentThreadToFiber(void* fiber)
+    {
+        FiberContext* context = new FiberContext();
+        context->userData = fiber;
+        SetCurrentFiberContext(context);
+        return (uint64)context;
+    }
 
-            uint32 workerThreadIndex = gNextWorkerThreadIndex.fetch_add(1);
-            SemaphoreAdd(gSemaphores[workerThreadIndex % gWorkerThreadCount].handle, 1);
-        }
+    static bool ConvertCurrentFiberToThread()
+    {
+        FiberContext* context = GetCurrentFiberContext();
+        ASSERT(context && !context->stack.allocationBase);
+        SetCurrentFiberContext(nullptr);
+        delete context;
+        return true;
+    }
 
-        return freeCounter;
+    static void FiberProc(void* userData)
+    {
+        FiberData* fiberData = (FiberData*)userData;
+        fiberData->fiberEntry(fiberData->userData);
+        // Fiber entries never return, there is no context to return to.
+        ABORT();
     }
 
-    void JobSystemWaitForCounter(JobSystemAtomicCounterHandle counterHandle, uint32 condition)
+    static uint64 CreateFiber(uint32 stackSize, FiberData* fiberData)
     {
-        if (LoadCounter(counterHandle) != condition)
-        {
-            uint32 freeFiberIndex;
-            while (!FindFreeFiber(freeFiberIndex));
+        FiberContext* context = new FiberContext();
+        FiberContextInit(context, gFiberStackPool.Allocate(stackSize), FiberProc, fiberData);
+        return (uint64)context;
+    }
 
-            Fiber* nextFiber = &gFibers[freeFiberIndex];
-            Fiber* currentFiber = (Fiber*)(GetCurrentFiberData()->userData);
+    static void DestroyFiber(uint64 handle)
+    {
+        FiberContext* context = (FiberContext*)handle;
+        gFiberStackPool.Free(context->stack);
+        delete context;
+    }
+#else
+    static void SwitchToAnotherFiber(uint64 handle)
+    {
+        SwitchToFiber((void*)handle);
+    }
 
-            nextFiber->sleepingFiberToSchedule = {
-                condition,
-                counterHandle,
-                currentFiber
-            };
+    static FiberData* GetCurrentFiberData()
+    {
+        ASSERT(IsThreadAFiber());
+        return (FiberData*)GetFiberData();
+    }
 
-            SwitchToAnotherFiber(nextFiber->handle);
-        }
+    static uint64 ConvertCurrentThreadToFiber(void* fiber)
+    {
+        return (uint64)ConvertThreadToFiberEx(fiber, FIBER_FLAG_FLOAT_SWITCH);
     }
 
-    void JobSystemWaitForCounterAndFree(JobSystemAtomicCounterHandle counterHandle, uint32 condition)
+    static bool ConvertCurrentFiberToThread()
     {
-        JobSystemWaitForCounter(counterHandle, condition);
-        FreeCounter(counterHandle);
+        return ConvertFiberToThread();
     }
 
-    void JobSystemWaitForCounterAndFreeWithoutFiber(JobSystemAtomicCounterHandle counterHandle)
+    static VOID WINAPI FiberProc(LPVOID lpFiberParameter)
     {
-        while (LoadCounter(counterHandle) != 0)
-        {
+        FiberData* fiberData = (FiberData*)lpFiberParameter;
+        fiberData->fiberEntry(fiberData->userData);
+    }
+
+    static uint64 CreateFiber(uint32 stackSize, FiberData* fiberData)
+    {
+        uint64 handle = (uint64)CreateFiberEx(stackSize, stackSize, FIBER_FLAG_FLOAT_SWITCH, FiberProc, fiberData);
+        return handle;
+    }
+
+    static void DestroyFiber(uint64 handle)
+    {
+        DeleteFiber((void*)handle);
+    }
+#endif
+
+    static AtomicCounter& GetAtomicCounter(JobSystemAtomicCounterHandle handle)
+    {
+        ASSERT(handle);
+        uint32 index = handle - 1;
+        return gAtomicCounterChunks[index / AtomicCounterChunkSize].load(std::memory_order_relaxed)->counters[index % AtomicCounterChunkSize];
+    }
+
+    static uint32 LoadCounter(JobSystemAtomicCounterHandle handle)
+    {
+        return GetAtomicCounter(handle).atomic.load(std::memory_order_acquire);
+    }
+
+    static void StoreCounter(JobSystemAtomicCounterHandle handle, uint32 value)
+    {
+        GetAtomicCounter(handle).atomic.store(value);
+    }
+
+    static void UpdateHighWaterMark(std::atomic<uint32>& highWaterMark, uint32 value)
+    {
+        uint32 current = highWaterMark.load(std::memory_order_relaxed);
+        while (value > current && !highWaterMark.compare_exchange_weak(current, value, std::memory_order_relaxed));
+    }
+
+    static void LockWaitList(AtomicCounter& counter)
+    {
+        while (counter.waitListLock.exchange(true, std::memory_order_acquire))
+        {
+            while (counter.waitListLock.load(std::memory_order_relaxed))
+            {
+                YieldCPU();
+            }
+        }
+    }
+
+    static void UnlockWaitList(AtomicCounter& counter)
+    {
+        counter.waitListLock.store(false, std::memory_order_release);
+    }
+
+    /** Wakes up to count sleeping workers with a single semaphore release. Must be called after the work has been published. */
+    static void WakeWorkers(uint32 count)
+    {
+        // Pairs with the fence in WorkerSleep(): either the worker sees the work when it rechecks, or we see the worker here.
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        uint32 numSleepingWorkers = gNumSleepingWorkers.load(std::memory_order_relaxed);
+        uint32 numWakes;
+        do
+        {
+            numWakes = (count < numSleepingWorkers) ? count : numSleepingWorkers;
+            if (numWakes == 0)
+            {
+                return;
+            }
+        } while (!gNumSleepingWorkers.compare_exchange_weak(numSleepingWorkers, numSleepingWorkers - numWakes, std::memory_order_relaxed));
+        SemaphoreAdd(gWakeSemaphore.handle, numWakes);
+    }
+
+    /** Called after taking a job from a shared queue, lets one submitter blocked on that queue in PushJob() retry. */
+    static void WakeBlockedSubmitter(uint32 priority)
+    {
+        // Pairs with the fence in PushJob(): either the submitter sees the free slot when it retries, or we see the submitter here.
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        uint32 numBlockedSubmitters = gNumBlockedSubmitters[priority].load(std::memory_order_relaxed);
+        do
+        {
+            if (numBlockedSubmitters == 0)
+            {
+                return;
+            }
+        } while (!gNumBlockedSubmitters[priority].compare_exchange_weak(numBlockedSubmitters, numBlockedSubmitters - 1, std::memory_order_relaxed));
+        SemaphoreAdd(gSubmitterSemaphores[priority].handle, 1);
+    }
+
+    static void MakeFiberReady(Fiber* fiber)
+    {
+        gReadyFiberQueue.push(fiber);
+        // The workers may all be asleep, one of them has to come and resume the fiber.
+        WakeWorkers(1);
+    }
+
+    /** Adds the (already switched away from) fiber to the counter's wait list, or makes it ready right away if the counter got there in the meantime. */
+    static void ParkFiber(Fiber* fiber, JobSystemAtomicCounterHandle handle)
+    {
+        AtomicCounter& counter = GetAtomicCounter(handle);
+
+        // Announce the waiter before looking at the counter, FetchSubCounter() does the opposite. With both sequentially consistent,
+        // either the decrement sees the waiter and takes the lock, or this load sees the decremented value.
+        counter.numWaiters.fetch_add(1, std::memory_order_seq_cst);
+        LockWaitList(counter);
+        if (counter.atomic.load(std::memory_order_seq_cst) == fiber->waitCondition)
+        {
+            UnlockWaitList(counter);
+            counter.numWaiters.fetch_sub(1, std::memory_order_relaxed);
+            MakeFiberReady(fiber);
+            return;
+        }
+        fiber->nextWaitingFiber = counter.waitingFibers;
+        counter.waitingFibers = fiber;
+        UnlockWaitList(counter);
+    }
+
+    static void ScheduleContinuation(JobSystemCounterContinuation* continuation);
+
+    static void FetchSubCounter(JobSystemAtomicCounterHandle handle)
+    {
+        AtomicCounter& counter = GetAtomicCounter(handle);
+        counter.atomic.fetch_sub(1, std::memory_order_seq_cst);
+
+        if (counter.numWaiters.load(std::memory_order_seq_cst) == 0)
+        {
+            return;
+        }
+
+        // Unlink the waiters whose condition is met and resume them outside of the lock. The value is read under the lock
+        // rather than taken from the decrement: another decrement may have completed in between, woken a waiter that freed
+        // the counter, and the counter may already be reused with new waiters that this stale value must not wake.
+        Fiber* readyFibers = nullptr;
+        JobSystemCounterContinuation* readyContinuations = nullptr;
+        LockWaitList(counter);
+        const uint32 value = counter.atomic.load(std::memory_order_seq_cst);
+        Fiber** link = &counter.waitingFibers;
+        while (*link)
+        {
+            Fiber* fiber = *link;
+            if (fiber->waitCondition == value)
+            {
+                *link = fiber->nextWaitingFiber;
+                fiber->nextWaitingFiber = readyFibers;
+                readyFibers = fiber;
+                counter.numWaiters.fetch_sub(1, std::memory_order_relaxed);
+            }
+            else
+            {
+                link = &fiber->nextWaitingFiber;
+            }
+        }
+        JobSystemCounterContinuation** continuationLink = &counter.waitingContinuations;
+        while (*continuationLink)
+        {
+            JobSystemCounterContinuation* continuation = *continuationLink;
+            if (continuation->condition == value)
+            {
+                *continuationLink = continuation->next;
+                continuation->next = readyContinuations;
+                readyContinuations = continuation;
+                counter.numWaiters.fetch_sub(1, std::memory_order_relaxed);
+            }
+            else
+            {
+                continuationLink = &continuation->next;
+            }
+        }
+        UnlockWaitList(counter);
+
+        while (readyContinuations)
+        {
+            // The coroutine may run (and finish) as soon as it is scheduled, so the node is unlinked first.
+            JobSystemCounterContinuation* continuation = readyContinuations;
+            readyContinuations = continuation->next;
+            ScheduleContinuation(continuation);
+        }
+
+        while (readyFibers)
+        {
+            Fiber* fiber = readyFibers;
+            readyFibers = fiber->nextWaitingFiber;
+            MakeFiberReady(fiber);
+        }
+    }
+
+    static void FreeCounter(JobSystemAtomicCounterHandle handle)
+    {
+        gNumCountersInUse.fetch_sub(1, std::memory_order_relaxed);
+        gFreeCounterQueue.push(GetAtomicCounter(handle).index);
+    }
+
+    static bool FindFreeCounter(uint32& outIndex)
+    {
+        if (!gFreeCounterQueue.try_pop(outIndex))
+        {
+            return false;
+        }
+        UpdateHighWaterMark(gMaxNumCountersInUse, gNumCountersInUse.fetch_add(1, std::memory_order_relaxed) + 1);
+        return true;
+    }
+
+    /** Must be called with gPoolGrowthMutex held (or before the workers start). */
+    static void AddAtomicCounterChunk()
+    {
+        const uint32 chunkIndex = gNumAtomicCounterChunks++;
+        AtomicCounterChunk* chunk = new AtomicCounterChunk();
+        for (uint32 i = 0; i < AtomicCounterChunkSize; i++)
+        {
+            chunk->counters[i].index = chunkIndex * AtomicCounterChunkSize + i;
+        }
+        gAtomicCounterChunks[chunkIndex].store(chunk, std::memory_order_relaxed);
+        for (uint32 i = 0; i < AtomicCounterChunkSize; i++)
+        {
+            gFreeCounterQueue.push(chunk->counters[i].index);
+        }
+    }
+
+    /** Adds a chunk of counters. Returns false if the pool is at JOB_SYSTEM_MAX_NUM_COUNTERS and none is free. */
+    static bool GrowCounterPool()
+    {
+        std::lock_guard<std::mutex> lock(gPoolGrowthMutex);
+        if (!gFreeCounterQueue.empty())
+        {
+            // Another thread grew the pool or a counter was freed in the meantime.
+            return true;
+        }
+        if (gNumAtomicCounterChunks == MaxNumAtomicCounterChunks)
+        {
+            return false;
+        }
+        AddAtomicCounterChunk();
+        return true;
+    }
+
+    static void FreeFiber(Fiber* fiber)
+    {
+        gNumFibersInUse.fetch_sub(1, std::memory_order_relaxed);
+        gFreeFiberQueue.push(fiber->index);
+    }
+
+    static bool FindFreeFiber(uint32& outIndex)
+    {
+        if (!gFreeFiberQueue.try_pop(outIndex))
+        {
+            return false;
+        }
+        UpdateHighWaterMark(gMaxNumFibersInUse, gNumFibersInUse.fetch_add(1, std::memory_order_relaxed) + 1);
+        return true;
+    }
+
+    static void FiberEntry(void* userData);
+
+    static void CreatePoolFiber(uint32 fiberIndex)
+    {
+        gFiberData[fiberIndex].fiberEntry = FiberEntry;
+        gFiberData[fiberIndex].userData = &gFibers[fiberIndex];
+
+        Fiber fiber = {};
+        fiber.handle = CreateFiber(gFiberStackSize, &gFiberData[fiberIndex]);
+        fiber.index = fiberIndex;
+        gFibers[fiberIndex] = fiber;
+    }
+
+    /** Adds a chunk of fibers. Returns false if the pool is at JOB_SYSTEM_MAX_NUM_FIBERS and none is free. */
+    static bool GrowFiberPool()
+    {
+        std::lock_guard<std::mutex> lock(gPoolGrowthMutex);
+        if (!gFreeFiberQueue.empty())
+        {
+            return true;
+        }
+        if (gFiberCount == JOB_SYSTEM_MAX_NUM_FIBERS)
+        {
+            return false;
+        }
+
+        const uint32 firstFiberIndex = gFiberCount;
+        gFiberCount = (gFiberCount + FiberChunkSize < JOB_SYSTEM_MAX_NUM_FIBERS) ? (gFiberCount + FiberChunkSize) : JOB_SYSTEM_MAX_NUM_FIBERS;
+        for (uint32 fiberIndex = firstFiberIndex; fiberIndex < gFiberCount; fiberIndex++)
+        {
+            CreatePoolFiber(fiberIndex);
+            gFreeFiberQueue.push(fiberIndex);
+        }
+        return true;
+    }
+
+    /** Index of the worker thread, set once when the worker starts. Like tCurrentFiberContext, only accessed through non-inlined functions. */
+    thread_local uint32 tWorkerThreadIndex = JOB_SYSTEM_INVALID_WORKER_THREAD_INDEX;
+
+    static NOINLINE uint32 GetCurrentWorkerThreadIndex()
+    {
+        return tWorkerThreadIndex;
+    }
+
+    static NOINLINE void SetCurrentWorkerThreadIndex(uint32 workerThreadIndex)
+    {
+        tWorkerThreadIndex = workerThreadIndex;
+    }
+
+    static uint32 RandomNumber(uint32 workerThreadIndex)
+    {
+        // Xorshift, seeded per thread so that thieves spread over different victims.
+        thread_local uint32 state = 0x9E3779B9u ^ (workerThreadIndex * 0x85EBCA6Bu + 1);
+        state ^= state << 13;
+        state ^= state >> 17;
+        state ^= state << 5;
+        return state;
+    }
+
+    static bool TryRunPendingJob();
+
+    static void PushJob(const Job& job)
+    {
+        const uint32 priority = (uint32)job.priority;
+        const uint32 workerThreadIndex = GetCurrentWorkerThreadIndex();
+        if (gWorkStealingEnabled.load(std::memory_order_relaxed))
+        {
+            if (workerThreadIndex != JOB_SYSTEM_INVALID_WORKER_THREAD_INDEX && gWorkerJobQueues[priority][workerThreadIndex].Push(job))
+            {
+                return;
+            }
+        }
+        // Submissions from outside the pool (or from a worker whose deque is full) go through the shared queue.
+        MPMCQueue<Job>& queue = gJobQueues[priority];
+        if (!queue.try_push(job))
+        {
+            // Backpressure: a worker runs queued jobs itself until there is room again, which also keeps a single worker
+            // from blocking on its own queue.
+            gNumStalls.fetch_add(1, std::memory_order_relaxed);
+            if (workerThreadIndex != JOB_SYSTEM_INVALID_WORKER_THREAD_INDEX)
+            {
+                while (!queue.try_push(job))
+                {
+                    if (!TryRunPendingJob())
+                    {
+                        YieldCPU();
+                    }
+                }
+            }
+            else
+            {
+                // Other threads sleep until a worker takes a job from this queue, see WakeBlockedSubmitter().
+                while (true)
+                {
+                    gNumBlockedSubmitters[priority].fetch_add(1, std::memory_order_relaxed);
+                    std::atomic_thread_fence(std::memory_order_seq_cst);
+                    if (queue.try_push(job))
+                    {
+                        // Back out. If a wake-up has already claimed this submitter, its semaphore release has to be consumed.
+                        uint32 numBlockedSubmitters = gNumBlockedSubmitters[priority].load(std::memory_order_relaxed);
+                        while (true)
+                        {
+                            if (numBlockedSubmitters == 0)
+                            {
+                                SemaphoreWait(gSubmitterSemaphores[priority].handle);
+                                break;
+                            }
+                            if (gNumBlockedSubmitters[priority].compare_exchange_weak(numBlockedSubmitters, numBlockedSubmitters - 1, std::memory_order_relaxed))
+                            {
+                                break;
+                            }
+                        }
+                        break;
+                    }
+                    // The batch is only announced after its last push, the workers may still be asleep on a full queue.
+                    WakeWorkers(gWorkerThreadCount);
+                    SemaphoreWait(gSubmitterSemaphores[priority].handle);
+                }
+            }
+        }
+        const std::ptrdiff_t numQueuedJobs = queue.size();
+        if (numQueuedJobs > 0)
+        {
+            UpdateHighWaterMark(gMaxNumQueuedJobs, (uint32)numQueuedJobs);
+        }
+    }
+
+    static bool PopJobWithPriority(uint32 workerThreadIndex, uint32 priority, Job& outJob)
+    {
+        // Own deque first (LIFO, hot in cache), then the shared queue, then steal.
+        if (gWorkerJobQueues[priority][workerThreadIndex].Pop(outJob))
+        {
+            return true;
+        }
+        if (gJobQueues[priority].try_pop(outJob))
+        {
+            WakeBlockedSubmitter(priority);
+            return true;
+        }
+        // Workers sharing our L3 first, starting at a random one so that thieves spread out, then the others from near to far.
+        // Every worker is visited once, so that a woken worker never misses a job sitting in a busy worker's deque.
+        const uint8* victims = gStealVictims[workerThreadIndex];
+        const uint32 numLocalVictims = gNumLocalStealVictims[workerThreadIndex];
+        const uint32 firstLocalVictim = (numLocalVictims > 0) ? RandomNumber(workerThreadIndex) % numLocalVictims : 0;
+        for (uint32 i = 0; i + 1 < gWorkerThreadCount; i++)
+        {
+            const uint32 victim = (i < numLocalVictims) ? victims[(firstLocalVictim + i) % numLocalVictims] : victims[i];
+            if (gWorkerJobQueues[priority][victim].Steal(outJob))
+            {
+                HE_JOB_SYSTEM_TRACE(Steal, nullptr, victim);
+                return true;
+            }
+        }
+        return false;
+    }
+
+    static bool TryAcquireBackgroundSlot()
+    {
+        uint32 running = gNumRunningBackgroundJobs.load(std::memory_order_relaxed);
+        while (running < gMaxNumRunningBackgroundJobs)
+        {
+            if (gNumRunningBackgroundJobs.compare_exchange_weak(running, running + 1, std::memory_order_acquire, std::memory_order_relaxed))
+            {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    static void ReleaseBackgroundSlot()
+    {
+        gNumRunningBackgroundJobs.fetch_sub(1, std::memory_order_release);
+    }
+
+    static bool PopJob(uint32 workerThreadIndex, Job& outJob)
+    {
+        // Lanes are drained strictly in priority order.
+        if (PopJobWithPriority(workerThreadIndex, (uint32)JobSystemJobPriority::High, outJob))
+        {
+            return true;
+        }
+        if (PopJobWithPriority(workerThreadIndex, (uint32)JobSystemJobPriority::Normal, outJob))
+        {
+            return true;
+        }
+        // Background jobs may only occupy a limited number of workers, the others stay available for frame-critical work.
+        if (TryAcquireBackgroundSlot())
+        {
+            if (PopJobWithPriority(workerThreadIndex, (uint32)JobSystemJobPriority::Background, outJob))
+            {
+                return true;
+            }
+            ReleaseBackgroundSlot();
+        }
+        return false;
+    }
+
+    static void RunJob(const Job& job)
+    {
+        HE_JOB_SYSTEM_TRACE(JobBegin, job.decl.name, (uint32)job.priority);
+        if (job.decl.jobFunc)
+        {
+            job.decl.jobFunc(job.decl.data);
+        }
+        HE_JOB_SYSTEM_TRACE(JobEnd, job.decl.name, (uint32)job.priority);
+        // Coroutine resumptions have no counter, their task signals its own completion.
+        if (job.counterHandle)
+        {
+            FetchSubCounter(job.counterHandle);
+        }
+    }
+
+    static void IOThreadEntry(void* userData)
+    {
+        while (true)
+        {
+            SemaphoreWait(gIOSemaphore.handle);
+            if (gExitRequested.load(std::memory_order_acquire))
+            {
+                break;
+            }
+            Job job;
+            if (gIOJobQueue.try_pop(job))
+            {
+                // Decrementing the counter readies the fibers and coroutines waiting for the I/O on the CPU workers.
+                RunJob(job);
+            }
+        }
+    }
+
+    static void ResumeCoroutineJob(void* data)
+    {
+        std::coroutine_handle<>::from_address(data).resume();
+    }
+
+    static void ScheduleContinuation(JobSystemCounterContinuation* continuation)
+    {
+        JobSystemResumeCoroutine(continuation->coroutine, continuation->priority);
+    }
+
+    /** Runs one queued job on the current fiber, for a worker that would otherwise only wait. Returns false on other threads or if nothing is queued. */
+    static bool TryRunPendingJob()
+    {
+        const uint32 workerThreadIndex = GetCurrentWorkerThreadIndex();
+        Job job;
+        if (workerThreadIndex == JOB_SYSTEM_INVALID_WORKER_THREAD_INDEX || !PopJob(workerThreadIndex, job))
+        {
+            return false;
+        }
+
+        // The job runs nested inside the current one, restore what FiberEntry() set for the outer job afterwards.
+        Fiber* currentFiber = (Fiber*)(GetCurrentFiberData()->userData);
+        const JobSystemJobPriority runningJobPriority = currentFiber->runningJobPriority;
+        currentFiber->runningJobPriority = job.priority;
+#if HE_JOB_SYSTEM_TRACING
+        const char* runningJobName = currentFiber->runningJobName;
+        currentFiber->runningJobName = job.decl.name;
+        // The outer slice is closed while the nested job runs. If that job parks this fiber, only its own slice is open
+        // and the worker can go on with other jobs, the outer slice reopens on whichever worker gets here.
+        HE_JOB_SYSTEM_TRACE(JobEnd, runningJobName, (uint32)runningJobPriority);
+#endif
+        RunJob(job);
+        if (job.priority == JobSystemJobPriority::Background)
+        {
+            ReleaseBackgroundSlot();
+        }
+        currentFiber->runningJobPriority = runningJobPriority;
+#if HE_JOB_SYSTEM_TRACING
+        currentFiber->runningJobName = runningJobName;
+        HE_JOB_SYSTEM_TRACE(JobBegin, runningJobName, (uint32)runningJobPriority);
+#endif
+        return true;
+    }
+
+    static bool RunMainThreadJob()
+    {
+        Job job;
+        if (!gMainThreadJobQueue.try_pop(job))
+        {
+            return false;
+        }
+        RunJob(job);
+        return true;
+    }
+
+    /** Approximate, only used to avoid going to sleep while there is work that a wake-up may already have been skipped for. */
+    static bool HasAnyWork()
+    {
+        if (!gReadyFiberQueue.empty())
+        {
+            return true;
+        }
+        for (uint32 priority = 0; priority < NumJobPriorities; priority++)
+        {
+            // Background jobs that cannot get a slot right now are picked up by the workers holding the slots.
+            if (priority == (uint32)JobSystemJobPriority::Background && gNumRunningBackgroundJobs.load(std::memory_order_relaxed) >= gMaxNumRunningBackgroundJobs)
+            {
+                continue;
+            }
+            if (!gJobQueues[priority].empty())
+            {
+                return true;
+            }
+            for (uint32 workerThreadIndex = 0; workerThreadIndex < gWorkerThreadCount; workerThreadIndex++)
+            {
+                if (!gWorkerJobQueues[priority][workerThreadIndex].IsEmpty())
+                {
+                    return true;
+                }
+            }
+        }
+        return false;
+    }
+
+    static void WorkerSleep()
+    {
+        gNumSleepingWorkers.fetch_add(1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (HasAnyWork())
+        {
+            // Back out. If a wake-up has already claimed this worker, its semaphore release has to be consumed below.
+            uint32 numSleepingWorkers = gNumSleepingWorkers.load(std::memory_order_relaxed);
+            while (numSleepingWorkers > 0)
+            {
+                if (gNumSleepingWorkers.compare_exchange_weak(numSleepingWorkers, numSleepingWorkers - 1, std::memory_order_relaxed))
+                {
+                    return;
+                }
+            }
+        }
+        HE_JOB_SYSTEM_TRACE(SleepBegin, nullptr, 0);
+        SemaphoreWait(gWakeSemaphore.handle);
+        HE_JOB_SYSTEM_TRACE(SleepEnd, nullptr, 0);
+    }
+
+    /** Must be called by a fiber right after every switch to it, see Fiber::fiberToFree. */
+    static void ProcessPendingFiberActions(Fiber* currentFiber)
+    {
+        if (currentFiber->fiberToFree != nullptr)
+        {
+            FreeFiber(currentFiber->fiberToFree);
+            currentFiber->fiberToFree = nullptr;
+        }
+        if (currentFiber->fiberToPark != nullptr)
+        {
+            if (currentFiber->parkWaitList != nullptr)
+            {
+                // The parked fiber decided to wait with the wait list locked, it is linked and the lock released only now.
+                JobSystemWaitList& waitList = *currentFiber->parkWaitList;
+                Fiber* fiber = currentFiber->fiberToPark;
+                fiber->nextWaitingFiber = nullptr;
+                if (waitList.tail)
+                {
+                    ((Fiber*)waitList.tail)->nextWaitingFiber = fiber;
+                }
+                else
+                {
+                    waitList.head = fiber;
+                }
+                waitList.tail = fiber;
+                JobSystemUnlockWaitList(waitList);
+                currentFiber->parkWaitList = nullptr;
+            }
+            else
+            {
+                ParkFiber(currentFiber->fiberToPark, currentFiber->parkCounterHandle);
+            }
+            currentFiber->fiberToPark = nullptr;
+        }
+    }
+
+    static void FiberEntry(void* userData)
+    {
+        Fiber* currentFiber = (Fiber*)userData;
+
+        while (!gInitialized)
+        {
+            YieldCPU();
+        }
+
+        ProcessPendingFiberActions(currentFiber);
+
+        Fiber* readyFiber;
+        Job job;
+        uint32 idleSpinCount = 0;
+
+        while (!gExitRequested.load(std::memory_order_acquire))
+        {
+            // Resumed fibers go first, they hold jobs that are already half done.
+            if (gReadyFiberQueue.try_pop(readyFiber))
+            {
+                // This fiber has nothing on its stack, it goes back to the pool once the ready fiber has taken over the thread.
+                readyFiber->fiberToFree = currentFiber;
+                HE_JOB_SYSTEM_TRACE(FiberSwitch, nullptr, readyFiber->index);
+                SwitchToAnotherFiber(readyFiber->handle);
+                // Picked from the pool again by JobSystemWaitForCounter().
+                ProcessPendingFiberActions(currentFiber);
+                continue;
+            }
+
+            // The fiber may have been resumed on another worker thread, so look the index up every iteration.
+            const uint32 workerThreadIndex = GetCurrentWorkerThreadIndex();
+
+            if (PopJob(workerThreadIndex, job))
+            {
+                idleSpinCount = 0;
+                currentFiber->runningJobPriority = job.priority;
+#if HE_JOB_SYSTEM_TRACING
+                currentFiber->runningJobName = job.decl.name;
+#endif
+                RunJob(job);
+                // If the job waited it resumes on this same fiber stack, so the slot taken in PopJob is released exactly once.
+                if (job.priority == JobSystemJobPriority::Background)
+                {
+                    ReleaseBackgroundSlot();
+                }
+            }
+            else if (idleSpinCount < JOB_SYSTEM_IDLE_SPIN_COUNT)
+            {
+                // Spin a little before sleeping, work often arrives right after a worker runs dry.
+                idleSpinCount++;
+                YieldCPU();
+            }
+            else
+            {
+                idleSpinCount = 0;
+                WorkerSleep();
+            }
+        }
+
+        // Leave through the worker thread's own fiber, it is the only one that can return to the thread entry.
+        // The fiber we are on stays suspended until JobSystemExit() destroys it.
+        SwitchToAnotherFiber(gWorkerThreadFibers[GetCurrentWorkerThreadIndex()].handle);
+    }
+
+    constexpr uint32 InvalidProcessorID = 0xFFFFFFFF;
+
+    /** Picks the processor of every worker (InvalidProcessorID if unpinned) and builds the steal orders from the cache groups of the picks. */
+    static void PlaceWorkerThreads(uint32 numWorkerThreads, JobSystemWorkerPlacement placement, uint32* outProcessorIDs)
+    {
+        uint32 cacheGroups[JOB_SYSTEM_MAX_NUM_WORKER_THREADS] = {};
+        uint32 numaNodes[JOB_SYSTEM_MAX_NUM_WORKER_THREADS] = {};
+        for (uint32 workerThreadIndex = 0; workerThreadIndex < numWorkerThreads; workerThreadIndex++)
+        {
+            outProcessorIDs[workerThreadIndex] = InvalidProcessorID;
+        }
+
+        if (placement == JobSystemWorkerPlacement::OnePerPhysicalCore)
+        {
+            const JobSystemCpuTopology topology = JobSystemQueryCpuTopology();
+
+            // First hardware threads of all cores before any SMT sibling, cores of a cache group and NUMA node next to each other.
+            std::vector<JobSystemLogicalProcessor> processors = topology.logicalProcessors;
+            auto SortKey = [](const JobSystemLogicalProcessor& processor)
+            {
+                return ((uint64)processor.smtIndex << 48) | ((uint64)processor.numaNodeIndex << 32) | ((uint64)processor.cacheGroupIndex << 16) | (uint64)processor.coreIndex;
+            };
+            std::stable_sort(processors.begin(), processors.end(), [&](const JobSystemLogicalProcessor& a, const JobSystemLogicalProcessor& b)
+            {
+                return SortKey(a) < SortKey(b);
+            });
+
+            for (uint32 workerThreadIndex = 0; workerThreadIndex < numWorkerThreads; workerThreadIndex++)
+            {
+                const JobSystemLogicalProcessor& processor = processors[workerThreadIndex % processors.size()];
+                outProcessorIDs[workerThreadIndex] = processor.id;
+                cacheGroups[workerThreadIndex] = processor.cacheGroupIndex;
+                numaNodes[workerThreadIndex] = processor.numaNodeIndex;
+            }
+
+            HE_LOG_INFO("Job system CPU topology: {} logical processors, {} physical cores, {} L3 cache groups, {} NUMA nodes.",
+                topology.logicalProcessors.size(), topology.numPhysicalCores, topology.numCacheGroups, topology.numNumaNodes);
+        }
+
+        for (uint32 workerThreadIndex = 0; workerThreadIndex < numWorkerThreads; workerThreadIndex++)
+        {
+            uint8* victims = gStealVictims[workerThreadIndex];
+            uint32 numVictims = 0;
+            for (uint32 victim = 0; victim < numWorkerThreads; victim++)
+            {
+                if (victim != workerThreadIndex && cacheGroups[victim] == cacheGroups[workerThreadIndex])
+                {
+                    victims[numVictims++] = (uint8)victim;
+                }
+            }
+            gNumLocalStealVictims[workerThreadIndex] = numVictims;
+
+            // Remote workers on the same NUMA node before the ones across the interconnect.
+            const uint32 firstRemoteVictim = numVictims;
+            for (uint32 victim = 0; victim < numWorkerThreads; victim++)
+            {
+                if (cacheGroups[victim] != cacheGroups[workerThreadIndex])
+                {
+                    victims[numVictims++] = (uint8)victim;
+                }
+            }
+            std::stable_sort(victims + firstRemoteVictim, victims + numVictims, [&](uint8 a, uint8 b)
+            {
+                return (numaNodes[a] != numaNodes[workerThreadIndex]) < (numaNodes[b] != numaNodes[workerThreadIndex]);
+            });
+        }
+    }
+
+    static void WorkerThreadEntry(void* userData)
+    {
+        WorkerThreadUserData* workerThreadUserData = (WorkerThreadUserData*)userData;
+
+        uint32 workerThreadIndex = workerThreadUserData->workerThreadIndex;
+        SetCurrentWorkerThreadIndex(workerThreadIndex);
+
+        // The thread's own fiber never runs jobs, it only waits here for the exit. So it is never handed to another thread.
+        Fiber& threadFiber = gWorkerThreadFibers[workerThreadIndex];
+        threadFiber.handle = ConvertCurrentThreadToFiber(&gWorkerThreadFiberData[workerThreadIndex]);
+        gWorkerThreadFiberData[workerThreadIndex].userData = &threadFiber;
+
+        uint32 freeFiberIndex;
+        while (!FindFreeFiber(freeFiberIndex));
+
+        workerThreadUserData->bootAtomic->fetch_sub(1);
+
+        SwitchToAnotherFiber(gFibers[freeFiberIndex].handle);
+
+        ConvertCurrentFiberToThread();
+    }
+
+    void JobSystemInit(uint32 numWorkerThreads, uint32 numFibers, uint32 fiberStackSize, JobSystemWorkerPlacement placement, uint32 numIOThreads)
+    {
+        ASSERT(!gInitialized);
+        ASSERT(numWorkerThreads <= JOB_SYSTEM_MAX_NUM_WORKER_THREADS);
+        ASSERT(numIOThreads > 0 && numIOThreads <= JOB_SYSTEM_MAX_NUM_IO_THREADS);
+        ASSERT(numFibers > 0 && (numFibers & (numFibers - 1)) == 0 && numFibers <= JOB_SYSTEM_MAX_NUM_FIBERS);
+
+        // Each worker takes a fiber when it starts, so round the pool up until there are spares left for waiting jobs,
+        // e.g. HE_JOB_SYSTEM_NUM_FIBIERS with one worker per logical processor on a 128-thread machine.
+        while (numFibers <= numWorkerThreads)
+        {
+            numFibers <<= 1;
+        }
+        ASSERT(numFibers <= JOB_SYSTEM_MAX_NUM_FIBERS);
+
+        // The counter pool starts at JOB_SYSTEM_MAX_NUM_JOBS and grows on demand, see JobSystemAllocateCounter().
+        for (uint32 i = 0; i < JOB_SYSTEM_MAX_NUM_JOBS / AtomicCounterChunkSize; i++)
+        {
+            AddAtomicCounterChunk();
+        }
+
+        // The pool is filled before the workers start, each of them takes a fiber to run on. It grows on demand, see JobSystemWaitForCounter().
+        gFiberCount = numFibers;
+        gFiberStackSize = fiberStackSize;
+        for (uint32 fiberIndex = 0; fiberIndex < gFiberCount; fiberIndex++)
+        {
+            CreatePoolFiber(fiberIndex);
+            gFreeFiberQueue.push(fiberIndex);
+        }
+
+        gWakeSemaphore.handle = CreateSemaphoreEXT(0);
+        gNumSleepingWorkers = 0;
+        for (uint32 priority = 0; priority < NumJobPriorities; priority++)
+        {
+            gSubmitterSemaphores[priority].handle = CreateSemaphoreEXT(0);
+            gNumBlockedSubmitters[priority] = 0;
+        }
+        gWorkerThreadCount = numWorkerThreads;
+
+        uint32 processorIDs[JOB_SYSTEM_MAX_NUM_WORKER_THREADS];
+        PlaceWorkerThreads(numWorkerThreads, placement, processorIDs);
+
+        std::atomic<uint32> bootAtomic;
+        bootAtomic.store(numWorkerThreads);
+
+        for (uint32 workerThreadIndex = 0; workerThreadIndex < numWorkerThreads; workerThreadIndex++)
+        {
+            gWorkerThreadUserData[workerThreadIndex].workerThreadIndex = workerThreadIndex;
+            gWorkerThreadUserData[workerThreadIndex].bootAtomic = &bootAtomic;
+
+            gThreadData[workerThreadIndex].threadEntry = WorkerThreadEntry;
+            gThreadData[workerThreadIndex].userData = &gWorkerThreadUserData[workerThreadIndex];
+
+            wchar description[100];
+            swprintf(description, 100, L"JobSystem::WorkerThread %d", workerThreadIndex);
+            gWorkerThreads[workerThreadIndex] = CreateWokerThread(0, &gThreadData[workerThreadIndex], description);
+            if (processorIDs[workerThreadIndex] != InvalidProcessorID)
+            {
+                SetWorkerThreadAffinity(gWorkerThreads[workerThreadIndex], processorIDs[workerThreadIndex]);
+            }
+
+            gWorkerThreadIDs[workerThreadIndex] = gWorkerThreads[workerThreadIndex].id;
+        }
+
+        while (bootAtomic.load(std::memory_order_acquire) != 0)
+        {
             SuspendCurrentThread(0.01f);
         }
+
+        // Not pinned, they spend their time blocked in the OS.
+        gIOSemaphore.handle = CreateSemaphoreEXT(0);
+        gIOThreadCount = numIOThreads;
+        for (uint32 ioThreadIndex = 0; ioThreadIndex < numIOThreads; ioThreadIndex++)
+        {
+            gIOThreadData[ioThreadIndex].threadEntry = IOThreadEntry;
+            gIOThreadData[ioThreadIndex].userData = nullptr;
+
+            wchar description[100];
+            swprintf(description, 100, L"JobSystem::IOThread %d", ioThreadIndex);
+            gIOThreads[ioThreadIndex] = CreateWokerThread(0, &gIOThreadData[ioThreadIndex], description);
+        }
+
+        gMainThreadID = GetCurrentThreadID();
+        gNumRunningBackgroundJobs = 0;
+        gMaxNumRunningBackgroundJobs = (numWorkerThreads > 1) ? (numWorkerThreads - 1) : 1;
+
+#if HE_JOB_SYSTEM_TRACING
+        JobSystemTraceInit(numWorkerThreads);
+#endif
+
+        gInitialized.store(true, std::memory_order_release);
+
+        HE_LOG_INFO("Job system init.");
+    }
+
+    void JobSystemExit()
+    {
+        ASSERT(gInitialized);
+
+        // Workers and I/O threads finish the job they are running and leave, jobs that are still queued are dropped.
+        // The I/O threads go first, the jobs they finish may still wake workers.
+        gExitRequested.store(true, std::memory_order_release);
+        SemaphoreAdd(gIOSemaphore.handle, gIOThreadCount);
+        for (uint32 ioThreadIndex = 0; ioThreadIndex < gIOThreadCount; ioThreadIndex++)
+        {
+            JoinWorkerThread(gIOThreads[ioThreadIndex]);
+        }
+        DestroySemaphore(gIOSemaphore.handle);
+
+        SemaphoreAdd(gWakeSemaphore.handle, gWorkerThreadCount);
+        for (uint32 workerThreadIndex = 0; workerThreadIndex < gWorkerThreadCount; workerThreadIndex++)
+        {
+            JoinWorkerThread(gWorkerThreads[workerThreadIndex]);
+        }
+
+        for (uint32 fiberIndex = 0; fiberIndex < gFiberCount; fiberIndex++)
+        {
+            DestroyFiber(gFibers[fiberIndex].handle);
+            gFibers[fiberIndex] = {};
+        }
+#if HE_JOB_SYSTEM_USER_SPACE_FIBERS
+        gFiberStackPool.ReleaseAll();
+#endif
+        DestroySemaphore(gWakeSemaphore.handle);
+        for (uint32 priority = 0; priority < NumJobPriorities; priority++)
+        {
+            DestroySemaphore(gSubmitterSemaphores[priority].handle);
+        }
+
+        uint32 index;
+        Fiber* fiber;
+        Job job;
+        while (gFreeFiberQueue.try_pop(index));
+        while (gFreeCounterQueue.try_pop(index));
+        while (gReadyFiberQueue.try_pop(fiber));
+        while (gMainThreadJobQueue.try_pop(job));
+        while (gIOJobQueue.try_pop(job));
+        for (uint32 priority = 0; priority < NumJobPriorities; priority++)
+        {
+            while (gJobQueues[priority].try_pop(job));
+            for (uint32 workerThreadIndex = 0; workerThreadIndex < gWorkerThreadCount; workerThreadIndex++)
+            {
+                while (gWorkerJobQueues[priority][workerThreadIndex].Pop(job));
+            }
+        }
+        for (uint32 chunkIndex = 0; chunkIndex < gNumAtomicCounterChunks; chunkIndex++)
+        {
+            delete gAtomicCounterChunks[chunkIndex].load(std::memory_order_relaxed);
+            gAtomicCounterChunks[chunkIndex].store(nullptr, std::memory_order_relaxed);
+        }
+
+        gWorkerThreadCount = 0;
+        gIOThreadCount = 0;
+        gFiberCount = 0;
+        gNumAtomicCounterChunks = 0;
+        gNumCountersInUse = 0;
+        gMaxNumCountersInUse = 0;
+        gNumFibersInUse = 0;
+        gMaxNumFibersInUse = 0;
+        gMaxNumQueuedJobs = 0;
+        gNumStalls = 0;
+        gNumSleepingWorkers = 0;
+        gNumRunningBackgroundJobs = 0;
+        gExitRequested.store(false, std::memory_order_relaxed);
+        gInitialized.store(false, std::memory_order_release);
+
+        HE_LOG_INFO("Job system exit.");
+    }
+
+    JobSystemAtomicCounterHandle JobSystemRunJobs(JobSystemJobDecl* jobDecls, uint32 numJobs)
+    {
+        return JobSystemRunJobs(jobDecls, numJobs, JobSystemJobPriority::Normal, JobSystemJobAffinity::AnyWorker);
+    }
+
+    JobSystemAtomicCounterHandle JobSystemAllocateCounter(uint32 value)
+    {
+        uint32 freeCounterIndex;
+        bool stalled = false;
+        while (!FindFreeCounter(freeCounterIndex))
+        {
+            if (GrowCounterPool())
+            {
+                continue;
+            }
+            // Every counter is in use. Counters are freed by waits on finished jobs, so a worker helps finishing jobs meanwhile.
+            if (!stalled)
+            {
+                stalled = true;
+                gNumStalls.fetch_add(1, std::memory_order_relaxed);
+            }
+            if (!TryRunPendingJob())
+            {
+                YieldCPU();
+            }
+        }
+
+        JobSystemAtomicCounterHandle freeCounter = freeCounterIndex + 1;
+        StoreCounter(freeCounter, value);
+        return freeCounter;
+    }
+
+    void JobSystemRunJobsWithCounter(const JobSystemJobDecl* jobDecls, uint32 numJobs, JobSystemJobPriority priority, JobSystemJobAffinity affinity, JobSystemAtomicCounterHandle counterHandle)
+    {
+        ASSERT(priority < JobSystemJobPriority::Count);
+
+        Job job = {};
+        job.counterHandle = counterHandle;
+        job.priority = priority;
+
+        if (affinity == JobSystemJobAffinity::MainThread)
+        {
+            // Picked up by JobSystemRunMainThreadJobs(), no worker needs to be woken.
+            const bool isMainThread = (GetCurrentThreadID() == gMainThreadID);
+            for (uint32 jobIndex = 0; jobIndex < numJobs; jobIndex++)
+            {
+                job.decl = jobDecls[jobIndex];
+                if (gMainThreadJobQueue.try_push(job))
+                {
+                    continue;
+                }
+                gNumStalls.fetch_add(1, std::memory_order_relaxed);
+                if (isMainThread)
+                {
+                    // Nobody else drains this queue, waiting for room here would never return.
+                    RunJob(job);
+                    continue;
+                }
+                // The main thread drains the queue from JobSystemRunMainThreadJobs() and while it waits on a counter.
+                while (!gMainThreadJobQueue.try_push(job))
+                {
+                    if (!TryRunPendingJob())
+                    {
+                        YieldCPU();
+                    }
+                }
+            }
+            return;
+        }
+
+        for (uint32 jobIndex = 0; jobIndex < numJobs; jobIndex++)
+        {
+            job.decl = jobDecls[jobIndex];
+            PushJob(job);
+        }
+
+        // One release for the whole batch, and only for workers that are actually asleep.
+        WakeWorkers(numJobs);
+    }
+
+    JobSystemAtomicCounterHandle JobSystemRunJobs(JobSystemJobDecl* jobDecls, uint32 numJobs, JobSystemJobPriority priority, JobSystemJobAffinity affinity)
+    {
+        JobSystemAtomicCounterHandle counterHandle = JobSystemAllocateCounter(numJobs);
+        JobSystemRunJobsWithCounter(jobDecls, numJobs, priority, affinity, counterHandle);
+        return counterHandle;
+    }
+
+    JobSystemAtomicCounterHandle JobSystemRunIOJobs(const JobSystemJobDecl* jobDecls, uint32 numJobs)
+    {
+        JobSystemAtomicCounterHandle counterHandle = JobSystemAllocateCounter(numJobs);
+
+        Job job = {};
+        job.counterHandle = counterHandle;
+        job.priority = JobSystemJobPriority::Normal;
+        uint32 numUnsignaledJobs = 0;
+        for (uint32 jobIndex = 0; jobIndex < numJobs; jobIndex++)
+        {
+            job.decl = jobDecls[jobIndex];
+            if (!gIOJobQueue.try_push(job))
+            {
+                // Backpressure as in PushJob(). The I/O threads have to know about the queued jobs to drain the queue.
+                gNumStalls.fetch_add(1, std::memory_order_relaxed);
+                if (numUnsignaledJobs > 0)
+                {
+                    SemaphoreAdd(gIOSemaphore.handle, numUnsignaledJobs);
+                    numUnsignaledJobs = 0;
+                }
+                while (!gIOJobQueue.try_push(job))
+                {
+                    if (!TryRunPendingJob())
+                    {
+                        YieldCPU();
+                    }
+                }
+            }
+            numUnsignaledJobs++;
+        }
+        if (numUnsignaledJobs > 0)
+        {
+            SemaphoreAdd(gIOSemaphore.handle, numUnsignaledJobs);
+        }
+        return counterHandle;
+    }
+
+    void JobSystemRunBlocking(JobSystemJobFunc jobFunc, void* data)
+    {
+        if (!JobSystemIsWorkerThread())
+        {
+            jobFunc(data);
+            return;
+        }
+        JobSystemJobDecl jobDecl = { jobFunc, data, "Blocking" };
+        JobSystemAtomicCounterHandle counterHandle = JobSystemRunIOJobs(&jobDecl, 1);
+        JobSystemWaitForCounterAndFree(counterHandle, 0);
+    }
+
+    uint32 JobSystemRunMainThreadJobs()
+    {
+        ASSERT(GetCurrentThreadID() == gMainThreadID);
+        uint32 numJobs = 0;
+        while (RunMainThreadJob())
+        {
+            numJobs++;
+        }
+        return numJobs;
+    }
+
+    void JobSystemSetWorkStealingEnabled(bool enabled)
+    {
+        gWorkStealingEnabled.store(enabled, std::memory_order_relaxed);
+    }
+
+    /** Takes a fiber to continue on while the current one waits. Fails if the pool is at JOB_SYSTEM_MAX_NUM_FIBERS and every fiber is busy. */
+    static Fiber* FindFiberToSwitchTo()
+    {
+        uint32 freeFiberIndex;
+        while (!FindFreeFiber(freeFiberIndex))
+        {
+            if (!GrowFiberPool())
+            {
+                gNumStalls.fetch_add(1, std::memory_order_relaxed);
+                return nullptr;
+            }
+        }
+        return &gFibers[freeFiberIndex];
+    }
+
+    /** Suspends the current fiber until it is made ready again. nextFiber parks it, see Fiber::fiberToPark. */
+    static void SwitchToParkingFiber(Fiber* currentFiber, Fiber* nextFiber, uint32 traceArg)
+    {
+        // A parked background job does not count against the background cap, otherwise background jobs waiting
+        // on background children could take every slot and deadlock. The cap may be exceeded briefly on resume.
+        const bool background = (currentFiber->runningJobPriority == JobSystemJobPriority::Background);
+        if (background)
+        {
+            ReleaseBackgroundSlot();
+        }
+
+        // The job's slice ends on this worker's track and continues on the track of whichever worker resumes it.
+        HE_JOB_SYSTEM_TRACE(WaitBegin, nullptr, traceArg);
+        HE_JOB_SYSTEM_TRACE(JobEnd, currentFiber->runningJobName, (uint32)currentFiber->runningJobPriority);
+        HE_JOB_SYSTEM_TRACE(FiberSwitch, nullptr, nextFiber->index);
+
+        SwitchToAnotherFiber(nextFiber->handle);
+
+        // Resumed from FiberEntry() by a worker, which left its now idle fiber for us to free.
+        ProcessPendingFiberActions(currentFiber);
+
+        HE_JOB_SYSTEM_TRACE(JobBegin, currentFiber->runningJobName, (uint32)currentFiber->runningJobPriority);
+        HE_JOB_SYSTEM_TRACE(WaitEnd, nullptr, traceArg);
+
+        if (background)
+        {
+            gNumRunningBackgroundJobs.fetch_add(1, std::memory_order_acquire);
+        }
+    }
+
+    void JobSystemWaitForCounter(JobSystemAtomicCounterHandle counterHandle, uint32 condition)
+    {
+        // Checked again after every resume, a wake-up only means the counter was at the condition at some point.
+        while (LoadCounter(counterHandle) != condition)
+        {
+            Fiber* nextFiber = FindFiberToSwitchTo();
+            if (!nextFiber)
+            {
+                // Every fiber is parked or running. Rather than waiting for one, keep this fiber and run other jobs
+                // on top of the waiting one until the counter gets there.
+                while (LoadCounter(counterHandle) != condition)
+                {
+                    if (!TryRunPendingJob())
+                    {
+                        YieldCPU();
+                    }
+                }
+                return;
+            }
+
+            Fiber* currentFiber = (Fiber*)(GetCurrentFiberData()->userData);
+
+            // The next fiber parks this one on the counter once this fiber's context is saved, otherwise a worker
+            // could resume this fiber while it is still running here.
+            currentFiber->waitCondition = condition;
+            nextFiber->fiberToPark = currentFiber;
+            nextFiber->parkCounterHandle = counterHandle;
+
+            SwitchToParkingFiber(currentFiber, nextFiber, counterHandle);
+        }
+    }
+
+    void JobSystemLockWaitList(JobSystemWaitList& waitList)
+    {
+        while (waitList.lock.exchange(true, std::memory_order_acquire))
+        {
+            while (waitList.lock.load(std::memory_order_relaxed))
+            {
+                YieldCPU();
+            }
+        }
+    }
+
+    void JobSystemUnlockWaitList(JobSystemWaitList& waitList)
+    {
+        waitList.lock.store(false, std::memory_order_release);
+    }
+
+    void* JobSystemAcquireParkingFiber()
+    {
+        if (!JobSystemIsWorkerThread())
+        {
+            return nullptr;
+        }
+        return FindFiberToSwitchTo();
+    }
+
+    void JobSystemReleaseParkingFiber(void* fiber)
+    {
+        FreeFiber((Fiber*)fiber);
+    }
+
+    void JobSystemParkOnWaitList(JobSystemWaitList& waitList, void* fiber)
+    {
+        ASSERT(fiber);
+        Fiber* nextFiber = (Fiber*)fiber;
+
+        // The wait list stays locked over the switch, so a wake-up cannot miss this fiber. The next fiber links it and unlocks.
+        Fiber* currentFiber = (Fiber*)(GetCurrentFiberData()->userData);
+        nextFiber->fiberToPark = currentFiber;
+        nextFiber->parkWaitList = &waitList;
+
+        SwitchToParkingFiber(currentFiber, nextFiber, 0);
+    }
+
+    void* JobSystemPopWaitingFibers(JobSystemWaitList& waitList, uint32 maxNumFibers, uint32& outNumFibers)
+    {
+        Fiber* first = (Fiber*)waitList.head;
+        Fiber* last = nullptr;
+        outNumFibers = 0;
+        for (Fiber* fiber = first; fiber && outNumFibers < maxNumFibers; fiber = fiber->nextWaitingFiber)
+        {
+            last = fiber;
+            outNumFibers++;
+        }
+        if (!last)
+        {
+            return nullptr;
+        }
+        waitList.head = last->nextWaitingFiber;
+        if (!waitList.head)
+        {
+            waitList.tail = nullptr;
+        }
+        last->nextWaitingFiber = nullptr;
+        return first;
+    }
+
+    void JobSystemResumeFibers(void* fibers)
+    {
+        Fiber* fiber = (Fiber*)fibers;
+        while (fiber)
+        {
+            Fiber* next = fiber->nextWaitingFiber;
+            MakeFiberReady(fiber);
+            fiber = next;
+        }
+    }
+
+    void JobSystemWaitBackoff(uint32& spinCount)
+    {
+        if (TryRunPendingJob())
+        {
+            spinCount = 0;
+            return;
+        }
+        if (spinCount < JOB_SYSTEM_WAIT_SPIN_COUNT)
+        {
+            spinCount++;
+            YieldCPU();
+            return;
+        }
+        SuspendCurrentThread(0.001f);
+    }
+
+    void JobSystemResumeCoroutine(std::coroutine_handle<> coroutine, JobSystemJobPriority priority)
+    {
+        Job job = {};
+        job.decl = { ResumeCoroutineJob, coroutine.address(), "Task" };
+        job.priority = priority;
+        PushJob(job);
+        WakeWorkers(1);
+    }
+
+    bool JobSystemResumeCoroutineWhenCounter(JobSystemCounterContinuation* continuation)
+    {
+        AtomicCounter& counter = GetAtomicCounter(continuation->counterHandle);
+        continuation->priority = JobSystemGetCurrentJobPriority();
+
+        // Same protocol as ParkFiber(), the coroutine is already suspended so it may be resumed right after the unlock.
+        counter.numWaiters.fetch_add(1, std::memory_order_seq_cst);
+        LockWaitList(counter);
+        if (counter.atomic.load(std::memory_order_seq_cst) == continuation->condition)
+        {
+            UnlockWaitList(counter);
+            counter.numWaiters.fetch_sub(1, std::memory_order_relaxed);
+            return false;
+        }
+        continuation->next = counter.waitingContinuations;
+        counter.waitingContinuations = continuation;
+        UnlockWaitList(counter);
+        return true;
+    }
+
+    void JobSystemWaitForCounterAndFree(JobSystemAtomicCounterHandle counterHandle, uint32 condition)
+    {
+        JobSystemWaitForCounter(counterHandle, condition);
+        FreeCounter(counterHandle);
+    }
+
+    void JobSystemWaitForCounterAndFreeWithoutFiber(JobSystemAtomicCounterHandle counterHandle)
+    {
+        const bool isMainThread = (GetCurrentThreadID() == gMainThreadID);
+        // Spin briefly before sleeping, short fork/join waits (e.g. ParallelFor) then do not pay the sleep granularity.
+        uint32 spinCount = 0;
+        while (LoadCounter(counterHandle) != 0)
+        {
+            // The main thread keeps its own lane moving while it waits, the awaited jobs may depend on it.
+            if (isMainThread && RunMainThreadJob())
+            {
+                continue;
+            }
+            if (spinCount < JOB_SYSTEM_WAIT_SPIN_COUNT)
+            {
+                spinCount++;
+                YieldCPU();
+                continue;
+            }
+            SuspendCurrentThread(0.001f);
+        }
         FreeCounter(counterHandle);
     }
+
+    uint32 JobSystemGetNumWorkerThreads()
+    {
+        return gWorkerThreadCount;
+    }
+
+    JobSystemStats JobSystemGetStats()
+    {
+        JobSystemStats stats = {};
+        {
+            std::lock_guard<std::mutex> lock(gPoolGrowthMutex);
+            stats.numCounters = gNumAtomicCounterChunks * AtomicCounterChunkSize;
+            stats.numFibers = gFiberCount;
+        }
+        stats.maxNumCountersInUse = gMaxNumCountersInUse.load(std::memory_order_relaxed);
+        stats.maxNumFibersInUse = gMaxNumFibersInUse.load(std::memory_order_relaxed);
+        stats.maxNumQueuedJobs = gMaxNumQueuedJobs.load(std::memory_order_relaxed);
+        stats.numStalls = gNumStalls.load(std::memory_order_relaxed);
+        return stats;
+    }
+
+    void JobSystemIncrementCounter(JobSystemAtomicCounterHandle counterHandle, uint32 value)
+    {
+        ASSERT(counterHandle);
+        GetAtomicCounter(counterHandle).atomic.fetch_add(value);
+    }
+
+    void JobSystemDecrementCounter(JobSystemAtomicCounterHandle counterHandle)
+    {
+        FetchSubCounter(counterHandle);
+    }
+
+    bool JobSystemIsWorkerThread()
+    {
+        return GetCurrentWorkerThreadIndex() != JOB_SYSTEM_INVALID_WORKER_THREAD_INDEX;
+    }
+
+    uint32 JobSystemGetCurrentWorkerThreadIndex()
+    {
+        return GetCurrentWorkerThreadIndex();
+    }
+
+    JobSystemJobPriority JobSystemGetCurrentJobPriority()
+    {
+        if (!JobSystemIsWorkerThread())
+        {
+            return JobSystemJobPriority::Normal;
+        }
+        return ((Fiber*)GetCurrentFiberData()->userData)->runningJobPriority;
+    }
+
+    bool JobSystemIsLocalQueueEmpty(JobSystemJobPriority priority)
+    {
+        const uint32 workerThreadIndex = GetCurrentWorkerThreadIndex();
+        if (workerThreadIndex == JOB_SYSTEM_INVALID_WORKER_THREAD_INDEX)
+        {
+            return true;
+        }
+        return gWorkerJobQueues[(uint32)priority][workerThreadIndex].IsEmpty();
+    }
 }
@@ -1,30 +1,728 @@
+module;
+
+#include "CoreCommon.h"
+
+#include <atomic>
+#include <coroutine>
+#include <memory>
+#include <mutex>
+
 export module HorizonEngine.Core.JobSystem;
 
+export import "JobSystemDefinitions.h";
+
 import HorizonEngine.Core.Types;
+import HorizonEngine.Core.Memory;
 
 export namespace HE
 {
     enum
     {
         JOB_SYSTEM_MAX_NUM_WORKER_THREADS = 128,
-        JOB_SYSTEM_MAX_NUM_FIBERS = 256,
+        /** Upper bound of the fiber pool, which starts at the numFibers passed to JobSystemInit() and grows in chunks. */
+        JOB_SYSTEM_MAX_NUM_FIBERS = 1024,
+        /** Capacity of each shared job queue, and the initial size of the counter pool. */
         JOB_SYSTEM_MAX_NUM_JOBS = 4096,
+        /** Upper bound of the counter pool, which grows in chunks. */
+        JOB_SYSTEM_MAX_NUM_COUNTERS = 16384,
+        JOB_SYSTEM_WORKER_QUEUE_CAPACITY = 1024,
+        JOB_SYSTEM_INVALID_WORKER_THREAD_INDEX = 0xFFFFFFFF,
+        JOB_SYSTEM_WAIT_SPIN_COUNT = 4096,
+        JOB_SYSTEM_IDLE_SPIN_COUNT = 256,
+        JOB_SYSTEM_MAX_NUM_IO_THREADS = 16,
+        JOB_SYSTEM_DEFAULT_NUM_IO_THREADS = 2,
     };
 
     using JobSystemAtomicCounterHandle = uint32;
 
     using JobSystemJobFunc = void(*)(void*);
 
+    /** Workers drain the lanes strictly in this order. */
+    enum class JobSystemJobPriority : uint8
+    {
+        /** Frame-critical work such as culling and command recording. */
+        High,
+        Normal,
+        /** Long-running work such as asset imports. Never occupies every worker, so high and normal jobs stay responsive. */
+        Background,
+        Count,
+    };
+
+    enum class JobSystemJobAffinity : uint8
+    {
+        AnyWorker,
+        /** Runs on the thread that called JobSystemInit (windowing, swapchain) from JobSystemRunMainThreadJobs(). */
+        MainThread,
+    };
+
+    /** A logical processor as seen by the OS scheduler. */
+    struct JobSystemLogicalProcessor
+    {
+        /** OS processor number, group * 64 + number within the group on Windows. */
+        uint32 id;
+        /** Dense index of the physical core. */
+        uint32 coreIndex;
+        /** 0 for the first hardware thread of the core, 1, 2, ... for its SMT siblings. */
+        uint32 smtIndex;
+        /** Dense index of the group of processors sharing an L3 cache, i.e. one CCX on chiplet CPUs and usually one package otherwise. */
+        uint32 cacheGroupIndex;
+        uint32 numaNodeIndex;
+    };
+
+    struct JobSystemCpuTopology
+    {
+        uint32 numPhysicalCores;
+        uint32 numCacheGroups;
+        uint32 numNumaNodes;
+        /** Only the processors the process is allowed to run on, sorted by id. */
+        std::vector<JobSystemLogicalProcessor> logicalProcessors;
+    };
+
+    /** If the OS does not report a topology, every logical processor is treated as a core of its own with one cache group and NUMA node. */
+    JobSystemCpuTopology JobSystemQueryCpuTopology();
+
+    enum class JobSystemWorkerPlacement : uint8
+    {
+        /** Worker threads are left to the OS scheduler and steal from every other worker alike. */
+        Unpinned,
+        /**
+         * Worker threads are pinned to physical cores, filling one L3 cache group (and NUMA node) before the next.
+         * SMT siblings only get a worker once every core has one. Workers steal from workers of their own cache group first.
+         */
+        OnePerPhysicalCore,
+    };
+
     struct JobSystemJobDecl
     {
         JobSystemJobFunc jobFunc;
         void* data;
+        /** Optional, shown in traces. Must outlive the job, e.g. a string literal. */
+        const char* name = nullptr;
     };
 
-    void JobSystemInit(uint32 numWorkerThreads, uint32 numFibers, uint32 fiberStackSize);
+    /**
+     * With JobSystemWorkerPlacement::OnePerPhysicalCore, numWorkerThreads is usually JobSystemQueryCpuTopology().numPhysicalCores.
+     * The I/O threads come on top of the workers, see JobSystemRunIOJobs().
+     */
+    void JobSystemInit(uint32 numWorkerThreads, uint32 numFibers, uint32 fiberStackSize, JobSystemWorkerPlacement placement = JobSystemWorkerPlacement::Unpinned, uint32 numIOThreads = JOB_SYSTEM_DEFAULT_NUM_IO_THREADS);
     void JobSystemExit();
     JobSystemAtomicCounterHandle JobSystemRunJobs(JobSystemJobDecl* jobDecls, uint32 numJobs);
+    JobSystemAtomicCounterHandle JobSystemRunJobs(JobSystemJobDecl* jobDecls, uint32 numJobs, JobSystemJobPriority priority, JobSystemJobAffinity affinity = JobSystemJobAffinity::AnyWorker);
+    /**
+     * Runs the jobs on the I/O threads, which exist for calls that block in the OS (file reads, image decoding, importers)
+     * so that they never stall a CPU worker. The returned counter is waited on like any other, e.g. from a fiber job with
+     * JobSystemWaitForCounterAndFree(), which parks the fiber and lets its worker run other jobs until the I/O is done.
+     * I/O jobs run on plain threads, they must not wait on counters with fibers themselves.
+     */
+    JobSystemAtomicCounterHandle JobSystemRunIOJobs(const JobSystemJobDecl* jobDecls, uint32 numJobs);
+    /** Calls jobFunc(data) on an I/O thread and waits for it if called from a worker, and directly on any other thread. */
+    void JobSystemRunBlocking(JobSystemJobFunc jobFunc, void* data);
+    /** Runs all pending main thread jobs, returns how many ran. Must be called from the main thread, e.g. once per frame. */
+    uint32 JobSystemRunMainThreadJobs();
+    /** Jobs submitted from a worker thread go to its own deque and idle workers steal from each other. Enabled by default. */
+    void JobSystemSetWorkStealingEnabled(bool enabled);
     void JobSystemWaitForCounter(JobSystemAtomicCounterHandle counterHandle, uint32 condition);
     void JobSystemWaitForCounterAndFree(JobSystemAtomicCounterHandle counterHandle, uint32 condition);
     void JobSystemWaitForCounterAndFreeWithoutFiber(JobSystemAtomicCounterHandle counterHandle);
+    uint32 JobSystemGetNumWorkerThreads();
+
+    /**
+     * Pool sizes and high-water marks since JobSystemInit(), to size numFibers and spot submission bursts.
+     * A stall is a submitter or waiter finding a queue or pool exhausted. Workers then run queued jobs themselves instead of spinning.
+     */
+    struct JobSystemStats
+    {
+        uint32 numCounters;
+        uint32 maxNumCountersInUse;
+        uint32 numFibers;
+        uint32 maxNumFibersInUse;
+        /** Highest number of jobs seen in one shared queue, out of JOB_SYSTEM_MAX_NUM_JOBS. */
+        uint32 maxNumQueuedJobs;
+        uint32 numStalls;
+    };
+
+    JobSystemStats JobSystemGetStats();
+
+    /** Starts or stops recording trace events. Does nothing unless HE_JOB_SYSTEM_TRACING is enabled. */
+    void JobSystemSetTracingEnabled(bool enabled);
+    /**
+     * Writes the events recorded so far as Chrome trace JSON (chrome://tracing, ui.perfetto.dev), one track per worker.
+     * Each worker keeps only its most recent events. Best called with tracing stopped, events recorded during the dump may be torn.
+     */
+    bool JobSystemDumpTrace(const char* filename);
+
+    /** Called with consecutive chunks of [rangeBegin, rangeEnd). taskIndex < JobSystemParallelForMaxNumTasks() identifies the range task, chunks of one task never run concurrently. */
+    using JobSystemParallelForFunc = void(*)(void* userData, uint32 taskIndex, uint32 rangeBegin, uint32 rangeEnd);
+
+    /** Grain used when 0 is passed, aims at a few chunks per worker. */
+    uint32 JobSystemParallelForDefaultGrain(uint32 begin, uint32 end);
+    uint32 JobSystemParallelForMaxNumTasks(uint32 begin, uint32 end, uint32 grain);
+
+    /**
+     * Runs func over [begin, end) with lazy binary splitting: a range task processes grain-sized chunks and only
+     * splits off half of its remaining range when its worker's deque is empty, i.e. when other workers may be idle.
+     * The calling thread works on the range itself and returns once every chunk has been processed.
+     */
+    void JobSystemParallelFor(uint32 begin, uint32 end, uint32 grain, JobSystemParallelForFunc func, void* userData);
+
+    /** Calls func(i) for every i in [begin, end). A grain of 0 picks one automatically. */
+    template<typename Func>
+    void ParallelFor(uint32 begin, uint32 end, uint32 grain, Func&& func)
+    {
+        using FuncType = std::remove_reference_t<Func>;
+        JobSystemParallelFor(begin, end, grain, [](void* userData, uint32 taskIndex, uint32 rangeBegin, uint32 rangeEnd)
+        {
+            FuncType& f = *(FuncType*)userData;
+            for (uint32 i = rangeBegin; i < rangeEnd; i++)
+            {
+                f(i);
+            }
+        }, (void*)std::addressof(func));
+    }
+
+    /**
+     * map(rangeBegin, rangeEnd, accumulated) returns accumulated combined with the elements of the range.
+     * reduce(a, b) combines partial results. It must be associative and commutative, partial results are combined in no particular order.
+     */
+    template<typename T, typename MapFunc, typename ReduceFunc>
+    T ParallelReduce(uint32 begin, uint32 end, uint32 grain, const T& identity, MapFunc&& map, ReduceFunc&& reduce)
+    {
+        if (grain == 0)
+        {
+            grain = JobSystemParallelForDefaultGrain(begin, end);
+        }
+
+        struct alignas(64) Partial
+        {
+            T value;
+        };
+
+        struct Context
+        {
+            std::remove_reference_t<MapFunc>* map;
+            Partial* partials;
+        };
+
+        const uint32 maxNumTasks = JobSystemParallelForMaxNumTasks(begin, end, grain);
+        std::vector<Partial> partials(maxNumTasks, Partial{ identity });
+        Context context = { std::addressof(map), partials.data() };
+
+        JobSystemParallelFor(begin, end, grain, [](void* userData, uint32 taskIndex, uint32 rangeBegin, uint32 rangeEnd)
+        {
+            Context* context = (Context*)userData;
+            T& partial = context->partials[taskIndex].value;
+            partial = (*context->map)(rangeBegin, rangeEnd, partial);
+        }, &context);
+
+        T result = identity;
+        for (const Partial& partial : partials)
+        {
+            result = reduce(result, partial.value);
+        }
+        return result;
+    }
+
+    using JobSystemTaskHandle = uint32;
+
+    /**
+     * A DAG of jobs. Each task is released as soon as its last predecessor finishes,
+     * from the worker that finished it, so no fiber ever parks on an intermediate counter.
+     * Build the graph once (e.g. per frame), Run() it, wait for the returned counter, then Reset() or destroy it.
+     */
+    class JobSystemTaskGraph
+    {
+    public:
+        JobSystemTaskGraph() = default;
+        ~JobSystemTaskGraph() = default;
+        JobSystemTaskGraph(const JobSystemTaskGraph&) = delete;
+        JobSystemTaskGraph& operator=(const JobSystemTaskGraph&) = delete;
+        JobSystemTaskHandle AddTask(JobSystemJobFunc jobFunc, void* data, JobSystemJobPriority priority = JobSystemJobPriority::Normal);
+        /** The successor only starts after the predecessor has finished. */
+        void AddDependency(JobSystemTaskHandle predecessor, JobSystemTaskHandle successor);
+        /** Submits all tasks without predecessors. The returned counter reaches 0 once every task has finished. */
+        JobSystemAtomicCounterHandle Run();
+        void Reset();
+        uint32 GetNumTasks() const
+        {
+            return (uint32)tasks.size();
+        }
+    private:
+        struct Task
+        {
+            JobSystemJobDecl decl;
+            JobSystemJobPriority priority;
+            uint32 numPredecessors;
+            uint32 firstSuccessor;
+            uint32 numSuccessors;
+            JobSystemTaskGraph* graph;
+        };
+        static void TaskEntry(void* data);
+        void ReleaseSuccessors(const Task& task);
+        std::vector<Task> tasks;
+        std::vector<std::pair<JobSystemTaskHandle, JobSystemTaskHandle>> dependencies;
+        /** Successors of all tasks, task i owns [firstSuccessor, firstSuccessor + numSuccessors). */
+        std::vector<JobSystemTaskHandle> successors;
+        std::unique_ptr<std::atomic<uint32>[]> pendingPredecessors;
+        JobSystemAtomicCounterHandle counterHandle = 0;
+    };
+
+    /** FIFO of fibers parked by the synchronization primitives below, guarded by a spinlock that is only held for a few instructions. */
+    struct JobSystemWaitList
+    {
+        std::atomic<bool> lock = false;
+        /** Fiber*, opaque outside of the job system. */
+        void* head = nullptr;
+        void* tail = nullptr;
+    };
+
+    /**
+     * Mutex for code running in jobs. A contended Lock() parks the job's fiber and lets the worker run other jobs, Unlock() hands
+     * the mutex to the longest waiting fiber. Outside of workers (or with the fiber pool exhausted) Lock() spins and then sleeps.
+     * Not recursive. Also usable with std::lock_guard and std::unique_lock.
+     */
+    class JobSystemMutex
+    {
+    public:
+        JobSystemMutex() = default;
+        ~JobSystemMutex() = default;
+        JobSystemMutex(const JobSystemMutex&) = delete;
+        JobSystemMutex& operator=(const JobSystemMutex&) = delete;
+        void Lock();
+        bool TryLock();
+        void Unlock();
+        void lock()
+        {
+            Lock();
+        }
+        bool try_lock()
+        {
+            return TryLock();
+        }
+        void unlock()
+        {
+            Unlock();
+        }
+    private:
+        JobSystemWaitList waitList;
+        /** Guarded by the wait list lock. */
+        bool locked = false;
+    };
+
+    /** Manual-reset event. Wait() parks the job's fiber until Set(), which releases every waiter and keeps the event set until Reset(). */
+    class JobSystemEvent
+    {
+    public:
+        JobSystemEvent() = default;
+        ~JobSystemEvent() = default;
+        JobSystemEvent(const JobSystemEvent&) = delete;
+        JobSystemEvent& operator=(const JobSystemEvent&) = delete;
+        void Set();
+        void Reset();
+        bool IsSet() const
+        {
+            return signaled.load(std::memory_order_acquire);
+        }
+        void Wait();
+    private:
+        JobSystemWaitList waitList;
+        /** Written with the wait list locked, read without it by IsSet() and polling waiters. */
+        std::atomic<bool> signaled = false;
+    };
+
+    /** Counting semaphore. Acquire() parks the job's fiber while the count is 0, Release() hands permits to waiters in FIFO order. */
+    class JobSystemSemaphore
+    {
+    public:
+        JobSystemSemaphore(uint32 initialCount = 0) : count(initialCount) {}
+        ~JobSystemSemaphore() = default;
+        JobSystemSemaphore(const JobSystemSemaphore&) = delete;
+        JobSystemSemaphore& operator=(const JobSystemSemaphore&) = delete;
+        void Acquire();
+        bool TryAcquire();
+        void Release(uint32 releaseCount = 1);
+    private:
+        JobSystemWaitList waitList;
+        /** Guarded by the wait list lock. */
+        uint32 count;
+    };
+
+    /**
+     * Allocator of per-frame memory, e.g. render graph objects and render commands. Each worker bumps its own linear blocks,
+     * so jobs allocate without locking, other threads share one set of blocks behind a mutex. Memory allocated after BeginFrame()
+     * stays valid until BeginFrame() has been called numFramesInFlight more times, which is what keeps data the GPU reads
+     * for frame N alive until that frame retires. Free() does nothing. Must be created after JobSystemInit().
+     */
+    class JobSystemFrameArena : public MemoryArena
+    {
+    public:
+        JobSystemFrameArena(const char* name, uint32 numFramesInFlight, uint64 blockSize);
+        ~JobSystemFrameArena();
+        JobSystemFrameArena(const JobSystemFrameArena&) = delete;
+        JobSystemFrameArena& operator=(const JobSystemFrameArena&) = delete;
+        void* Alloc(uint64 size, uint64 alignment) override;
+        void Free(void* ptr, uint64 size) override
+        {
+
+        }
+        const char* GetName() const override
+        {
+            return name;
+        }
+        /**
+         * Must be called once per frame while no thread allocates from the arena, e.g. after presenting.
+         * Recycles the blocks of the oldest frame in flight, the caller guarantees that the GPU is done with it.
+         */
+        void BeginFrame();
+        uint32 GetFrameIndex() const
+        {
+            return frameIndex;
+        }
+        /** Bytes allocated by all threads since the last BeginFrame(). */
+        uint64 Allocated() const;
+    private:
+        struct Block
+        {
+            Block* next;
+            uint64 size;
+        };
+        /** Cache line sized so that workers never write to the same line. */
+        struct alignas(64) ThreadArena
+        {
+            Block* firstBlock = nullptr;
+            Block* block = nullptr;
+            uint64 used = 0;
+            uint64 allocated = 0;
+        };
+        void* AllocFromThreadArena(ThreadArena& threadArena, uint64 size, uint64 alignment);
+        const char* name;
+        uint32 numFramesInFlight;
+        /** One per worker, plus the shared one of other threads at the end. */
+        uint32 numThreadArenas;
+        uint64 blockSize;
+        uint32 frameIndex = 0;
+        /** numFramesInFlight * numThreadArenas, indexed by frame first. */
+        ThreadArena* threadArenas;
+        std::mutex sharedThreadArenaMutex;
+    };
+
+    /** Wait list node of a coroutine suspended on a counter. Lives in the awaiter, i.e. in the suspended coroutine's frame. */
+    struct JobSystemCounterContinuation
+    {
+        std::coroutine_handle<> coroutine;
+        JobSystemAtomicCounterHandle counterHandle;
+        uint32 condition;
+        /** Priority of the job that resumes the coroutine, the one of the suspending job. */
+        JobSystemJobPriority priority;
+        JobSystemCounterContinuation* next;
+    };
+
+    /** Resumes the coroutine from a job on a worker. */
+    void JobSystemResumeCoroutine(std::coroutine_handle<> coroutine, JobSystemJobPriority priority);
+    /**
+     * Resumes the continuation's coroutine as above once its counter reaches the condition.
+     * Returns false without queueing anything if the counter is already there, the caller then just continues.
+     */
+    bool JobSystemResumeCoroutineWhenCounter(JobSystemCounterContinuation* continuation);
+
+    /**
+     * Coroutine frames are allocated from this arena, which must be thread-safe since frames are freed on whichever worker finishes the task.
+     * nullptr (the default) selects the job system's own pooled frame arena. Frames remember their arena, so it can be changed at any time.
+     */
+    void JobSystemSetTaskFrameArena(MemoryArena* arena);
+    void* JobSystemAllocateTaskFrame(uint64 size);
+    void JobSystemFreeTaskFrame(void* frame, uint64 size);
+    /** Counter of a batch of root tasks, see JobSystemRunTasks(). */
+    JobSystemAtomicCounterHandle JobSystemAllocateTaskCounter(uint32 numTasks);
+    void JobSystemCompleteTask(JobSystemAtomicCounterHandle counterHandle);
+
+    /** co_await suspends the coroutine until the counter reaches the condition, without blocking a fiber or worker. */
+    class JobSystemCounterAwaiter
+    {
+    public:
+        JobSystemCounterAwaiter(JobSystemAtomicCounterHandle counterHandle, uint32 condition = 0)
+        {
+            continuation.counterHandle = counterHandle;
+            continuation.condition = condition;
+        }
+        bool await_ready() const noexcept
+        {
+            return false;
+        }
+        bool await_suspend(std::coroutine_handle<> coroutine)
+        {
+            continuation.coroutine = coroutine;
+            return JobSystemResumeCoroutineWhenCounter(&continuation);
+        }
+        void await_resume() const noexcept {}
+    private:
+        JobSystemCounterContinuation continuation = {};
+    };
+
+    /** co_await continues the coroutine on a worker, e.g. to move a task started on the main thread off it. */
+    class JobSystemWorkerAwaiter
+    {
+    public:
+        JobSystemWorkerAwaiter(JobSystemJobPriority priority = JobSystemJobPriority::Normal) : priority(priority) {}
+        bool await_ready() const noexcept
+        {
+            return false;
+        }
+        void await_suspend(std::coroutine_handle<> coroutine)
+        {
+            JobSystemResumeCoroutine(coroutine, priority);
+        }
+        void await_resume() const noexcept {}
+    private:
+        JobSystemJobPriority priority;
+    };
+
+    class JobSystemTaskPromiseBase
+    {
+    public:
+        static void* operator new(std::size_t size)
+        {
+            return JobSystemAllocateTaskFrame(size);
+        }
+        static void operator delete(void* frame, std::size_t size)
+        {
+            JobSystemFreeTaskFrame(frame, size);
+        }
+        /** Tasks are lazy, they start when awaited or passed to JobSystemRunTasks(). */
+        std::suspend_always initial_suspend() noexcept
+        {
+            return {};
+        }
+        struct FinalAwaiter
+        {
+            bool await_ready() const noexcept
+            {
+                return false;
+            }
+            template<typename Promise>
+            std::coroutine_handle<> await_suspend(std::coroutine_handle<Promise> coroutine) noexcept
+            {
+                // Once the counter is decremented the owner may destroy the frame, so nothing of it is touched afterwards.
+                const JobSystemTaskPromiseBase& promise = coroutine.promise();
+                const std::coroutine_handle<> awaitingCoroutine = promise.awaitingCoroutine;
+                const JobSystemAtomicCounterHandle counterHandle = promise.counterHandle;
+                if (counterHandle)
+                {
+                    JobSystemCompleteTask(counterHandle);
+                }
+                return awaitingCoroutine ? awaitingCoroutine : std::noop_coroutine();
+            }
+            void await_resume() const noexcept {}
+        };
+        FinalAwaiter final_suspend() noexcept
+        {
+            return {};
+        }
+        void unhandled_exception()
+        {
+            std::terminate();
+        }
+        /** Resumed (on the same thread) when the task finishes, set when the task is awaited. */
+        std::coroutine_handle<> awaitingCoroutine;
+        /** Decremented when the task finishes, set when the task is run by JobSystemRunTasks(). */
+        JobSystemAtomicCounterHandle counterHandle = 0;
+    };
+
+    template<typename T>
+    class JobSystemTask;
+
+    template<typename T>
+    class JobSystemTaskPromise : public JobSystemTaskPromiseBase
+    {
+    public:
+        JobSystemTask<T> get_return_object();
+        template<typename U>
+        void return_value(U&& value)
+        {
+            result.emplace(std::forward<U>(value));
+        }
+        T& GetResult()
+        {
+            return *result;
+        }
+    private:
+        std::optional<T> result;
+    };
+
+    template<>
+    class JobSystemTaskPromise<void> : public JobSystemTaskPromiseBase
+    {
+    public:
+        JobSystemTask<void> get_return_object();
+        void return_void() {}
+        void GetResult() {}
+    };
+
+    /**
+     * A lazily started coroutine returning T, scheduled on the job system's workers alongside fiber jobs.
+     * co_await on a task starts it on the awaiting thread and continues the awaiter once it finishes. The task owns its frame.
+     *
+     *     JobSystemTask<Mesh*> LoadMesh(const char* path)
+     *     {
+     *         JobSystemAtomicCounterHandle counter = RunDecodeJobs(path);
+     *         co_await JobSystemCounterAwaiter(counter);
+     *         co_return ...;
+     *     }
+     */
+    template<typename T = void>
+    class JobSystemTask
+    {
+    public:
+        using promise_type = JobSystemTaskPromise<T>;
+        JobSystemTask() = default;
+        explicit JobSystemTask(std::coroutine_handle<promise_type> coroutine) : coroutine(coroutine) {}
+        ~JobSystemTask()
+        {
+            if (coroutine)
+            {
+                coroutine.destroy();
+            }
+        }
+        JobSystemTask(JobSystemTask&& rhs) noexcept : coroutine(std::exchange(rhs.coroutine, nullptr)) {}
+        JobSystemTask& operator=(JobSystemTask&& rhs) noexcept
+        {
+            if (this != &rhs)
+            {
+                if (coroutine)
+                {
+                    coroutine.destroy();
+                }
+                coroutine = std::exchange(rhs.coroutine, nullptr);
+            }
+            return *this;
+        }
+        JobSystemTask(const JobSystemTask&) = delete;
+        JobSystemTask& operator=(const JobSystemTask&) = delete;
+        bool IsDone() const
+        {
+            return coroutine && coroutine.done();
+        }
+        /** Only valid once the task is done. */
+        decltype(auto) GetResult()
+        {
+            ASSERT(IsDone());
+            return coroutine.promise().GetResult();
+        }
+        std::coroutine_handle<promise_type> GetCoroutine() const
+        {
+            return coroutine;
+        }
+        auto operator co_await() noexcept
+        {
+            struct Awaiter
+            {
+                std::coroutine_handle<promise_type> coroutine;
+                bool await_ready() const noexcept
+                {
+                    return !coroutine || coroutine.done();
+                }
+                std::coroutine_handle<> await_suspend(std::coroutine_handle<> awaitingCoroutine) noexcept
+                {
+                    coroutine.promise().awaitingCoroutine = awaitingCoroutine;
+                    return coroutine;
+                }
+                decltype(auto) await_resume()
+                {
+                    if constexpr (std::is_void_v<T>)
+                    {
+                        return;
+                    }
+                    else
+                    {
+                        return std::move(coroutine.promise().GetResult());
+                    }
+                }
+            };
+            return Awaiter{ coroutine };
+        }
+    private:
+        std::coroutine_handle<promise_type> coroutine;
+    };
+
+    template<typename T>
+    JobSystemTask<T> JobSystemTaskPromise<T>::get_return_object()
+    {
+        return JobSystemTask<T>(std::coroutine_handle<JobSystemTaskPromise<T>>::from_promise(*this));
+    }
+
+    inline JobSystemTask<void> JobSystemTaskPromise<void>::get_return_object()
+    {
+        return JobSystemTask<void>(std::coroutine_handle<JobSystemTaskPromise<void>>::from_promise(*this));
+    }
+
+    /**
+     * Starts the tasks on workers. The returned counter reaches 0 once all of them have finished, wait for it
+     * (with JobSystemWaitForCounterAndFree(), JobSystemCounterAwaiter, ...) before reading results or destroying the tasks.
+     */
+    template<typename T>
+    JobSystemAtomicCounterHandle JobSystemRunTasks(JobSystemTask<T>* tasks, uint32 numTasks, JobSystemJobPriority priority = JobSystemJobPriority::Normal)
+    {
+        JobSystemAtomicCounterHandle counterHandle = JobSystemAllocateTaskCounter(numTasks);
+        for (uint32 taskIndex = 0; taskIndex < numTasks; taskIndex++)
+        {
+            ASSERT(tasks[taskIndex].GetCoroutine() && !tasks[taskIndex].GetCoroutine().done());
+            tasks[taskIndex].GetCoroutine().promise().counterHandle = counterHandle;
+            JobSystemResumeCoroutine(tasks[taskIndex].GetCoroutine(), priority);
+        }
+        return counterHandle;
+    }
+}
+
+namespace HE
+{
+    /** Module internal, used by the task graph and other schedulers built on top of the job system. */
+    JobSystemAtomicCounterHandle JobSystemAllocateCounter(uint32 value);
+    /** Submits jobs that decrement an existing counter, the caller accounts for them in the counter value. */
+    void JobSystemRunJobsWithCounter(const JobSystemJobDecl* jobDecls, uint32 numJobs, JobSystemJobPriority priority, JobSystemJobAffinity affinity, JobSystemAtomicCounterHandle counterHandle);
+    void JobSystemIncrementCounter(JobSystemAtomicCounterHandle counterHandle, uint32 value);
+    void JobSystemDecrementCounter(JobSystemAtomicCounterHandle counterHandle);
+    bool JobSystemIsWorkerThread();
+    /** Index of the calling worker in [0, JobSystemGetNumWorkerThreads()), JOB_SYSTEM_INVALID_WORKER_THREAD_INDEX on other threads. */
+    uint32 JobSystemGetCurrentWorkerThreadIndex();
+    /** Priority of the job running on the calling worker, Normal outside of jobs. */
+    JobSystemJobPriority JobSystemGetCurrentJobPriority();
+    /** True if the calling worker's deque for the priority is empty, always true outside of workers. */
+    bool JobSystemIsLocalQueueEmpty(JobSystemJobPriority priority);
+
+    void JobSystemLockWaitList(JobSystemWaitList& waitList);
+    void JobSystemUnlockWaitList(JobSystemWaitList& waitList);
+    /**
+     * Takes the fiber a worker continues on while it is parked on a wait list. Call it before locking the list, the fiber pool
+     * may have to grow. Returns nullptr if the caller is no worker or no fiber is free to switch to.
+     */
+    void* JobSystemAcquireParkingFiber();
+    /** Returns a fiber from JobSystemAcquireParkingFiber() that was not needed. */
+    void JobSystemReleaseParkingFiber(void* fiber);
+    /**
+     * Must be called with the wait list locked and a fiber from JobSystemAcquireParkingFiber(). Parks the calling job's fiber
+     * at the tail of the list and switches to the given one, the lock is released once the fiber is linked.
+     */
+    void JobSystemParkOnWaitList(JobSystemWaitList& waitList, void* fiber);
+    /** Must be called with the wait list locked. Unlinks up to maxNumFibers from the head, pass them to JobSystemResumeFibers() after unlocking. */
+    void* JobSystemPopWaitingFibers(JobSystemWaitList& waitList, uint32 maxNumFibers, uint32& outNumFibers);
+    void JobSystemResumeFibers(void* fibers);
+    /** One step of a polling wait: a worker runs a queued job, other threads spin and eventually sleep. */
+    void JobSystemWaitBackoff(uint32& spinCount);
+
+#if HE_JOB_SYSTEM_TRACING
+    enum class JobSystemTraceEventType : uint32
+    {
+        JobBegin,
+        JobEnd,
+        FiberSwitch,
+        WaitBegin,
+        WaitEnd,
+        Steal,
+        SleepBegin,
+        SleepEnd,
+    };
+
+    void JobSystemTraceInit(uint32 numWorkerThreads);
+    /** Appends an event to the worker's ring buffer. Only the worker itself records into its buffer, so no synchronization is needed. */
+    void JobSystemTraceRecord(uint32 workerThreadIndex, JobSystemTraceEventType type, const char* name, uint32 arg);
+#endif
 }
\ No newline at end of file
@@ -0,0 +1,10 @@
+#pragma once
+
+/**
+ * HE_JOB_SYSTEM_TRACING compiles in per-worker trace buffers recording job begin/end, fiber switches, counter waits,
+ * steals and idle sleeps, see JobSystemSetTracingEnabled() and JobSystemDumpTrace().
+ * With 0 every trace point compiles to nothing.
+ */
+#ifndef HE_JOB_SYSTEM_TRACING
+#define HE_JOB_SYSTEM_TRACING 0
+#endif
@@ -0,0 +1,123 @@
+module;
+
+#include "CoreCommon.h"
+
+#include <mutex>
+
+module HorizonEngine.Core.JobSystem;
+
+import HorizonEngine.Core.Memory;
+
+namespace HE
+{
+    JobSystemFrameArena::JobSystemFrameArena(const char* name, uint32 numFramesInFlight, uint64 blockSize)
+        : name(name)
+        , numFramesInFlight(numFramesInFlight)
+        , numThreadArenas(JobSystemGetNumWorkerThreads() + 1)
+        , blockSize(blockSize)
+    {
+        ASSERT(numFramesInFlight > 0);
+        ASSERT(blockSize > sizeof(Block));
+        threadArenas = new ThreadArena[numFramesInFlight * numThreadArenas];
+    }
+
+    JobSystemFrameArena::~JobSystemFrameArena()
+    {
+        for (uint32 i = 0; i < numFramesInFlight * numThreadArenas; i++)
+        {
+            Block* block = threadArenas[i].firstBlock;
+            while (block)
+            {
+                Block* next = block->next;
+                free(block);
+                block = next;
+            }
+        }
+        delete[] threadArenas;
+    }
+
+    void* JobSystemFrameArena::AllocFromThreadArena(ThreadArena& threadArena, uint64 size, uint64 alignment)
+    {
+        ASSERT(alignment && !(alignment & (alignment - 1)));
+        while (true)
+        {
+            if (threadArena.block)
+            {
+                const uint64 begin = (uint64)(threadArena.block + 1);
+                const uint64 p = (begin + threadArena.used + alignment - 1) & ~(alignment - 1);
+                if (p + size <= begin + threadArena.block->size)
+                {
+                    threadArena.used = p + size - begin;
+                    threadArena.allocated += size;
+                    return (void*)p;
+                }
+            }
+
+            // The current block is full. Move on to the next block kept from an earlier frame if the allocation fits,
+            // otherwise insert a new block, sized for the allocation if it is larger than a block.
+            const uint64 requiredSize = size + alignment - 1;
+            Block* next = threadArena.block ? threadArena.block->next : threadArena.firstBlock;
+            if (!next || next->size < requiredSize)
+            {
+                const uint64 newBlockSize = (requiredSize > blockSize - sizeof(Block)) ? requiredSize : blockSize - sizeof(Block);
+                Block* newBlock = (Block*)malloc(sizeof(Block) + newBlockSize);
+                if (!newBlock)
+                {
+                    return nullptr;
+                }
+                newBlock->next = next;
+                newBlock->size = newBlockSize;
+                if (threadArena.block)
+                {
+                    threadArena.block->next = newBlock;
+                }
+                else
+                {
+                    threadArena.firstBlock = newBlock;
+                }
+                next = newBlock;
+            }
+            threadArena.block = next;
+            threadArena.used = 0;
+        }
+    }
+
+    void* JobSystemFrameArena::Alloc(uint64 size, uint64 alignment)
+    {
+        ThreadArena* frameThreadArenas = threadArenas + frameIndex * numThreadArenas;
+        const uint32 workerThreadIndex = JobSystemGetCurrentWorkerThreadIndex();
+        if (workerThreadIndex != JOB_SYSTEM_INVALID_WORKER_THREAD_INDEX)
+        {
+            ASSERT(workerThreadIndex < numThreadArenas - 1);
+            return AllocFromThreadArena(frameThreadArenas[workerThreadIndex], size, alignment);
+        }
+        std::lock_guard<std::mutex> lock(sharedThreadArenaMutex);
+        return AllocFromThreadArena(frameThreadArenas[numThreadArenas - 1], size, alignment);
+    }
+
+    void JobSystemFrameArena::BeginFrame()
+    {
+        frameIndex = (frameIndex + 1) % numFramesInFlight;
+        ThreadArena* frameThreadArenas = threadArenas + frameIndex * numThreadArenas;
+        for (uint32 i = 0; i < numThreadArenas; i++)
+        {
+            // Keep the blocks, the next frames usually need about as much memory.
+            frameThreadArenas[i].block = nullptr;
+            frameThreadArenas[i].used = 0;
+            frameThreadArenas[i].allocated = 0;
+        }
+        // Tracking sees the arena as one, so its live allocations are those of the current frame only.
+        MemoryTrackArenaReset(this);
+    }
+
+    uint64 JobSystemFrameArena::Allocated() const
+    {
+        const ThreadArena* frameThreadArenas = threadArenas + frameIndex * numThreadArenas;
+        uint64 allocated = 0;
+        for (uint32 i = 0; i < numThreadArenas; i++)
+        {
+            allocated += frameThreadArenas[i].allocated;
+        }
+        return allocated;
+    }
+}
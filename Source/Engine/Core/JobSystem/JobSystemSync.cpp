@@ -0,0 +1,171 @@
+module;
+
+#include "CoreCommon.h"
+
+module HorizonEngine.Core.JobSystem;
+
+namespace HE
+{
+    bool JobSystemMutex::TryLock()
+    {
+        JobSystemLockWaitList(waitList);
+        const bool acquired = !locked;
+        locked = true;
+        JobSystemUnlockWaitList(waitList);
+        return acquired;
+    }
+
+    void JobSystemMutex::Lock()
+    {
+        JobSystemLockWaitList(waitList);
+        if (!locked)
+        {
+            locked = true;
+            JobSystemUnlockWaitList(waitList);
+            return;
+        }
+        JobSystemUnlockWaitList(waitList);
+
+        // Taken with the list unlocked since the fiber pool may grow, the mutex has to be checked again afterwards.
+        if (void* fiber = JobSystemAcquireParkingFiber())
+        {
+            JobSystemLockWaitList(waitList);
+            if (!locked)
+            {
+                locked = true;
+                JobSystemUnlockWaitList(waitList);
+                JobSystemReleaseParkingFiber(fiber);
+                return;
+            }
+            JobSystemParkOnWaitList(waitList, fiber);
+            // Unlock() handed the mutex over, it stays locked on our behalf.
+            return;
+        }
+
+        uint32 spinCount = 0;
+        while (!TryLock())
+        {
+            JobSystemWaitBackoff(spinCount);
+        }
+    }
+
+    void JobSystemMutex::Unlock()
+    {
+        JobSystemLockWaitList(waitList);
+        ASSERT(locked);
+        uint32 numFibers;
+        void* fibers = JobSystemPopWaitingFibers(waitList, 1, numFibers);
+        if (numFibers == 0)
+        {
+            locked = false;
+        }
+        JobSystemUnlockWaitList(waitList);
+        JobSystemResumeFibers(fibers);
+    }
+
+    void JobSystemEvent::Set()
+    {
+        JobSystemLockWaitList(waitList);
+        signaled.store(true, std::memory_order_release);
+        uint32 numFibers;
+        void* fibers = JobSystemPopWaitingFibers(waitList, UINT32_MAX, numFibers);
+        JobSystemUnlockWaitList(waitList);
+        JobSystemResumeFibers(fibers);
+    }
+
+    void JobSystemEvent::Reset()
+    {
+        JobSystemLockWaitList(waitList);
+        signaled.store(false, std::memory_order_release);
+        JobSystemUnlockWaitList(waitList);
+    }
+
+    void JobSystemEvent::Wait()
+    {
+        if (IsSet())
+        {
+            return;
+        }
+        JobSystemLockWaitList(waitList);
+        if (signaled.load(std::memory_order_relaxed))
+        {
+            JobSystemUnlockWaitList(waitList);
+            return;
+        }
+        JobSystemUnlockWaitList(waitList);
+
+        if (void* fiber = JobSystemAcquireParkingFiber())
+        {
+            JobSystemLockWaitList(waitList);
+            if (signaled.load(std::memory_order_relaxed))
+            {
+                JobSystemUnlockWaitList(waitList);
+                JobSystemReleaseParkingFiber(fiber);
+                return;
+            }
+            JobSystemParkOnWaitList(waitList, fiber);
+            return;
+        }
+
+        uint32 spinCount = 0;
+        while (!IsSet())
+        {
+            JobSystemWaitBackoff(spinCount);
+        }
+    }
+
+    bool JobSystemSemaphore::TryAcquire()
+    {
+        JobSystemLockWaitList(waitList);
+        const bool acquired = (count > 0);
+        if (acquired)
+        {
+            count--;
+        }
+        JobSystemUnlockWaitList(waitList);
+        return acquired;
+    }
+
+    void JobSystemSemaphore::Acquire()
+    {
+        JobSystemLockWaitList(waitList);
+        if (count > 0)
+        {
+            count--;
+            JobSystemUnlockWaitList(waitList);
+            return;
+        }
+        JobSystemUnlockWaitList(waitList);
+
+        if (void* fiber = JobSystemAcquireParkingFiber())
+        {
+            JobSystemLockWaitList(waitList);
+            if (count > 0)
+            {
+                count--;
+                JobSystemUnlockWaitList(waitList);
+                JobSystemReleaseParkingFiber(fiber);
+                return;
+            }
+            JobSystemParkOnWaitList(waitList, fiber);
+            // Release() handed a permit over without adding it to the count.
+            return;
+        }
+
+        uint32 spinCount = 0;
+        while (!TryAcquire())
+        {
+            JobSystemWaitBackoff(spinCount);
+        }
+    }
+
+    void JobSystemSemaphore::Release(uint32 releaseCount)
+    {
+        JobSystemLockWaitList(waitList);
+        uint32 numFibers;
+        void* fibers = JobSystemPopWaitingFibers(waitList, releaseCount, numFibers);
+        count += releaseCount - numFibers;
+        JobSystemUnlockWaitList(waitList);
+        JobSystemResumeFibers(fibers);
+    }
+}
@@ -0,0 +1,56 @@
+module;
+
+#include "CoreCommon.h"
+
+#include <coroutine>
+
+module HorizonEngine.Core.JobSystem;
+
+import HorizonEngine.Core.Memory;
+
+namespace HE
+{
+    /** Every frame starts with the arena it was allocated from, followed by the frame itself. */
+    struct TaskFrameHeader
+    {
+        alignas(__STDCPP_DEFAULT_NEW_ALIGNMENT__) MemoryArena* arena;
+    };
+
+    /** Frames of a given coroutine always have the same size, so a pool recycles them without touching the heap once warmed up. */
+    PoolArena gDefaultTaskFrameArena("TaskFrameArena");
+    std::atomic<MemoryArena*> gTaskFrameArena;
+
+    void JobSystemSetTaskFrameArena(MemoryArena* arena)
+    {
+        gTaskFrameArena.store(arena, std::memory_order_release);
+    }
+
+    void* JobSystemAllocateTaskFrame(uint64 size)
+    {
+        MemoryArena* arena = gTaskFrameArena.load(std::memory_order_acquire);
+        if (!arena)
+        {
+            arena = &gDefaultTaskFrameArena;
+        }
+        TaskFrameHeader* header = (TaskFrameHeader*)arena->Alloc(sizeof(TaskFrameHeader) + size, alignof(TaskFrameHeader));
+        ASSERT(header);
+        header->arena = arena;
+        return header + 1;
+    }
+
+    void JobSystemFreeTaskFrame(void* frame, uint64 size)
+    {
+        TaskFrameHeader* header = (TaskFrameHeader*)frame - 1;
+        header->arena->Free(header, sizeof(TaskFrameHeader) + size);
+    }
+
+    JobSystemAtomicCounterHandle JobSystemAllocateTaskCounter(uint32 numTasks)
+    {
+        return JobSystemAllocateCounter(numTasks);
+    }
+
+    void JobSystemCompleteTask(JobSystemAtomicCounterHandle counterHandle)
+    {
+        JobSystemDecrementCounter(counterHandle);
+    }
+}
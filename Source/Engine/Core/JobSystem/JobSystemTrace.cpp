@@ -0,0 +1,177 @@
+module;
+
+#include "CoreCommon.h"
+#include "JobSystemDefinitions.h"
+
+#include <atomic>
+#include <chrono>
+
+#if HE_JOB_SYSTEM_TRACING
+#if HE_PLATFORM_WINDOWS
+#include <intrin.h>
+#else
+#include <x86intrin.h>
+#endif
+#endif
+
+module HorizonEngine.Core.JobSystem;
+
+import HorizonEngine.Core.Logging;
+import HorizonEngine.Core.Math;
+
+namespace HE
+{
+#if HE_JOB_SYSTEM_TRACING
+    constexpr uint64 TraceBufferCapacity = 1 << 16;
+
+    struct TraceEvent
+    {
+        uint64 timestamp;
+        const char* name;
+        JobSystemTraceEventType type;
+        uint32 arg;
+    };
+
+    /** Ring buffer of one worker, overwrites its oldest events when full. */
+    struct alignas(64) TraceBuffer
+    {
+        std::atomic<uint64> head;
+        TraceEvent* events;
+    };
+
+    std::atomic<bool> gTracingEnabled;
+    uint32 gNumTraceBuffers;
+    TraceBuffer gTraceBuffers[JOB_SYSTEM_MAX_NUM_WORKER_THREADS];
+    /** Reference points to convert timestamp counter ticks to microseconds when dumping. */
+    uint64 gTraceStartTicks;
+    std::chrono::steady_clock::time_point gTraceStartTime;
+
+    static uint64 ReadTimestampCounter()
+    {
+        return __rdtsc();
+    }
+
+    void JobSystemTraceInit(uint32 numWorkerThreads)
+    {
+        gNumTraceBuffers = numWorkerThreads;
+        gTraceStartTicks = ReadTimestampCounter();
+        gTraceStartTime = std::chrono::steady_clock::now();
+    }
+
+    void JobSystemTraceRecord(uint32 workerThreadIndex, JobSystemTraceEventType type, const char* name, uint32 arg)
+    {
+        // Pairs with the release in JobSystemSetTracingEnabled(), which publishes the buffers allocated there.
+        if (!gTracingEnabled.load(std::memory_order_acquire) || workerThreadIndex >= gNumTraceBuffers)
+        {
+            return;
+        }
+        TraceBuffer& buffer = gTraceBuffers[workerThreadIndex];
+        const uint64 head = buffer.head.load(std::memory_order_relaxed);
+        buffer.events[head & (TraceBufferCapacity - 1)] = { ReadTimestampCounter(), name, type, arg };
+        buffer.head.store(head + 1, std::memory_order_release);
+    }
+
+    void JobSystemSetTracingEnabled(bool enabled)
+    {
+        if (enabled)
+        {
+            for (uint32 i = 0; i < gNumTraceBuffers; i++)
+            {
+                if (!gTraceBuffers[i].events)
+                {
+                    gTraceBuffers[i].events = new TraceEvent[TraceBufferCapacity];
+                }
+            }
+        }
+        gTracingEnabled.store(enabled, std::memory_order_release);
+    }
+
+    static void WriteTraceString(std::ofstream& out, const char* string)
+    {
+        out << '"';
+        for (const char* c = string; *c; c++)
+        {
+            if (*c == '"' || *c == '\\')
+            {
+                out << '\\';
+            }
+            out << *c;
+        }
+        out << '"';
+    }
+
+    bool JobSystemDumpTrace(const char* filename)
+    {
+        std::ofstream out(filename);
+        if (!out)
+        {
+            HE_LOG_ERROR("Failed to open trace file {}.", filename);
+            return false;
+        }
+        out << std::fixed;
+        out.precision(3);
+
+        const double elapsedMicroseconds = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - gTraceStartTime).count();
+        const double ticksPerMicrosecond = (double)(ReadTimestampCounter() - gTraceStartTicks) / Math::Max(elapsedMicroseconds, 1.0);
+
+        out << "{\"traceEvents\":[\n";
+        out << "{\"ph\":\"M\",\"pid\":0,\"name\":\"process_name\",\"args\":{\"name\":\"JobSystem\"}}";
+        for (uint32 workerThreadIndex = 0; workerThreadIndex < gNumTraceBuffers; workerThreadIndex++)
+        {
+            out << ",\n{\"ph\":\"M\",\"pid\":0,\"tid\":" << workerThreadIndex << ",\"name\":\"thread_name\",\"args\":{\"name\":\"WorkerThread " << workerThreadIndex << "\"}}";
+
+            const TraceBuffer& buffer = gTraceBuffers[workerThreadIndex];
+            if (!buffer.events)
+            {
+                continue;
+            }
+            const uint64 head = buffer.head.load(std::memory_order_acquire);
+            const uint64 first = (head > TraceBufferCapacity) ? (head - TraceBufferCapacity) : 0;
+            for (uint64 i = first; i < head; i++)
+            {
+                const TraceEvent& event = buffer.events[i & (TraceBufferCapacity - 1)];
+                const double timestamp = (double)(int64)(event.timestamp - gTraceStartTicks) / ticksPerMicrosecond;
+
+                // Jobs and sleeps are slices on the worker's track, the rest are instant events.
+                const char* phase = "i";
+                const char* name = event.name;
+                switch (event.type)
+                {
+                case JobSystemTraceEventType::JobBegin:    phase = "B"; name = name ? name : "Job"; break;
+                case JobSystemTraceEventType::JobEnd:      phase = "E"; name = name ? name : "Job"; break;
+                case JobSystemTraceEventType::SleepBegin:  phase = "B"; name = "Sleep";             break;
+                case JobSystemTraceEventType::SleepEnd:    phase = "E"; name = "Sleep";             break;
+                case JobSystemTraceEventType::FiberSwitch: name = "FiberSwitch";                    break;
+                case JobSystemTraceEventType::WaitBegin:   name = "WaitForCounter";                 break;
+                case JobSystemTraceEventType::WaitEnd:     name = "CounterReady";                   break;
+                case JobSystemTraceEventType::Steal:       name = "Steal";                          break;
+                default: break;
+                }
+
+                out << ",\n{\"ph\":\"" << phase << "\",\"pid\":0,\"tid\":" << workerThreadIndex << ",\"ts\":" << timestamp << ",\"name\":";
+                WriteTraceString(out, name);
+                if (*phase == 'i')
+                {
+                    out << ",\"s\":\"t\",\"args\":{\"arg\":" << event.arg << "}";
+                }
+                out << "}";
+            }
+        }
+        out << "\n]}\n";
+        return true;
+    }
+#else
+    void JobSystemSetTracingEnabled(bool enabled)
+    {
+        if (enabled)
+        {
+            HE_LOG_WARNING("Job system tracing is compiled out, define HE_JOB_SYSTEM_TRACING to 1 to enable it.");
+        }
+    }
+
+    bool JobSystemDumpTrace(const char* filename)
+    {
+        return false;
+    }
+#endif
+}
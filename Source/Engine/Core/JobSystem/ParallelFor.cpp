@@ -0,0 +1,127 @@
+module;
+
+#include "CoreCommon.h"
+
+module HorizonEngine.Core.JobSystem;
+
+import HorizonEngine.Core.Math;
+
+namespace HE
+{
+    struct ParallelForContext;
+
+    struct ParallelForRangeTask
+    {
+        ParallelForContext* context;
+        uint32 taskIndex;
+        uint32 begin;
+        uint32 end;
+    };
+
+    struct ParallelForContext
+    {
+        JobSystemParallelForFunc func;
+        void* userData;
+        uint32 grain;
+        JobSystemJobPriority priority;
+        JobSystemAtomicCounterHandle counterHandle;
+        std::atomic<uint32> numTasks;
+        uint32 maxNumTasks;
+        ParallelForRangeTask* tasks;
+    };
+
+    static void ExecuteRangeTask(void* data);
+
+    static void SplitRangeTask(ParallelForContext* context, uint32 mid, uint32 end)
+    {
+        const uint32 taskIndex = context->numTasks.fetch_add(1, std::memory_order_relaxed);
+        ASSERT(taskIndex < context->maxNumTasks);
+
+        ParallelForRangeTask& task = context->tasks[taskIndex];
+        task = { context, taskIndex, mid, end };
+
+        JobSystemIncrementCounter(context->counterHandle, 1);
+        JobSystemJobDecl jobDecl = { ExecuteRangeTask, &task, "ParallelFor" };
+        JobSystemRunJobsWithCounter(&jobDecl, 1, context->priority, JobSystemJobAffinity::AnyWorker, context->counterHandle);
+    }
+
+    static void ExecuteRangeTask(void* data)
+    {
+        const ParallelForRangeTask* task = (const ParallelForRangeTask*)data;
+        ParallelForContext* context = task->context;
+
+        uint32 begin = task->begin;
+        uint32 end = task->end;
+        while (begin < end)
+        {
+            // Lazy binary splitting: an empty local deque means nobody has anything to steal from us, so give half away.
+            // Otherwise keep going sequentially, which keeps the number of tasks close to the number of hungry workers.
+            if (end - begin > context->grain && JobSystemIsLocalQueueEmpty(context->priority))
+            {
+                const uint32 mid = begin + (end - begin) / 2;
+                SplitRangeTask(context, mid, end);
+                end = mid;
+                continue;
+            }
+            const uint32 chunkEnd = begin + Math::Min(context->grain, end - begin);
+            context->func(context->userData, task->taskIndex, begin, chunkEnd);
+            begin = chunkEnd;
+        }
+    }
+
+    uint32 JobSystemParallelForDefaultGrain(uint32 begin, uint32 end)
+    {
+        const uint32 count = end - begin;
+        const uint32 numChunks = Math::Max(1u, JobSystemGetNumWorkerThreads()) * 8;
+        return Math::Max(1u, count / numChunks);
+    }
+
+    uint32 JobSystemParallelForMaxNumTasks(uint32 begin, uint32 end, uint32 grain)
+    {
+        // A range is only split when it is larger than the grain, so every task starts with at least grain / 2 elements.
+        return 2 * CEIL_DIV(end - begin, Math::Max(1u, grain)) + 1;
+    }
+
+    void JobSystemParallelFor(uint32 begin, uint32 end, uint32 grain, JobSystemParallelForFunc func, void* userData)
+    {
+        if (begin >= end)
+        {
+            return;
+        }
+        if (grain == 0)
+        {
+            grain = JobSystemParallelForDefaultGrain(begin, end);
+        }
+        if (end - begin <= grain)
+        {
+            func(userData, 0, begin, end);
+            return;
+        }
+
+        ParallelForContext context;
+        context.func = func;
+        context.userData = userData;
+        context.grain = grain;
+        context.priority = JobSystemGetCurrentJobPriority();
+        context.maxNumTasks = JobSystemParallelForMaxNumTasks(begin, end, grain);
+        context.numTasks.store(1, std::memory_order_relaxed);
+
+        std::vector<ParallelForRangeTask> tasks(context.maxNumTasks);
+        context.tasks = tasks.data();
+
+        // The root task runs on the calling thread and accounts for 1 in the counter until it is done.
+        context.counterHandle = JobSystemAllocateCounter(1);
+        tasks[0] = { &context, 0, begin, end };
+        ExecuteRangeTask(&tasks[0]);
+        JobSystemDecrementCounter(context.counterHandle);
+
+        if (JobSystemIsWorkerThread())
+        {
+            JobSystemWaitForCounterAndFree(context.counterHandle, 0);
+        }
+        else
+        {
+            JobSystemWaitForCounterAndFreeWithoutFiber(context.counterHandle);
+        }
+    }
+}
@@ -0,0 +1,114 @@
+module;
+
+#include "CoreCommon.h"
+
+module HorizonEngine.Core.JobSystem;
+
+namespace HE
+{
+    JobSystemTaskHandle JobSystemTaskGraph::AddTask(JobSystemJobFunc jobFunc, void* data, JobSystemJobPriority priority)
+    {
+        ASSERT(!counterHandle);
+        JobSystemTaskHandle handle = (JobSystemTaskHandle)tasks.size();
+        tasks.push_back({
+            .decl = { jobFunc, data },
+            .priority = priority,
+            .numPredecessors = 0,
+            .firstSuccessor = 0,
+            .numSuccessors = 0,
+            .graph = this,
+        });
+        return handle;
+    }
+
+    void JobSystemTaskGraph::AddDependency(JobSystemTaskHandle predecessor, JobSystemTaskHandle successor)
+    {
+        ASSERT(!counterHandle);
+        ASSERT(predecessor < tasks.size() && successor < tasks.size() && predecessor != successor);
+        dependencies.emplace_back(predecessor, successor);
+    }
+
+    JobSystemAtomicCounterHandle JobSystemTaskGraph::Run()
+    {
+        ASSERT(!counterHandle);
+
+        const uint32 numTasks = (uint32)tasks.size();
+
+        // Build the successor lists (CSR) and the predecessor counts.
+        for (const auto& [predecessor, successor] : dependencies)
+        {
+            tasks[predecessor].numSuccessors++;
+            tasks[successor].numPredecessors++;
+        }
+        uint32 offset = 0;
+        for (Task& task : tasks)
+        {
+            task.firstSuccessor = offset;
+            offset += task.numSuccessors;
+            task.numSuccessors = 0;
+        }
+        successors.resize(offset);
+        for (const auto& [predecessor, successor] : dependencies)
+        {
+            Task& task = tasks[predecessor];
+            successors[task.firstSuccessor + task.numSuccessors++] = successor;
+        }
+
+        pendingPredecessors.reset(new std::atomic<uint32>[numTasks]);
+        for (uint32 taskIndex = 0; taskIndex < numTasks; taskIndex++)
+        {
+            pendingPredecessors[taskIndex].store(tasks[taskIndex].numPredecessors, std::memory_order_relaxed);
+        }
+
+        // Every task decrements the counter once when it finishes, whether it was a root or released later.
+        counterHandle = JobSystemAllocateCounter(numTasks);
+
+        bool hasRoot = (numTasks == 0);
+        for (Task& task : tasks)
+        {
+            if (task.numPredecessors == 0)
+            {
+                hasRoot = true;
+                JobSystemJobDecl jobDecl = { TaskEntry, &task };
+                JobSystemRunJobsWithCounter(&jobDecl, 1, task.priority, JobSystemJobAffinity::AnyWorker, counterHandle);
+            }
+        }
+        ASSERT(hasRoot && "Task graph has a cycle.");
+
+        return counterHandle;
+    }
+
+    void JobSystemTaskGraph::Reset()
+    {
+        tasks.clear();
+        dependencies.clear();
+        successors.clear();
+        pendingPredecessors.reset();
+        counterHandle = 0;
+    }
+
+    void JobSystemTaskGraph::TaskEntry(void* data)
+    {
+        Task* task = (Task*)data;
+        if (task->decl.jobFunc)
+        {
+            task->decl.jobFunc(task->decl.data);
+        }
+        task->graph->ReleaseSuccessors(*task);
+    }
+
+    void JobSystemTaskGraph::ReleaseSuccessors(const Task& task)
+    {
+        for (uint32 i = 0; i < task.numSuccessors; i++)
+        {
+            const JobSystemTaskHandle successor = successors[task.firstSuccessor + i];
+            // The last predecessor to finish submits the successor, from this worker so that it lands in its deque.
+            if (pendingPredecessors[successor].fetch_sub(1, std::memory_order_acq_rel) == 1)
+            {
+                Task& successorTask = tasks[successor];
+                JobSystemJobDecl jobDecl = { TaskEntry, &successorTask };
+                JobSystemRunJobsWithCounter(&jobDecl, 1, successorTask.priority, JobSystemJobAffinity::AnyWorker, counterHandle);
+            }
+        }
+    }
+}
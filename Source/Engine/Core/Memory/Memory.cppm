@@ -2,6 +2,11 @@ module;
 
 #include "CoreCommon.h"
 
+#include <atomic>
+#include <mutex>
+#include <memory_resource>
+#include <new>
+
 export module HorizonEngine.Core.Memory;
 
 export import "MemoryDefinitions.h";
@@ -14,14 +19,24 @@ export namespace HE
     {
     public:
         MemoryArena() = default;
-        virtual ~MemoryArena() = default;
+        virtual ~MemoryArena();
         MemoryArena(const MemoryArena&) = delete;
         MemoryArena& operator=(const MemoryArena&) = delete;
         virtual void* Alloc(uint64 size, uint64 alignment) = 0;
         virtual void Free(void* ptr, uint64 size) = 0;
         virtual const char* GetName() const = 0;
+        /** Grows or shrinks an allocation without moving it. Returns false if it has to move, ArenaRealloc() then copies it. */
+        virtual bool TryResize(void* ptr, uint64 oldSize, uint64 newSize)
+        {
+            return false;
+        }
     };
 
+    /** Called by arenas that free everything at once (Reset(), new frame), their tracked allocations are dropped. */
+    void MemoryTrackArenaReset(MemoryArena* arena);
+    /** Called by linear arenas that free everything from top on, e.g. RewindTo(). */
+    void MemoryTrackArenaRewind(MemoryArena* arena, const void* top);
+
     class HeapArena : public MemoryArena
     {
     public:
@@ -60,7 +75,7 @@ export namespace HE
         }
         LinearArena(const LinearArena& rhs) = delete;
         LinearArena& operator=(const LinearArena& rhs) = delete;
-        void* Alloc(uint64 size, uint64 alignment)
+        void* Alloc(uint64 size, uint64 alignment) override
         {
             void* const p = Align(GetCurrent(), alignment);
             void* const c = Add(p, size);
@@ -71,13 +86,35 @@ export namespace HE
             }
             return success ? p : nullptr;
         }
-        void Free(void* ptr, uint64 size)
+        void Free(void* ptr, uint64 size) override
         {
 
         } 
+        /** Grows or shrinks the last allocation in place. */
+        bool TryResize(void* ptr, uint64 oldSize, uint64 newSize) override
+        {
+            if (Add(ptr, oldSize) != GetCurrent() || Add(ptr, newSize) > Add(begin, this->size))
+            {
+                return false;
+            }
+            SetCurrent(Add(ptr, newSize));
+            return true;
+        }
         void Reset() 
         {
             used = 0;
+            MemoryTrackArenaReset(this);
+        }
+        /** Everything allocated after GetMarker() is freed by RewindTo() with the marker, like popping a stack. */
+        uint64 GetMarker() const
+        {
+            return used;
+        }
+        void RewindTo(uint64 marker)
+        {
+            ASSERT(marker <= used);
+            used = marker;
+            MemoryTrackArenaRewind(this, Add(begin, marker));
         }
         uint64 Allocated() const 
         {
@@ -117,5 +154,282 @@ export namespace HE
         uint64 used = 0;
     };
 
+    /**
+     * Linear arena that reserves reserveSize bytes of address space up front and commits pages in steps of commitSize as
+     * allocations need them, so physical memory follows actual use. It never moves, pointers stay valid until Reset().
+     * Exhausting the reserved range is an error. Not thread-safe, like LinearArena.
+     */
+    class VirtualLinearArena : public MemoryArena
+    {
+    public:
+        VirtualLinearArena(const char* name, uint64 reserveSize, uint64 commitSize = 64 * 1024);
+        ~VirtualLinearArena();
+        VirtualLinearArena(const VirtualLinearArena& rhs) = delete;
+        VirtualLinearArena& operator=(const VirtualLinearArena& rhs) = delete;
+        void* Alloc(uint64 size, uint64 alignment) override;
+        void Free(void* ptr, uint64 size) override
+        {
+
+        }
+        /** Grows or shrinks the last allocation in place, committing pages as needed. */
+        bool TryResize(void* ptr, uint64 oldSize, uint64 newSize) override;
+        /**
+         * Frees every allocation at once. Pages stay committed, unless decommit is true: then the pages above the high-water
+         * mark, the most bytes used since the last decommit, are returned to the system and the mark starts over.
+         */
+        void Reset(bool decommit = false);
+        uint64 Allocated() const
+        {
+            return used;
+        }
+        uint64 Committed() const
+        {
+            return committed;
+        }
+        uint64 Reserved() const
+        {
+            return reserved;
+        }
+        uint64 GetHighWaterMark() const
+        {
+            return (used > highWaterMark) ? used : highWaterMark;
+        }
+        /** Everything allocated after GetMarker() is freed by RewindTo() with the marker, pages stay committed. */
+        uint64 GetMarker() const
+        {
+            return used;
+        }
+        void RewindTo(uint64 marker);
+        char const* GetName() const override
+        {
+            return name;
+        }
+    private:
+        bool Commit(uint64 size);
+        const char* name = nullptr;
+        uint8* begin = nullptr;
+        uint64 reserved = 0;
+        uint64 commitSize = 0;
+        uint64 committed = 0;
+        uint64 used = 0;
+        uint64 highWaterMark = 0;
+    };
+
+    /**
+     * Frees the temporary allocations made from a LinearArena or VirtualLinearArena during its lifetime, e.g.
+     *     ScopedArenaMarker scope(arena);
+     *     Vertex* vertices = (Vertex*)HE_ARENA_ALLOC(arena, size);
+     */
+    template<typename ArenaType>
+    class ScopedArenaMarker
+    {
+    public:
+        ScopedArenaMarker(ArenaType* arena) : arena(arena), marker(arena->GetMarker()) {}
+        ~ScopedArenaMarker()
+        {
+            arena->RewindTo(marker);
+        }
+        ScopedArenaMarker(const ScopedArenaMarker& rhs) = delete;
+        ScopedArenaMarker& operator=(const ScopedArenaMarker& rhs) = delete;
+    private:
+        ArenaType* arena;
+        uint64 marker;
+    };
+
+    /**
+     * Pool of fixed-size blocks for objects that are allocated and freed one at a time. Requests are rounded up to one of
+     * NumSizeClasses block sizes, larger ones go to the heap. Blocks are carved from SlabSize slabs aligned to their size,
+     * so Free() finds the size class from the slab header. Each thread caches a few free blocks per size class, most Alloc()
+     * and Free() calls take no lock. Reset() frees every block at once.
+     */
+    class PoolArena : public MemoryArena
+    {
+    public:
+        static constexpr uint32 NumSizeClasses = 16;
+        static constexpr uint64 MaxBlockSize = 4096;
+        static constexpr uint64 SlabSize = 64 * 1024;
+        PoolArena(const char* name);
+        ~PoolArena();
+        PoolArena(const PoolArena& rhs) = delete;
+        PoolArena& operator=(const PoolArena& rhs) = delete;
+        void* Alloc(uint64 size, uint64 alignment) override;
+        void Free(void* ptr, uint64 size) override;
+        /** Frees every block at once and keeps the slabs for reuse. No thread may use the arena meanwhile. */
+        void Reset();
+        /** Bytes of slabs, without the heap allocations of large blocks. */
+        uint64 Reserved() const
+        {
+            return numSlabs.load(std::memory_order_relaxed) * SlabSize;
+        }
+        char const* GetName() const override
+        {
+            return name;
+        }
+    private:
+        struct FreeBlock
+        {
+            FreeBlock* next;
+        };
+        struct SlabHeader
+        {
+            SlabHeader* next;
+            uint32 sizeClassIndex;
+        };
+        struct SizeClass
+        {
+            std::mutex mutex;
+            FreeBlock* freeList = nullptr;
+            uint8* slabCursor = nullptr;
+            uint8* slabEnd = nullptr;
+        };
+        uint32 AllocFromSizeClass(uint32 sizeClassIndex, FreeBlock** outBlocks, uint32 maxNumBlocks);
+        void FreeToSizeClass(uint32 sizeClassIndex, FreeBlock* first, FreeBlock* last);
+        const char* name = nullptr;
+        /** Index of the thread caches of this arena, PoolArenaInvalidCacheIndex if every one is taken. */
+        uint32 cacheIndex;
+        /** Changes with every Reset(), thread caches of an older generation are dropped. */
+        std::atomic<uint64> generation;
+        SizeClass sizeClasses[NumSizeClasses];
+        std::mutex slabMutex;
+        SlabHeader* slabs = nullptr;
+        SlabHeader* freeSlabs = nullptr;
+        std::atomic<uint64> numSlabs = 0;
+        HeapArena heapArena = HeapArena("PoolHeapArena");
+    };
+
+    struct TlsfArenaStats
+    {
+        /** Bytes of all pools, block headers included. */
+        uint64 reservedBytes;
+        uint64 usedBytes;
+        uint64 freeBytes;
+        uint64 largestFreeBlock;
+        uint32 numUsedBlocks;
+        uint32 numFreeBlocks;
+        uint32 numPools;
+        /** 1 - largestFreeBlock / freeBytes, 0 when all free memory is one block. */
+        float fragmentation;
+    };
+
+    /**
+     * General-purpose arena for long-lived allocations of any size, e.g. asset data, based on two-level segregated fit (TLSF).
+     * Free blocks are kept in lists by size class, found through two levels of bitmaps, and merged with their free neighbors
+     * when freed, so Alloc() and Free() take constant time and keep fragmentation low. TryResize() grows an allocation
+     * into a free neighbor. The arena starts with one pool of poolSize bytes and adds pools when no free block fits.
+     */
+    class TlsfArena : public MemoryArena
+    {
+    public:
+        TlsfArena(const char* name, uint64 poolSize);
+        ~TlsfArena();
+        TlsfArena(const TlsfArena& rhs) = delete;
+        TlsfArena& operator=(const TlsfArena& rhs) = delete;
+        void* Alloc(uint64 size, uint64 alignment) override;
+        void Free(void* ptr, uint64 size) override;
+        bool TryResize(void* ptr, uint64 oldSize, uint64 newSize) override;
+        /** Walks every block, meant for diagnostics rather than every frame. */
+        TlsfArenaStats GetStats();
+        char const* GetName() const override
+        {
+            return name;
+        }
+        static constexpr uint32 SecondLevelIndexCountLog2 = 5;
+        static constexpr uint32 SecondLevelIndexCount = 1 << SecondLevelIndexCountLog2;
+        static constexpr uint32 FirstLevelIndexMax = 40;
+        static constexpr uint32 FirstLevelIndexShift = SecondLevelIndexCountLog2 + 4;
+        static constexpr uint32 FirstLevelIndexCount = FirstLevelIndexMax - FirstLevelIndexShift + 1;
+    private:
+        struct Block;
+        Block* AddPool(uint64 size);
+        void InsertFreeBlock(Block* block);
+        void RemoveFreeBlock(Block* block);
+        Block* FindFreeBlock(uint64 size);
+        Block* SplitBlock(Block* block, uint64 size);
+        Block* MergeWithNext(Block* block);
+        const char* name = nullptr;
+        uint64 poolSize;
+        std::mutex mutex;
+        uint32 firstLevelBitmap = 0;
+        uint32 secondLevelBitmaps[FirstLevelIndexCount] = {};
+        Block* freeLists[FirstLevelIndexCount][SecondLevelIndexCount] = {};
+        std::vector<void*> pools;
+    };
+
+    /** Pool shared by engine objects that are allocated and freed one at a time, e.g. render graph nodes and render commands. */
+    PoolArena* GetDefaultPoolArena();
+
+    struct MemoryArenaStats
+    {
+        uint64 liveBytes;
+        uint64 peakBytes;
+        uint64 numAllocations;
+        uint64 numFrees;
+        uint64 numLiveAllocations;
+    };
+
+    enum class MemoryBudgetAction
+    {
+        /** Logs a warning each time the arena goes over its budget. */
+        Warn,
+        /** Logs an error and asserts. */
+        Assert,
+    };
+
+    /** Sets the budget of live bytes of an arena, 0 removes it. Does nothing unless HE_MEMORY_TRACKING is enabled. */
+    void MemorySetArenaBudget(MemoryArena* arena, uint64 budget, MemoryBudgetAction action = MemoryBudgetAction::Warn);
+    /** All zeros unless HE_MEMORY_TRACKING is enabled. */
+    MemoryArenaStats MemoryGetArenaStats(MemoryArena* arena);
+    /**
+     * Writes live and peak bytes of every arena and its callsites sorted by live bytes, with a histogram of allocation sizes.
+     * Goes to the log if filename is null.
+     */
+    bool MemoryDumpReport(const char* filename = nullptr);
     void* ArenaRealloc(MemoryArena* arena, void* ptr, uint64 oldSize, uint64 newSize, uint64 alignment, const char* file, uint32 line);
+
+    /**
+     * Lets std::pmr containers allocate from an arena, e.g. std::pmr::vector<uint32> indices(&resource).
+     * Deallocation goes to the arena's Free(), a no-op for linear and frame arenas, where a growing container leaves
+     * its old storage behind until the arena is reset. The resource must outlive the containers using it.
+     */
+    class MemoryArenaResource : public std::pmr::memory_resource
+    {
+    public:
+        MemoryArenaResource(MemoryArena* arena) : arena(arena) {}
+        MemoryArena* GetArena() const
+        {
+            return arena;
+        }
+    private:
+        void* do_allocate(size_t bytes, size_t alignment) override
+        {
+            // Zero-sized requests still need a unique pointer.
+            void* ptr = HE_ARENA_ALIGNED_ALLOC(arena, bytes ? bytes : 1, alignment);
+            // Containers expect the allocation to succeed or throw, never a null pointer.
+            if (!ptr)
+            {
+                throw std::bad_alloc();
+            }
+            return ptr;
+        }
+        void do_deallocate(void* ptr, size_t bytes, size_t alignment) override
+        {
+            HE_ARENA_ALIGNED_FREE(arena, ptr, bytes ? bytes : 1, alignment);
+        }
+        bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override
+        {
+            const MemoryArenaResource* otherResource = dynamic_cast<const MemoryArenaResource*>(&other);
+            return otherResource && (otherResource->arena == arena);
+        }
+        MemoryArena* arena;
+    };
+}
+
+namespace HE
+{
+#if HE_MEMORY_TRACKING
+    /** Module internal, called by ArenaRealloc() and ~MemoryArena(). */
+    void MemoryTrackAlloc(MemoryArena* arena, void* ptr, uint64 size, const char* file, uint32 line);
+    void MemoryTrackFree(MemoryArena* arena, void* ptr);
+    void MemoryTrackArenaDestroyed(MemoryArena* arena);
+#endif
 }
\ No newline at end of file
@@ -1,6 +1,7 @@
 module;
 
 #include "CoreCommon.h"
+#include "MemoryDefinitions.h"
 
 module HorizonEngine.Core.Memory;
 
@@ -8,21 +9,51 @@ import HorizonEngine.Core.Math;
 
 namespace HE
 {
+	MemoryArena::~MemoryArena()
+	{
+#if HE_MEMORY_TRACKING
+		MemoryTrackArenaDestroyed(this);
+#endif
+	}
+
 	void* ArenaRealloc(MemoryArena* arena, void* ptr, uint64 oldSize, uint64 newSize, uint64 alignment, const char* file, uint32 line)
 	{
 		ASSERT(arena);
 		void* newPtr = nullptr;
+		if (ptr && newSize && arena->TryResize(ptr, oldSize, newSize))
+		{
+#if HE_MEMORY_TRACKING
+			MemoryTrackFree(arena, ptr);
+			MemoryTrackAlloc(arena, ptr, newSize, file, line);
+#endif
+			return ptr;
+		}
 		if (newSize)
 		{
 			newPtr = arena->Alloc(newSize, alignment);
+#if HE_MEMORY_TRACKING
+			if (newPtr)
+			{
+				MemoryTrackAlloc(arena, newPtr, newSize, file, line);
+			}
+#endif
 			if (ptr)
 			{
 				memcpy(newPtr, ptr, Math::Min(oldSize, newSize));
+#if HE_MEMORY_TRACKING
+				MemoryTrackFree(arena, ptr);
+#endif
 				arena->Free(ptr, oldSize);
 			}
 		}
 		else
 		{
+#if HE_MEMORY_TRACKING
+			if (ptr)
+			{
+				MemoryTrackFree(arena, ptr);
+			}
+#endif
 			arena->Free(ptr, oldSize);
 		}
 		return newPtr;
@@ -1,5 +1,14 @@
 #pragma once
 
+/**
+ * HE_MEMORY_TRACKING makes ArenaRealloc() record every allocation made through the HE_ARENA_* macros with its file and line:
+ * live and peak bytes and allocation counts per arena, and counts and size histograms per callsite. It enables budgets,
+ * see MemorySetArenaBudget(), MemoryGetArenaStats() and MemoryDumpReport(). With 0 the file and line are ignored.
+ */
+#ifndef HE_MEMORY_TRACKING
+#define HE_MEMORY_TRACKING 0
+#endif
+
 #define HE_ARENA_ALLOC(arena, size)                                          (::HE::ArenaRealloc(arena, nullptr, 0,       size,    HE_DEFAULT_ALIGNMENT, __FILE__, __LINE__))
 #define HE_ARENA_FREE(arena, ptr, size)                                      (::HE::ArenaRealloc(arena, ptr,     size,    0,       HE_DEFAULT_ALIGNMENT, __FILE__, __LINE__))
 #define HE_ARENA_REALLOC(arena, ptr, oldSize, newSize)                       (::HE::ArenaRealloc(arena, ptr,     oldSize, newSize, HE_DEFAULT_ALIGNMENT, __FILE__, __LINE__))
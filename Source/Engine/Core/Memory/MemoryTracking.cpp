@@ -0,0 +1,308 @@
+module;
+
+#include "CoreCommon.h"
+#include "MemoryDefinitions.h"
+
+#include <mutex>
+
+module HorizonEngine.Core.Memory;
+
+import HorizonEngine.Core.Math;
+import HorizonEngine.Core.Logging;
+
+namespace HE
+{
+#if HE_MEMORY_TRACKING
+	/** Allocation sizes up to 64 B, 256 B, 1 KB, 4 KB, 16 KB, 64 KB, 1 MB, and above. */
+	static constexpr uint64 MemoryHistogramBucketLimits[] = { 64, 256, 1024, 4096, 16384, 65536, 1048576, UINT64_MAX };
+	static constexpr const char* MemoryHistogramBucketNames[] = { "64B", "256B", "1KB", "4KB", "16KB", "64KB", "1MB", ">1MB" };
+	static constexpr uint32 NumMemoryHistogramBuckets = ARRAY_SIZE(MemoryHistogramBucketLimits);
+
+	struct MemoryCallsite
+	{
+		const char* file;
+		uint32 line;
+		uint64 liveBytes;
+		uint64 peakBytes;
+		uint64 numAllocations;
+		uint64 numLiveAllocations;
+		uint64 histogram[NumMemoryHistogramBuckets];
+	};
+
+	struct MemoryTrackedAllocation
+	{
+		uint64 size;
+		MemoryCallsite* callsite;
+	};
+
+	struct MemoryArenaTracking
+	{
+		MemoryArenaStats stats;
+		uint64 budget;
+		MemoryBudgetAction budgetAction;
+		bool overBudget;
+		/** Keyed by the address of the file string and the line, __FILE__ of one translation unit is a single string. */
+		std::map<std::pair<const char*, uint32>, MemoryCallsite> callsites;
+		std::unordered_map<void*, MemoryTrackedAllocation> allocations;
+	};
+
+	struct MemoryTracking
+	{
+		std::mutex mutex;
+		std::unordered_map<MemoryArena*, MemoryArenaTracking> arenas;
+	};
+
+	/** Never destroyed, arenas with static storage duration in other translation units may be destroyed after it. */
+	static MemoryTracking& GetMemoryTracking()
+	{
+		static MemoryTracking* tracking = new MemoryTracking();
+		return *tracking;
+	}
+
+	static uint32 GetMemoryHistogramBucket(uint64 size)
+	{
+		uint32 bucket = 0;
+		while (size > MemoryHistogramBucketLimits[bucket])
+		{
+			bucket++;
+		}
+		return bucket;
+	}
+
+	void MemoryTrackAlloc(MemoryArena* arena, void* ptr, uint64 size, const char* file, uint32 line)
+	{
+		MemoryTracking& memoryTracking = GetMemoryTracking();
+		std::lock_guard<std::mutex> lock(memoryTracking.mutex);
+		MemoryArenaTracking& tracking = memoryTracking.arenas[arena];
+
+		MemoryCallsite& callsite = tracking.callsites[{ file, line }];
+		callsite.file = file;
+		callsite.line = line;
+		callsite.liveBytes += size;
+		callsite.peakBytes = Math::Max(callsite.peakBytes, callsite.liveBytes);
+		callsite.numAllocations++;
+		callsite.numLiveAllocations++;
+		callsite.histogram[GetMemoryHistogramBucket(size)]++;
+		tracking.allocations[ptr] = { size, &callsite };
+
+		MemoryArenaStats& stats = tracking.stats;
+		stats.liveBytes += size;
+		stats.peakBytes = Math::Max(stats.peakBytes, stats.liveBytes);
+		stats.numAllocations++;
+		stats.numLiveAllocations++;
+
+		if (tracking.budget && stats.liveBytes > tracking.budget)
+		{
+			if (!tracking.overBudget)
+			{
+				tracking.overBudget = true;
+				if (tracking.budgetAction == MemoryBudgetAction::Assert)
+				{
+					HE_LOG_ERROR("Memory arena {} is over its budget: {} of {} bytes, allocating {} bytes at {}:{}.", arena->GetName() ? arena->GetName() : "", stats.liveBytes, tracking.budget, size, file, line);
+					ASSERT(false && "Memory arena over budget.");
+				}
+				else
+				{
+					HE_LOG_WARNING("Memory arena {} is over its budget: {} of {} bytes, allocating {} bytes at {}:{}.", arena->GetName() ? arena->GetName() : "", stats.liveBytes, tracking.budget, size, file, line);
+				}
+			}
+		}
+	}
+
+	void MemoryTrackFree(MemoryArena* arena, void* ptr)
+	{
+		MemoryTracking& memoryTracking = GetMemoryTracking();
+		std::lock_guard<std::mutex> lock(memoryTracking.mutex);
+		auto trackingIt = memoryTracking.arenas.find(arena);
+		if (trackingIt == memoryTracking.arenas.end())
+		{
+			return;
+		}
+		MemoryArenaTracking& tracking = trackingIt->second;
+		auto allocationIt = tracking.allocations.find(ptr);
+		if (allocationIt == tracking.allocations.end())
+		{
+			// Allocated before the last reset, or without the HE_ARENA_* macros.
+			return;
+		}
+		const MemoryTrackedAllocation& allocation = allocationIt->second;
+		allocation.callsite->liveBytes -= allocation.size;
+		allocation.callsite->numLiveAllocations--;
+		tracking.stats.liveBytes -= allocation.size;
+		tracking.stats.numLiveAllocations--;
+		tracking.stats.numFrees++;
+		tracking.allocations.erase(allocationIt);
+		if (tracking.stats.liveBytes <= tracking.budget)
+		{
+			tracking.overBudget = false;
+		}
+	}
+
+	void MemoryTrackArenaReset(MemoryArena* arena)
+	{
+		MemoryTracking& memoryTracking = GetMemoryTracking();
+		std::lock_guard<std::mutex> lock(memoryTracking.mutex);
+		auto trackingIt = memoryTracking.arenas.find(arena);
+		if (trackingIt == memoryTracking.arenas.end())
+		{
+			return;
+		}
+		MemoryArenaTracking& tracking = trackingIt->second;
+		for (auto& [key, callsite] : tracking.callsites)
+		{
+			callsite.liveBytes = 0;
+			callsite.numLiveAllocations = 0;
+		}
+		tracking.stats.numFrees += tracking.stats.numLiveAllocations;
+		tracking.stats.liveBytes = 0;
+		tracking.stats.numLiveAllocations = 0;
+		tracking.allocations.clear();
+		tracking.overBudget = false;
+	}
+
+	void MemoryTrackArenaRewind(MemoryArena* arena, const void* top)
+	{
+		MemoryTracking& memoryTracking = GetMemoryTracking();
+		std::lock_guard<std::mutex> lock(memoryTracking.mutex);
+		auto trackingIt = memoryTracking.arenas.find(arena);
+		if (trackingIt == memoryTracking.arenas.end())
+		{
+			return;
+		}
+		MemoryArenaTracking& tracking = trackingIt->second;
+		for (auto allocationIt = tracking.allocations.begin(); allocationIt != tracking.allocations.end();)
+		{
+			if (allocationIt->first < top)
+			{
+				++allocationIt;
+				continue;
+			}
+			const MemoryTrackedAllocation& allocation = allocationIt->second;
+			allocation.callsite->liveBytes -= allocation.size;
+			allocation.callsite->numLiveAllocations--;
+			tracking.stats.liveBytes -= allocation.size;
+			tracking.stats.numLiveAllocations--;
+			tracking.stats.numFrees++;
+			allocationIt = tracking.allocations.erase(allocationIt);
+		}
+		if (tracking.stats.liveBytes <= tracking.budget)
+		{
+			tracking.overBudget = false;
+		}
+	}
+
+	void MemoryTrackArenaDestroyed(MemoryArena* arena)
+	{
+		MemoryTracking& memoryTracking = GetMemoryTracking();
+		std::lock_guard<std::mutex> lock(memoryTracking.mutex);
+		memoryTracking.arenas.erase(arena);
+	}
+
+	void MemorySetArenaBudget(MemoryArena* arena, uint64 budget, MemoryBudgetAction action)
+	{
+		MemoryTracking& memoryTracking = GetMemoryTracking();
+		std::lock_guard<std::mutex> lock(memoryTracking.mutex);
+		MemoryArenaTracking& tracking = memoryTracking.arenas[arena];
+		tracking.budget = budget;
+		tracking.budgetAction = action;
+		tracking.overBudget = false;
+	}
+
+	MemoryArenaStats MemoryGetArenaStats(MemoryArena* arena)
+	{
+		MemoryTracking& memoryTracking = GetMemoryTracking();
+		std::lock_guard<std::mutex> lock(memoryTracking.mutex);
+		auto trackingIt = memoryTracking.arenas.find(arena);
+		return (trackingIt != memoryTracking.arenas.end()) ? trackingIt->second.stats : MemoryArenaStats{};
+	}
+
+	bool MemoryDumpReport(const char* filename)
+	{
+		std::stringstream report;
+		{
+			MemoryTracking& memoryTracking = GetMemoryTracking();
+			std::lock_guard<std::mutex> lock(memoryTracking.mutex);
+			std::vector<std::pair<MemoryArena*, const MemoryArenaTracking*>> arenas;
+			for (const auto& [arena, tracking] : memoryTracking.arenas)
+			{
+				arenas.emplace_back(arena, &tracking);
+			}
+			std::sort(arenas.begin(), arenas.end(), [](const auto& lhs, const auto& rhs) { return lhs.second->stats.liveBytes > rhs.second->stats.liveBytes; });
+
+			for (const auto& [arena, tracking] : arenas)
+			{
+				const MemoryArenaStats& stats = tracking->stats;
+				report << "Arena " << (arena->GetName() ? arena->GetName() : "(unnamed)")
+					<< ": live " << stats.liveBytes << " B in " << stats.numLiveAllocations << " allocations, peak " << stats.peakBytes << " B";
+				if (tracking->budget)
+				{
+					report << ", budget " << tracking->budget << " B" << (stats.liveBytes > tracking->budget ? " (over)" : "");
+				}
+				report << ", " << stats.numAllocations << " allocations and " << stats.numFrees << " frees in total\n";
+
+				std::vector<const MemoryCallsite*> callsites;
+				for (const auto& [key, callsite] : tracking->callsites)
+				{
+					callsites.push_back(&callsite);
+				}
+				std::sort(callsites.begin(), callsites.end(), [](const MemoryCallsite* lhs, const MemoryCallsite* rhs) { return lhs->liveBytes > rhs->liveBytes; });
+				for (const MemoryCallsite* callsite : callsites)
+				{
+					report << "    " << callsite->file << ":" << callsite->line
+						<< ": live " << callsite->liveBytes << " B in " << callsite->numLiveAllocations << " allocations, peak " << callsite->peakBytes
+						<< " B, " << callsite->numAllocations << " allocations, sizes";
+					for (uint32 bucket = 0; bucket < NumMemoryHistogramBuckets; bucket++)
+					{
+						if (callsite->histogram[bucket])
+						{
+							report << " " << MemoryHistogramBucketNames[bucket] << ":" << callsite->histogram[bucket];
+						}
+					}
+					report << "\n";
+				}
+			}
+		}
+
+		if (!filename)
+		{
+			HE_LOG_INFO("Memory report:\n{}", report.str());
+			return true;
+		}
+		FILE* file = fopen(filename, "w");
+		if (!file)
+		{
+			HE_LOG_ERROR("Failed to write memory report to {}.", filename);
+			return false;
+		}
+		const std::string text = report.str();
+		fwrite(text.data(), 1, text.size(), file);
+		fclose(file);
+		return true;
+	}
+#else
+	void MemorySetArenaBudget(MemoryArena* arena, uint64 budget, MemoryBudgetAction action)
+	{
+
+	}
+
+	MemoryArenaStats MemoryGetArenaStats(MemoryArena* arena)
+	{
+		return {};
+	}
+
+	bool MemoryDumpReport(const char* filename)
+	{
+		return false;
+	}
+
+	void MemoryTrackArenaReset(MemoryArena* arena)
+	{
+
+	}
+
+	void MemoryTrackArenaRewind(MemoryArena* arena, const void* top)
+	{
+
+	}
+#endif
+}
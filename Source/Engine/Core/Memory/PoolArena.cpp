@@ -0,0 +1,257 @@
+module;
+
+#include "CoreCommon.h"
+
+#include <atomic>
+#include <mutex>
+
+module HorizonEngine.Core.Memory;
+
+namespace HE
+{
+	static constexpr uint64 PoolArenaBlockSizes[PoolArena::NumSizeClasses] =
+	{
+		16, 32, 48, 64, 96, 128, 192, 256, 384, 512, 768, 1024, 1536, 2048, 3072, 4096,
+	};
+
+	enum
+	{
+		PoolArenaMaxNumCaches = 32,
+		PoolArenaInvalidCacheIndex = 0xFFFFFFFF,
+		/** Blocks moved between a thread cache and the shared free list at once. */
+		PoolArenaCacheBatchSize = 16,
+		PoolArenaMaxNumCachedBlocks = 2 * PoolArenaCacheBatchSize,
+	};
+
+	struct PoolArenaThreadCache
+	{
+		uint64 generation;
+		void* freeLists[PoolArena::NumSizeClasses];
+		uint32 numBlocks[PoolArena::NumSizeClasses];
+	};
+
+	static std::mutex gPoolArenaCacheIndicesMutex;
+	static bool gPoolArenaCacheIndicesInUse[PoolArenaMaxNumCaches];
+	/** Shared by all arenas so that a cache index reused by a new arena never matches the generation of the old one. */
+	static std::atomic<uint64> gPoolArenaNextGeneration = 1;
+	thread_local PoolArenaThreadCache tPoolArenaThreadCaches[PoolArenaMaxNumCaches];
+
+	static uint32 GetPoolArenaSizeClassIndex(uint64 size, uint64 alignment)
+	{
+		for (uint32 sizeClassIndex = 0; sizeClassIndex < PoolArena::NumSizeClasses; sizeClassIndex++)
+		{
+			const uint64 blockSize = PoolArenaBlockSizes[sizeClassIndex];
+			// Blocks are aligned to the lowest set bit of their size.
+			if (blockSize >= size && (blockSize & (alignment - 1)) == 0)
+			{
+				return sizeClassIndex;
+			}
+		}
+		return PoolArena::NumSizeClasses;
+	}
+
+	static PoolArenaThreadCache* GetPoolArenaThreadCache(uint32 cacheIndex, uint64 generation)
+	{
+		if (cacheIndex == PoolArenaInvalidCacheIndex)
+		{
+			return nullptr;
+		}
+		PoolArenaThreadCache* cache = &tPoolArenaThreadCaches[cacheIndex];
+		if (cache->generation != generation)
+		{
+			// Cached blocks of a reset or destroyed arena are gone with it.
+			*cache = {};
+			cache->generation = generation;
+		}
+		return cache;
+	}
+
+	PoolArena::PoolArena(const char* name)
+		: name(name)
+		, cacheIndex(PoolArenaInvalidCacheIndex)
+		, generation(gPoolArenaNextGeneration.fetch_add(1, std::memory_order_relaxed))
+	{
+		std::lock_guard<std::mutex> lock(gPoolArenaCacheIndicesMutex);
+		for (uint32 i = 0; i < PoolArenaMaxNumCaches; i++)
+		{
+			if (!gPoolArenaCacheIndicesInUse[i])
+			{
+				gPoolArenaCacheIndicesInUse[i] = true;
+				cacheIndex = i;
+				break;
+			}
+		}
+	}
+
+	PoolArena::~PoolArena()
+	{
+		for (SlabHeader* list : { slabs, freeSlabs })
+		{
+			while (list)
+			{
+				SlabHeader* next = list->next;
+				_aligned_free(list);
+				list = next;
+			}
+		}
+		if (cacheIndex != PoolArenaInvalidCacheIndex)
+		{
+			std::lock_guard<std::mutex> lock(gPoolArenaCacheIndicesMutex);
+			gPoolArenaCacheIndicesInUse[cacheIndex] = false;
+		}
+	}
+
+	uint32 PoolArena::AllocFromSizeClass(uint32 sizeClassIndex, FreeBlock** outBlocks, uint32 maxNumBlocks)
+	{
+		const uint64 blockSize = PoolArenaBlockSizes[sizeClassIndex];
+		SizeClass& sizeClass = sizeClasses[sizeClassIndex];
+		std::lock_guard<std::mutex> lock(sizeClass.mutex);
+		uint32 numBlocks = 0;
+		while (numBlocks < maxNumBlocks && sizeClass.freeList)
+		{
+			outBlocks[numBlocks++] = sizeClass.freeList;
+			sizeClass.freeList = sizeClass.freeList->next;
+		}
+		while (numBlocks < maxNumBlocks)
+		{
+			if (sizeClass.slabCursor + blockSize > sizeClass.slabEnd)
+			{
+				SlabHeader* slab = nullptr;
+				{
+					std::lock_guard<std::mutex> slabLock(slabMutex);
+					slab = freeSlabs;
+					if (slab)
+					{
+						freeSlabs = slab->next;
+					}
+					else
+					{
+						slab = (SlabHeader*)_aligned_malloc(SlabSize, SlabSize);
+						if (!slab)
+						{
+							break;
+						}
+						numSlabs.fetch_add(1, std::memory_order_relaxed);
+					}
+					slab->next = slabs;
+					slabs = slab;
+				}
+				slab->sizeClassIndex = sizeClassIndex;
+				const uint64 blockAlignment = blockSize & (~blockSize + 1);
+				const uint64 firstBlockOffset = (sizeof(SlabHeader) + blockAlignment - 1) & ~(blockAlignment - 1);
+				sizeClass.slabCursor = (uint8*)slab + firstBlockOffset;
+				sizeClass.slabEnd = (uint8*)slab + SlabSize;
+			}
+			outBlocks[numBlocks++] = (FreeBlock*)sizeClass.slabCursor;
+			sizeClass.slabCursor += blockSize;
+		}
+		return numBlocks;
+	}
+
+	void PoolArena::FreeToSizeClass(uint32 sizeClassIndex, FreeBlock* first, FreeBlock* last)
+	{
+		SizeClass& sizeClass = sizeClasses[sizeClassIndex];
+		std::lock_guard<std::mutex> lock(sizeClass.mutex);
+		last->next = sizeClass.freeList;
+		sizeClass.freeList = first;
+	}
+
+	void* PoolArena::Alloc(uint64 size, uint64 alignment)
+	{
+		ASSERT(alignment && !(alignment & (alignment - 1)));
+		ASSERT(alignment <= MaxBlockSize);
+		const uint32 sizeClassIndex = GetPoolArenaSizeClassIndex(size, alignment);
+		if (sizeClassIndex == NumSizeClasses)
+		{
+			return heapArena.Alloc(size, alignment);
+		}
+		PoolArenaThreadCache* cache = GetPoolArenaThreadCache(cacheIndex, generation.load(std::memory_order_relaxed));
+		if (!cache)
+		{
+			FreeBlock* block = nullptr;
+			AllocFromSizeClass(sizeClassIndex, &block, 1);
+			return block;
+		}
+		if (!cache->freeLists[sizeClassIndex])
+		{
+			FreeBlock* blocks[PoolArenaCacheBatchSize];
+			const uint32 numBlocks = AllocFromSizeClass(sizeClassIndex, blocks, PoolArenaCacheBatchSize);
+			for (uint32 i = 0; i < numBlocks; i++)
+			{
+				blocks[i]->next = (FreeBlock*)cache->freeLists[sizeClassIndex];
+				cache->freeLists[sizeClassIndex] = blocks[i];
+			}
+			cache->numBlocks[sizeClassIndex] = numBlocks;
+			if (!numBlocks)
+			{
+				return nullptr;
+			}
+		}
+		FreeBlock* block = (FreeBlock*)cache->freeLists[sizeClassIndex];
+		cache->freeLists[sizeClassIndex] = block->next;
+		cache->numBlocks[sizeClassIndex]--;
+		return block;
+	}
+
+	void PoolArena::Free(void* ptr, uint64 size)
+	{
+		if (!ptr)
+		{
+			return;
+		}
+		if (size > MaxBlockSize)
+		{
+			heapArena.Free(ptr, size);
+			return;
+		}
+		// The block may have been rounded up further for alignment, the slab knows its actual size class.
+		const uint32 sizeClassIndex = ((SlabHeader*)((uint64)ptr & ~(SlabSize - 1)))->sizeClassIndex;
+		FreeBlock* block = (FreeBlock*)ptr;
+		PoolArenaThreadCache* cache = GetPoolArenaThreadCache(cacheIndex, generation.load(std::memory_order_relaxed));
+		if (!cache)
+		{
+			FreeToSizeClass(sizeClassIndex, block, block);
+			return;
+		}
+		block->next = (FreeBlock*)cache->freeLists[sizeClassIndex];
+		cache->freeLists[sizeClassIndex] = block;
+		if (++cache->numBlocks[sizeClassIndex] >= PoolArenaMaxNumCachedBlocks)
+		{
+			// Hand a batch back so that blocks freed on another thread than they were allocated on do not pile up.
+			FreeBlock* first = (FreeBlock*)cache->freeLists[sizeClassIndex];
+			FreeBlock* last = first;
+			for (uint32 i = 1; i < PoolArenaCacheBatchSize; i++)
+			{
+				last = last->next;
+			}
+			cache->freeLists[sizeClassIndex] = last->next;
+			cache->numBlocks[sizeClassIndex] -= PoolArenaCacheBatchSize;
+			FreeToSizeClass(sizeClassIndex, first, last);
+		}
+	}
+
+	void PoolArena::Reset()
+	{
+		generation.store(gPoolArenaNextGeneration.fetch_add(1, std::memory_order_relaxed), std::memory_order_relaxed);
+		for (SizeClass& sizeClass : sizeClasses)
+		{
+			sizeClass.freeList = nullptr;
+			sizeClass.slabCursor = nullptr;
+			sizeClass.slabEnd = nullptr;
+		}
+		while (slabs)
+		{
+			SlabHeader* next = slabs->next;
+			slabs->next = freeSlabs;
+			freeSlabs = slabs;
+			slabs = next;
+		}
+		MemoryTrackArenaReset(this);
+	}
+
+	PoolArena* GetDefaultPoolArena()
+	{
+		static PoolArena defaultPoolArena("DefaultPoolArena");
+		return &defaultPoolArena;
+	}
+}
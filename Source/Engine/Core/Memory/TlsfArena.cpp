@@ -0,0 +1,364 @@
+module;
+
+#include "CoreCommon.h"
+
+#include <bit>
+#include <mutex>
+
+module HorizonEngine.Core.Memory;
+
+namespace HE
+{
+	/**
+	 * Every block starts with a header, the payload follows. The size is a multiple of TlsfAlignment, which leaves the low
+	 * bits for flags. Free blocks keep their free list links in the payload. Each pool ends with a sentinel block of size 0,
+	 * so walking or merging with the next block never leaves the pool.
+	 */
+	struct TlsfArena::Block
+	{
+		Block* prevPhysical;
+		uint64 sizeAndFlags;
+		Block* nextFree;
+		Block* prevFree;
+	};
+
+	static constexpr uint64 TlsfAlignment = 16;
+	static constexpr uint64 TlsfBlockHeaderSize = 16;
+	static constexpr uint64 TlsfMinBlockSize = 16;
+	static constexpr uint64 TlsfSmallBlockSize = 1ull << TlsfArena::FirstLevelIndexShift;
+	static constexpr uint64 TlsfMaxBlockSize = 1ull << (TlsfArena::FirstLevelIndexMax - 1);
+	static constexpr uint64 TlsfBlockFree = 0x1;
+	static constexpr uint64 TlsfBlockLast = 0x2;
+	static constexpr uint64 TlsfBlockFlags = TlsfBlockFree | TlsfBlockLast;
+
+	template<typename Block>
+	FORCEINLINE static uint64 GetTlsfBlockSize(const Block* block)
+	{
+		return block->sizeAndFlags & ~TlsfBlockFlags;
+	}
+
+	template<typename Block>
+	FORCEINLINE static void SetTlsfBlockSize(Block* block, uint64 size)
+	{
+		block->sizeAndFlags = size | (block->sizeAndFlags & TlsfBlockFlags);
+	}
+
+	template<typename Block>
+	FORCEINLINE static bool IsTlsfBlockFree(const Block* block)
+	{
+		return block->sizeAndFlags & TlsfBlockFree;
+	}
+
+	template<typename Block>
+	FORCEINLINE static void SetTlsfBlockFree(Block* block, bool free)
+	{
+		block->sizeAndFlags = free ? (block->sizeAndFlags | TlsfBlockFree) : (block->sizeAndFlags & ~TlsfBlockFree);
+	}
+
+	template<typename Block>
+	FORCEINLINE static Block* GetNextTlsfBlock(Block* block)
+	{
+		return (Block*)((uint8*)block + TlsfBlockHeaderSize + GetTlsfBlockSize(block));
+	}
+
+	template<typename Block>
+	FORCEINLINE static void* GetTlsfBlockPayload(Block* block)
+	{
+		return (uint8*)block + TlsfBlockHeaderSize;
+	}
+
+	template<typename Block>
+	FORCEINLINE static Block* GetTlsfBlockFromPayload(void* ptr)
+	{
+		return (Block*)((uint8*)ptr - TlsfBlockHeaderSize);
+	}
+
+	FORCEINLINE static uint64 AlignTlsfSize(uint64 size, uint64 alignment)
+	{
+		return (size + alignment - 1) & ~(alignment - 1);
+	}
+
+	/** Lists of the first level hold sizes in [2^fl, 2^(fl+1)), split linearly into SecondLevelIndexCount lists. */
+	static void MapTlsfSize(uint64 size, uint32& outFirstLevelIndex, uint32& outSecondLevelIndex)
+	{
+		if (size < TlsfSmallBlockSize)
+		{
+			outFirstLevelIndex = 0;
+			outSecondLevelIndex = (uint32)(size / (TlsfSmallBlockSize / TlsfArena::SecondLevelIndexCount));
+		}
+		else
+		{
+			const uint32 mostSignificantBit = 63 - (uint32)std::countl_zero(size);
+			outSecondLevelIndex = (uint32)(size >> (mostSignificantBit - TlsfArena::SecondLevelIndexCountLog2)) ^ TlsfArena::SecondLevelIndexCount;
+			outFirstLevelIndex = mostSignificantBit - (TlsfArena::FirstLevelIndexShift - 1);
+		}
+	}
+
+	TlsfArena::TlsfArena(const char* name, uint64 poolSize)
+		: name(name)
+		, poolSize(AlignTlsfSize(poolSize, TlsfAlignment))
+	{
+		ASSERT(poolSize >= TlsfMinBlockSize && poolSize <= TlsfMaxBlockSize);
+		AddPool(this->poolSize);
+	}
+
+	TlsfArena::~TlsfArena()
+	{
+		for (void* pool : pools)
+		{
+			_aligned_free(pool);
+		}
+	}
+
+	TlsfArena::Block* TlsfArena::AddPool(uint64 size)
+	{
+		void* pool = _aligned_malloc(size + 2 * TlsfBlockHeaderSize, TlsfAlignment);
+		if (!pool)
+		{
+			return nullptr;
+		}
+		pools.push_back(pool);
+
+		Block* block = (Block*)pool;
+		block->prevPhysical = nullptr;
+		block->sizeAndFlags = size | TlsfBlockFree;
+
+		Block* sentinel = GetNextTlsfBlock(block);
+		sentinel->prevPhysical = block;
+		sentinel->sizeAndFlags = TlsfBlockLast;
+
+		InsertFreeBlock(block);
+		return block;
+	}
+
+	void TlsfArena::InsertFreeBlock(Block* block)
+	{
+		uint32 firstLevelIndex, secondLevelIndex;
+		MapTlsfSize(GetTlsfBlockSize(block), firstLevelIndex, secondLevelIndex);
+		Block*& head = freeLists[firstLevelIndex][secondLevelIndex];
+		block->prevFree = nullptr;
+		block->nextFree = head;
+		if (head)
+		{
+			head->prevFree = block;
+		}
+		head = block;
+		firstLevelBitmap |= 1u << firstLevelIndex;
+		secondLevelBitmaps[firstLevelIndex] |= 1u << secondLevelIndex;
+	}
+
+	void TlsfArena::RemoveFreeBlock(Block* block)
+	{
+		uint32 firstLevelIndex, secondLevelIndex;
+		MapTlsfSize(GetTlsfBlockSize(block), firstLevelIndex, secondLevelIndex);
+		if (block->prevFree)
+		{
+			block->prevFree->nextFree = block->nextFree;
+		}
+		if (block->nextFree)
+		{
+			block->nextFree->prevFree = block->prevFree;
+		}
+		Block*& head = freeLists[firstLevelIndex][secondLevelIndex];
+		if (head == block)
+		{
+			head = block->nextFree;
+			if (!head)
+			{
+				secondLevelBitmaps[firstLevelIndex] &= ~(1u << secondLevelIndex);
+				if (!secondLevelBitmaps[firstLevelIndex])
+				{
+					firstLevelBitmap &= ~(1u << firstLevelIndex);
+				}
+			}
+		}
+	}
+
+	TlsfArena::Block* TlsfArena::FindFreeBlock(uint64 size)
+	{
+		// Round up to the next list boundary, so that any block of the list found fits.
+		uint64 roundedSize = size;
+		if (size >= TlsfSmallBlockSize)
+		{
+			roundedSize += (1ull << (63 - std::countl_zero(size) - SecondLevelIndexCountLog2)) - 1;
+		}
+		uint32 firstLevelIndex, secondLevelIndex;
+		MapTlsfSize(roundedSize, firstLevelIndex, secondLevelIndex);
+		if (firstLevelIndex >= FirstLevelIndexCount)
+		{
+			return nullptr;
+		}
+
+		uint32 secondLevelBitmap = secondLevelBitmaps[firstLevelIndex] & (~0u << secondLevelIndex);
+		if (!secondLevelBitmap)
+		{
+			const uint32 firstLevelBitmapAbove = (firstLevelIndex + 1 < 32) ? (firstLevelBitmap & (~0u << (firstLevelIndex + 1))) : 0;
+			if (!firstLevelBitmapAbove)
+			{
+				return nullptr;
+			}
+			firstLevelIndex = (uint32)std::countr_zero(firstLevelBitmapAbove);
+			secondLevelBitmap = secondLevelBitmaps[firstLevelIndex];
+		}
+		secondLevelIndex = (uint32)std::countr_zero(secondLevelBitmap);
+
+		Block* block = freeLists[firstLevelIndex][secondLevelIndex];
+		ASSERT(block && GetTlsfBlockSize(block) >= size);
+		RemoveFreeBlock(block);
+		return block;
+	}
+
+	TlsfArena::Block* TlsfArena::SplitBlock(Block* block, uint64 size)
+	{
+		const uint64 blockSize = GetTlsfBlockSize(block);
+		if (blockSize < size + TlsfBlockHeaderSize + TlsfMinBlockSize)
+		{
+			return nullptr;
+		}
+		Block* remaining = (Block*)((uint8*)GetTlsfBlockPayload(block) + size);
+		remaining->prevPhysical = block;
+		remaining->sizeAndFlags = (blockSize - size - TlsfBlockHeaderSize) | TlsfBlockFree;
+		SetTlsfBlockSize(block, size);
+		GetNextTlsfBlock(remaining)->prevPhysical = remaining;
+		if (IsTlsfBlockFree(GetNextTlsfBlock(remaining)))
+		{
+			MergeWithNext(remaining);
+		}
+		InsertFreeBlock(remaining);
+		return remaining;
+	}
+
+	TlsfArena::Block* TlsfArena::MergeWithNext(Block* block)
+	{
+		Block* next = GetNextTlsfBlock(block);
+		ASSERT(IsTlsfBlockFree(next));
+		RemoveFreeBlock(next);
+		SetTlsfBlockSize(block, GetTlsfBlockSize(block) + TlsfBlockHeaderSize + GetTlsfBlockSize(next));
+		GetNextTlsfBlock(block)->prevPhysical = block;
+		return block;
+	}
+
+	void* TlsfArena::Alloc(uint64 size, uint64 alignment)
+	{
+		ASSERT(alignment && !(alignment & (alignment - 1)));
+		const uint64 blockSize = AlignTlsfSize(size > TlsfMinBlockSize ? size : TlsfMinBlockSize, TlsfAlignment);
+		// Larger alignments need room in front of the payload for a free block that the aligned block is split from.
+		const uint64 searchSize = (alignment > TlsfAlignment) ? blockSize + alignment + TlsfBlockHeaderSize + TlsfMinBlockSize : blockSize;
+		if (searchSize > TlsfMaxBlockSize)
+		{
+			return nullptr;
+		}
+
+		std::lock_guard<std::mutex> lock(mutex);
+		Block* block = FindFreeBlock(searchSize);
+		if (!block)
+		{
+			// Large enough for the search to succeed after rounding up to the next list boundary.
+			const uint64 newPoolSize = AlignTlsfSize(2 * searchSize, TlsfAlignment);
+			if (!AddPool(newPoolSize > poolSize ? newPoolSize : poolSize) || !(block = FindFreeBlock(searchSize)))
+			{
+				return nullptr;
+			}
+		}
+		SetTlsfBlockFree(block, false);
+
+		if (alignment > TlsfAlignment)
+		{
+			const uint64 payload = (uint64)GetTlsfBlockPayload(block);
+			uint64 alignedPayload = AlignTlsfSize(payload, alignment);
+			if (alignedPayload != payload)
+			{
+				if (alignedPayload - payload < TlsfBlockHeaderSize + TlsfMinBlockSize)
+				{
+					alignedPayload = AlignTlsfSize(payload + TlsfBlockHeaderSize + TlsfMinBlockSize, alignment);
+				}
+				// The leading part becomes a free block. Its previous block is in use, free blocks never neighbor each other.
+				const uint64 gap = alignedPayload - payload;
+				Block* alignedBlock = GetTlsfBlockFromPayload<Block>((void*)alignedPayload);
+				alignedBlock->prevPhysical = block;
+				alignedBlock->sizeAndFlags = GetTlsfBlockSize(block) - gap;
+				GetNextTlsfBlock(alignedBlock)->prevPhysical = alignedBlock;
+				SetTlsfBlockSize(block, gap - TlsfBlockHeaderSize);
+				SetTlsfBlockFree(block, true);
+				InsertFreeBlock(block);
+				block = alignedBlock;
+			}
+		}
+
+		SplitBlock(block, blockSize);
+		return GetTlsfBlockPayload(block);
+	}
+
+	void TlsfArena::Free(void* ptr, uint64 size)
+	{
+		if (!ptr)
+		{
+			return;
+		}
+		std::lock_guard<std::mutex> lock(mutex);
+		Block* block = GetTlsfBlockFromPayload<Block>(ptr);
+		ASSERT(!IsTlsfBlockFree(block));
+		SetTlsfBlockFree(block, true);
+		Block* prev = block->prevPhysical;
+		if (prev && IsTlsfBlockFree(prev))
+		{
+			RemoveFreeBlock(prev);
+			SetTlsfBlockSize(prev, GetTlsfBlockSize(prev) + TlsfBlockHeaderSize + GetTlsfBlockSize(block));
+			GetNextTlsfBlock(prev)->prevPhysical = prev;
+			block = prev;
+		}
+		if (IsTlsfBlockFree(GetNextTlsfBlock(block)))
+		{
+			MergeWithNext(block);
+		}
+		InsertFreeBlock(block);
+	}
+
+	bool TlsfArena::TryResize(void* ptr, uint64 oldSize, uint64 newSize)
+	{
+		const uint64 blockSize = AlignTlsfSize(newSize > TlsfMinBlockSize ? newSize : TlsfMinBlockSize, TlsfAlignment);
+		std::lock_guard<std::mutex> lock(mutex);
+		Block* block = GetTlsfBlockFromPayload<Block>(ptr);
+		ASSERT(!IsTlsfBlockFree(block));
+		if (blockSize > GetTlsfBlockSize(block))
+		{
+			Block* next = GetNextTlsfBlock(block);
+			if (!IsTlsfBlockFree(next) || GetTlsfBlockSize(block) + TlsfBlockHeaderSize + GetTlsfBlockSize(next) < blockSize)
+			{
+				return false;
+			}
+			MergeWithNext(block);
+		}
+		SplitBlock(block, blockSize);
+		return true;
+	}
+
+	TlsfArenaStats TlsfArena::GetStats()
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		TlsfArenaStats stats = {};
+		stats.numPools = (uint32)pools.size();
+		for (void* pool : pools)
+		{
+			for (Block* block = (Block*)pool; !(block->sizeAndFlags & TlsfBlockLast); block = GetNextTlsfBlock(block))
+			{
+				const uint64 blockSize = GetTlsfBlockSize(block);
+				stats.reservedBytes += TlsfBlockHeaderSize + blockSize;
+				if (IsTlsfBlockFree(block))
+				{
+					stats.freeBytes += blockSize;
+					stats.largestFreeBlock = (blockSize > stats.largestFreeBlock) ? blockSize : stats.largestFreeBlock;
+					stats.numFreeBlocks++;
+				}
+				else
+				{
+					stats.usedBytes += blockSize;
+					stats.numUsedBlocks++;
+				}
+			}
+			stats.reservedBytes += TlsfBlockHeaderSize;
+		}
+		stats.fragmentation = stats.freeBytes ? 1.0f - (float)stats.largestFreeBlock / (float)stats.freeBytes : 0.0f;
+		return stats;
+	}
+}
@@ -0,0 +1,142 @@
+module;
+
+#include "CoreCommon.h"
+
+#if HE_PLATFORM_WINDOWS
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+module HorizonEngine.Core.Memory;
+
+import HorizonEngine.Core.Math;
+import HorizonEngine.Core.Logging;
+
+namespace HE
+{
+	static uint64 GetVirtualMemoryPageSize()
+	{
+#if HE_PLATFORM_WINDOWS
+		SYSTEM_INFO si;
+		GetSystemInfo(&si);
+		return si.dwPageSize;
+#else
+		return (uint64)sysconf(_SC_PAGESIZE);
+#endif
+	}
+
+	static uint64 AlignVirtualMemorySize(uint64 size, uint64 alignment)
+	{
+		return (size + alignment - 1) / alignment * alignment;
+	}
+
+	VirtualLinearArena::VirtualLinearArena(const char* name, uint64 reserveSize, uint64 commitSize)
+		: name(name)
+	{
+		this->commitSize = AlignVirtualMemorySize(Math::Max(commitSize, (uint64)1), GetVirtualMemoryPageSize());
+		reserved = AlignVirtualMemorySize(reserveSize, this->commitSize);
+#if HE_PLATFORM_WINDOWS
+		begin = (uint8*)VirtualAlloc(NULL, reserved, MEM_RESERVE, PAGE_NOACCESS);
+#else
+		void* ptr = mmap(nullptr, reserved, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+		begin = (ptr != MAP_FAILED) ? (uint8*)ptr : nullptr;
+#endif
+		ASSERT(begin);
+	}
+
+	VirtualLinearArena::~VirtualLinearArena()
+	{
+		if (begin)
+		{
+#if HE_PLATFORM_WINDOWS
+			VirtualFree(begin, 0, MEM_RELEASE);
+#else
+			munmap(begin, reserved);
+#endif
+		}
+	}
+
+	bool VirtualLinearArena::Commit(uint64 size)
+	{
+		const uint64 newCommitted = Math::Min(AlignVirtualMemorySize(size, commitSize), reserved);
+#if HE_PLATFORM_WINDOWS
+		const bool success = VirtualAlloc(begin + committed, newCommitted - committed, MEM_COMMIT, PAGE_READWRITE) != NULL;
+#else
+		const bool success = mprotect(begin + committed, newCommitted - committed, PROT_READ | PROT_WRITE) == 0;
+#endif
+		if (success)
+		{
+			committed = newCommitted;
+		}
+		return success;
+	}
+
+	void* VirtualLinearArena::Alloc(uint64 size, uint64 alignment)
+	{
+		ASSERT(alignment && !(alignment & alignment - 1));
+		const uint64 offset = (uint64(begin + used) + alignment - 1 & ~(alignment - 1)) - uint64(begin);
+		const uint64 end = offset + size;
+		if (end > reserved)
+		{
+			HE_LOG_ERROR("Virtual linear arena {} is out of reserved memory, {} of {} bytes used, allocating {} bytes.", name ? name : "", used, reserved, size);
+			ASSERT(false && "Virtual linear arena out of reserved memory.");
+			return nullptr;
+		}
+		if (end > committed && !Commit(end))
+		{
+			HE_LOG_ERROR("Virtual linear arena {} failed to commit {} bytes.", name ? name : "", end);
+			return nullptr;
+		}
+		used = end;
+		return begin + offset;
+	}
+
+	bool VirtualLinearArena::TryResize(void* ptr, uint64 oldSize, uint64 newSize)
+	{
+		const uint64 offset = (uint8*)ptr - begin;
+		const uint64 end = offset + newSize;
+		if (offset + oldSize != used || end > reserved)
+		{
+			return false;
+		}
+		if (end > committed && !Commit(end))
+		{
+			return false;
+		}
+		used = end;
+		return true;
+	}
+
+	void VirtualLinearArena::RewindTo(uint64 marker)
+	{
+		ASSERT(marker <= used);
+		highWaterMark = GetHighWaterMark();
+		used = marker;
+		MemoryTrackArenaRewind(this, begin + marker);
+	}
+
+	void VirtualLinearArena::Reset(bool decommit)
+	{
+		highWaterMark = GetHighWaterMark();
+		used = 0;
+		if (decommit)
+		{
+			const uint64 keep = Math::Min(AlignVirtualMemorySize(highWaterMark, commitSize), committed);
+			if (keep < committed)
+			{
+#if HE_PLATFORM_WINDOWS
+				VirtualFree(begin + keep, committed - keep, MEM_DECOMMIT);
+#else
+				madvise(begin + keep, committed - keep, MADV_DONTNEED);
+				mprotect(begin + keep, committed - keep, PROT_NONE);
+#endif
+				committed = keep;
+			}
+			highWaterMark = 0;
+		}
+		MemoryTrackArenaReset(this);
+	}
+}
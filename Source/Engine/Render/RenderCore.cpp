@@ -140,6 +140,26 @@ namespace HE
 	    backend->DestroyTexture(backend->instance, texture);
     }
 
+    void RenderBackendGetTextureMemoryRequirements(RenderBackend* backend, uint32 deviceMask, const RenderBackendTextureDesc* desc, RenderBackendMemoryRequirements* outRequirements)
+    {
+	    backend->GetTextureMemoryRequirements(backend->instance, deviceMask, desc, outRequirements);
+    }
+
+    RenderBackendHeapHandle RenderBackendCreateHeap(RenderBackend* backend, uint32 deviceMask, const RenderBackendHeapDesc* desc, const char* name)
+    {
+	    return backend->CreateHeap(backend->instance, deviceMask, desc, name);
+    }
+
+    void RenderBackendDestroyHeap(RenderBackend* backend, RenderBackendHeapHandle heap)
+    {
+	    backend->DestroyHeap(backend->instance, heap);
+    }
+
+    RenderBackendTextureHandle RenderBackendCreatePlacedTexture(RenderBackend* backend, RenderBackendHeapHandle heap, uint64 offset, const RenderBackendTextureDesc* desc, const char* name)
+    {
+	    return backend->CreatePlacedTexture(backend->instance, heap, offset, desc, name);
+    }
+
     RenderBackendTextureSRVHandle RenderBakendCreateTextureSRV(RenderBackend* backend, uint32 deviceMask, const RenderBackendTextureSRVDesc* desc, const char* name)
     {
 	    return backend->CreateTextureSRV(backend->instance, deviceMask, desc, name);
@@ -417,21 +437,35 @@ namespace HE
 	//	auto* command = AllocateCommand<RenderCommandResolveTimings>(timingQueryPool, regionStart, regionCount);
 	//}
 
-	void LoadShaderSourceFromFile(const char* filename, std::vector<uint8>& outData)
+	struct LoadShaderSourceJobData
+	{
+		const char* filename;
+		std::vector<uint8>* outData;
+	};
+
+	static void LoadShaderSourceJob(void* data)
 	{
-		std::ifstream file(filename, std::ios::ate | std::ios::binary);
+		LoadShaderSourceJobData* jobData = (LoadShaderSourceJobData*)data;
+		std::ifstream file(jobData->filename, std::ios::ate | std::ios::binary);
 		if (!file.is_open())
 		{
 			HE_LOG_ERROR("Failed to open shader source file.");
 			return;
 		}
 		size_t fileSize = (size_t)file.tellg();
-		outData.resize(fileSize);
+		jobData->outData->resize(fileSize);
 		file.seekg(0);
-		file.read((char*)outData.data(), fileSize);
+		file.read((char*)jobData->outData->data(), fileSize);
 		file.close();
 	}
 
+	void LoadShaderSourceFromFile(const char* filename, std::vector<uint8>& outData)
+	{
+		// From a job the read goes to an I/O thread, the worker runs other jobs until it is done.
+		LoadShaderSourceJobData jobData = { filename, &outData };
+		JobSystemRunBlocking(LoadShaderSourceJob, &jobData);
+	}
+
 	bool CompileShader(
 		ShaderCompiler* compiler,
 		std::vector<uint8> source,
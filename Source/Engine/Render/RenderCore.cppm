@@ -1,6 +1,7 @@
 module;
 
 #include <vector>
+#include <memory_resource>
 
 export module HorizonEngine.Render.Core;
 
@@ -211,6 +212,9 @@ export namespace HE
 	class RenderBackendShader;
 	using RenderBackendShaderHandle = RenderBackendHandleTyped<RenderBackendShader>;
 
+	class RenderBackendHeap;
+	using RenderBackendHeapHandle = RenderBackendHandleTyped<RenderBackendHeap>;
+
 	class RenderBackendTimingQueryHeap;
 	using RenderBackendTimingQueryHeapHandle = RenderBackendHandleTyped<RenderBackendTimingQueryHeap>;
 
@@ -679,6 +683,8 @@ export namespace HE
 		ResourceType type;
 		RenderBackendResourceState srcState;
 		RenderBackendResourceState dstState;
+		/** The texture is placed in heap memory that another resource used before, srcState must be Undefined. */
+		bool aliasing = false;
 		union
 		{
 			struct
@@ -842,7 +848,7 @@ export namespace HE
 		bool operator==(const RenderBackendTextureDesc& rhs) const
 		{
 			return width == rhs.width
-				&& height == height
+				&& height == rhs.height
 				&& depth == rhs.depth
 				&& mipLevels == rhs.mipLevels
 				&& arrayLayers == rhs.arrayLayers
@@ -864,6 +870,21 @@ export namespace HE
 		RenderTargetClearValue clearValue;
 	};
 
+	struct RenderBackendMemoryRequirements
+	{
+		uint64 size;
+		uint64 alignment;
+		/** Memory types the resource can be placed in, resources sharing a heap need a common one. */
+		uint32 memoryTypeBits;
+	};
+
+	struct RenderBackendHeapDesc
+	{
+		uint64 size;
+		uint64 alignment;
+		uint32 memoryTypeBits;
+	};
+
 	struct RenderBackendTextureSRVDesc
 	{
 		static RenderBackendTextureSRVDesc Create(RenderBackendTextureHandle texture)
@@ -1549,6 +1570,10 @@ export namespace HE
 		void (*DestroyBuffer)(void* instance, RenderBackendBufferHandle buffer);
 		RenderBackendTextureHandle(*CreateTexture)(void* instance, uint32 deviceMask, const RenderBackendTextureDesc* desc, const void* data, const char* name);
 		void (*DestroyTexture)(void* instance, RenderBackendTextureHandle texture);
+		void (*GetTextureMemoryRequirements)(void* instance, uint32 deviceMask, const RenderBackendTextureDesc* desc, RenderBackendMemoryRequirements* outRequirements);
+		RenderBackendHeapHandle(*CreateHeap)(void* instance, uint32 deviceMask, const RenderBackendHeapDesc* desc, const char* name);
+		void (*DestroyHeap)(void* instance, RenderBackendHeapHandle heap);
+		RenderBackendTextureHandle(*CreatePlacedTexture)(void* instance, RenderBackendHeapHandle heap, uint64 offset, const RenderBackendTextureDesc* desc, const char* name);
 		RenderBackendTextureSRVHandle(*CreateTextureSRV)(void* instance, uint32 deviceMask, const RenderBackendTextureSRVDesc* desc, const char* name);
 		int32(*GetTextureSRVDescriptorIndex)(void* instance, uint32 deviceMask, RenderBackendTextureHandle srv);
 		RenderBackendTextureUAVHandle(*CreateTextureUAV)(void* instance, uint32 deviceMask, const RenderBackendTextureUAVDesc* desc, const char* name);
@@ -1565,7 +1590,7 @@ export namespace HE
 		RenderBackendBufferHandle(*CreateRayTracingShaderBindingTable)(void* instance, uint32 deviceMask, const RenderBackendRayTracingShaderBindingTableDesc* desc, const char* name);
 	};
 
-	void RenderBackendTick(void* instance);
+	void RenderBackendTick(RenderBackend* backend);
 	void RenderBackendCreateRenderDevices(RenderBackend* backend, PhysicalDeviceID* physicalDeviceIDs, uint32 numDevices, uint32* outDeviceMasks);
 	void RenderBackendDestroyRenderDevices(RenderBackend* backend);
 	RenderBackendSwapChainHandle RenderBackendCreateSwapChain(RenderBackend* backend, uint32 deviceMask, uint64 windowHandle);
@@ -1579,6 +1604,11 @@ export namespace HE
 	void RenderBackendDestroyBuffer(RenderBackend* backend, RenderBackendBufferHandle buffer);
 	RenderBackendTextureHandle RenderBackendCreateTexture(RenderBackend* backend, uint32 deviceMask, const RenderBackendTextureDesc* desc, const void* data, const char* name);
 	void RenderBackendDestroyTexture(RenderBackend* backend, RenderBackendTextureHandle texture);
+	void RenderBackendGetTextureMemoryRequirements(RenderBackend* backend, uint32 deviceMask, const RenderBackendTextureDesc* desc, RenderBackendMemoryRequirements* outRequirements);
+	RenderBackendHeapHandle RenderBackendCreateHeap(RenderBackend* backend, uint32 deviceMask, const RenderBackendHeapDesc* desc, const char* name);
+	void RenderBackendDestroyHeap(RenderBackend* backend, RenderBackendHeapHandle heap);
+	/** Creates a texture without memory of its own, bound to the heap at offset. Its contents are undefined when another resource used the memory. */
+	RenderBackendTextureHandle RenderBackendCreatePlacedTexture(RenderBackend* backend, RenderBackendHeapHandle heap, uint64 offset, const RenderBackendTextureDesc* desc, const char* name);
 	RenderBackendTextureSRVHandle RenderBakendCreateTextureSRV(RenderBackend* backend, uint32 deviceMask, const RenderBackendTextureSRVDesc* desc, const char* name);
 	int32 RenderBackendGetTextureSRVDescriptorIndex(RenderBackend* backend, uint32 deviceMask, RenderBackendTextureHandle srv);
 	RenderBackendTextureUAVHandle RenderBackendCreateTextureUAV(RenderBackend* backend, uint32 deviceMask, const RenderBackendTextureUAVDesc* desc, const char* name);
@@ -1596,16 +1626,26 @@ export namespace HE
 
 	struct RenderCommandContainer
 	{
+		RenderCommandContainer(std::pmr::memory_resource* resource = std::pmr::get_default_resource())
+			: types(resource), commands(resource) {}
 		uint32 numCommands = 0;
-		std::vector<RenderCommandType> types = {};
-		std::vector<void*> commands = {};
+		std::pmr::vector<RenderCommandType> types;
+		std::pmr::vector<void*> commands;
 	};
 
 	class RenderCommandListBase
 	{
 	public:
-		RenderCommandListBase(MemoryArena* arena) : arena(arena) {}
-		virtual ~RenderCommandListBase() {}
+		/** The commands and the arrays recording them all come from arena. */
+		RenderCommandListBase(MemoryArena* arena) : arena(arena), arenaResource(arena), container(&arenaResource), commandSizes(&arenaResource) {}
+		/** Returns the commands to the arena, which is all a pool arena needs to recycle them for the next list. */
+		virtual ~RenderCommandListBase()
+		{
+			for (uint32 i = 0; i < container.numCommands; i++)
+			{
+				HE_ARENA_FREE(arena, container.commands[i], commandSizes[i]);
+			}
+		}
 		template <typename T>
 		FORCEINLINE T* AllocateCommand(RenderCommandType type, uint64 size = sizeof(T))
 		{
@@ -1613,6 +1653,7 @@ export namespace HE
 			container.types.push_back(type);
 			container.commands.push_back(data);
 			container.numCommands++;
+			commandSizes.push_back(size);
 			return (T*)data;
 		}
 		FORCEINLINE RenderCommandContainer* GetCommandContainer()
@@ -1626,7 +1667,9 @@ export namespace HE
 			return data;
 		}
 		MemoryArena* arena;
+		MemoryArenaResource arenaResource;
 		RenderCommandContainer container;
+		std::pmr::vector<uint64> commandSizes;
 	};
 
 	/**
@@ -1636,7 +1679,7 @@ export namespace HE
 	class RenderCommandList : public RenderCommandListBase
 	{
 	public:
-		RenderCommandList(MemoryArena* arena) : RenderCommandListBase(arena) {}
+		RenderCommandList(MemoryArena* arena = GetDefaultPoolArena()) : RenderCommandListBase(arena) {}
 		// Copy commands
 		void CopyTexture2D(RenderBackendTextureHandle srcTexture, const Offset2D& srcOffset, uint32 srcMipLevel, RenderBackendTextureHandle dstTexture, const Offset2D& dstOffset, uint32 dstMipLevel, const Extent2D extent);
 		void CopyBuffer(RenderBackendBufferHandle srcBuffer, uint64 srcOffset, RenderBackendBufferHandle dstBuffer, uint64 dstOffset, uint64 bytes);
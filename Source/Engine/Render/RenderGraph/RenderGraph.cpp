@@ -1,5 +1,6 @@
 module;
 
+#include <algorithm>
 #include <sstream>
 
 module HorizonEngine.Render.RenderGraph;
@@ -9,21 +10,19 @@ import HorizonEngine.Render.Core;
 
 namespace HE
 {
-	struct RenderBackendTransientResource
-	{
-
-	};
-
-	RenderGraph::RenderGraph(MemoryArena* arena)
+	RenderGraph::RenderGraph(MemoryArena* arena, MemoryArena* objectArena)
 		: blackboard(arena)
 		, arena(arena)
+		, objectArena(objectArena)
+		, arenaResource(arena)
+		, schedule(&arenaResource)
 	{
 
 	}
 
 	RenderGraph::~RenderGraph()
 	{
-
+		Clear();
 	}
 
 	std::string RenderGraph::Graphviz() const
@@ -51,7 +50,7 @@ namespace HE
 	{
 		uint32 index = (uint32)textures.size();
 		RenderGraphTextureHandle handle = RenderGraphTextureHandle(index, 0);
-		RenderGraphTexture* texture = AllocObject<RenderGraphTexture>(name, desc);
+		RenderGraphTexture* texture = AllocObject<RenderGraphTexture>(name, desc, &arenaResource);
 		textures.push_back(texture);
 		dag.RegisterNode(texture);
 		return handle;
@@ -61,7 +60,7 @@ namespace HE
 	{
 		uint32 index = (uint32)buffers.size();
 		RenderGraphBufferHandle handle = RenderGraphBufferHandle(index, 0);
-		RenderGraphBuffer* buffer = AllocObject<RenderGraphBuffer>(name, desc);
+		RenderGraphBuffer* buffer = AllocObject<RenderGraphBuffer>(name, desc, &arenaResource);
 		buffers.push_back(buffer);
 		dag.RegisterNode(buffer);
 		return handle;
@@ -98,8 +97,10 @@ namespace HE
 	{
 		uint32 index = (uint32)textures.size();
 		RenderGraphTextureHandle handle = RenderGraphTextureHandle(index, 0);
-		RenderGraphTexture* texture = AllocObject<RenderGraphTexture>(name, desc);
+		RenderGraphTexture* texture = AllocObject<RenderGraphTexture>(name, desc, &arenaResource);
 		texture->SetRenderBackendTexture(renderBackendTexture, initialState);
+		// Written for use outside of the graph.
+		texture->NeverCull();
 		textures.push_back(texture);
 		dag.RegisterNode(texture);
 		externalTextures.emplace(renderBackendTexture, handle);
@@ -110,30 +111,47 @@ namespace HE
 	{
 		uint32 index = (uint32)buffers.size();
 		RenderGraphBufferHandle handle = RenderGraphBufferHandle(index, 0);
-		RenderGraphBuffer* buffer = AllocObject<RenderGraphBuffer>(name, desc);
+		RenderGraphBuffer* buffer = AllocObject<RenderGraphBuffer>(name, desc, &arenaResource);
 		buffer->SetRenderBackendBuffer(renderBackendBuffer, initialState);
+		buffer->NeverCull();
 		buffers.push_back(buffer);
 		dag.RegisterNode(buffer);
 		externalBuffers.emplace(renderBackendBuffer, handle);
 		return handle;
 	}
 
-	void RenderGraph::ExportTextureDeferred(RenderGraphTextureHandle texture, RenderGraphPersistentTexture* outPersistentTexture)
+	void RenderGraph::ExportTextureDeferred(RenderGraphTextureHandle handle, RenderGraphPersistentTexture* outPersistentTexture)
 	{
+		RenderGraphTexture* texture = textures[handle.GetIndex()];
+		// Read outside of the graph, like an imported texture.
+		texture->NeverCull();
+		texture->exported = true;
+		exportedTextures.emplace_back(handle, outPersistentTexture);
 	}
 
-	bool RenderGraph::Compile()
+	void RenderGraph::CullPasses()
 	{
-		if (passes.empty())
+		// Nodes without references are culled: passes that write nothing anyone reads, textures nobody reads. Culling a
+		// texture releases its writers, culling a pass releases what it reads. Imported textures and NeverGetCulled passes
+		// have infinite references.
+		auto WritesTo = [](const RenderGraphNode* pass, const RenderGraphNode* resource)
 		{
-			return false;
+			return std::find(pass->outputs.begin(), pass->outputs.end(), resource) != pass->outputs.end();
+		};
+		// A pass that reads and writes the same resource would keep itself alive through it, only later readers count.
+		for (RenderGraphPass* pass : passes)
+		{
+			for (RenderGraphNode* input : pass->inputs)
+			{
+				if (WritesTo(pass, input))
+				{
+					input->ReleaseRef();
+				}
+			}
 		}
 
-		auto& nodes = dag.nodes;
-
-		// Push nodes with a 0 reference count on a stack.
-		std::vector<RenderGraphNode*> nodesToCull;
-		for (RenderGraphNode* node : nodes)
+		std::pmr::vector<RenderGraphNode*> nodesToCull(&arenaResource);
+		for (RenderGraphNode* node : dag.nodes)
 		{
 			if (node->GetRefCount() == 0)
 			{
@@ -147,25 +165,261 @@ namespace HE
 			nodesToCull.pop_back();
 			for (RenderGraphNode* input : node->inputs)
 			{
-				input->refCount--;
-				if (input->GetRefCount() == 0)
+				// Already released above.
+				if (node->type == RenderGraphNodeType::Pass && WritesTo(node, input))
+				{
+					continue;
+				}
+				if (input->ReleaseRef())
 				{
 					nodesToCull.push_back(input);
 				}
 			}
 		}
+	}
+
+	bool RenderGraph::Compile()
+	{
+		schedule.Clear();
+		if (passes.empty())
+		{
+			return false;
+		}
+
+		CullPasses();
+
+		// Passes declare their reads and writes when they are added, so every dependency goes from an earlier pass to a later
+		// one and the insertion order already is a topological order. The schedule is that order without the culled passes.
+		for (RenderGraphPass* pass : passes)
+		{
+			if (pass->IsCulled())
+			{
+				schedule.numCulledPasses++;
+				continue;
+			}
+			schedule.passes.push_back(pass);
+		}
+
+		for (RenderGraphPass* pass : schedule.passes)
+		{
+			for (const auto& state : pass->textureStates)
+			{
+				RenderGraphTexture* texture = state.texture;
+				if (!texture->firstPass)
+				{
+					texture->firstPass = pass;
+					schedule.textures.push_back(texture);
+				}
+				texture->lastPass = pass;
+			}
+			for (const auto& state : pass->bufferStates)
+			{
+				RenderGraphBuffer* buffer = state.buffer;
+				if (!buffer->firstPass)
+				{
+					buffer->firstPass = pass;
+					schedule.buffers.push_back(buffer);
+				}
+				buffer->lastPass = pass;
+			}
+		}
 
 		return true;
 	}
 
+	void RenderGraph::AllocateTransientTextures(RenderBackend* renderBackend)
+	{
+		struct TransientTexture
+		{
+			RenderGraphTexture* texture;
+			uint32 firstUse;
+			uint32 lastUse;
+			uint64 size;
+			uint64 alignment;
+			uint64 offset;
+		};
+
+		// Lifetimes in positions of the schedule.
+		const uint32 numNodes = (uint32)dag.nodes.size();
+		std::pmr::vector<uint32> firstUses(numNodes, ~0u, &arenaResource);
+		std::pmr::vector<uint32> lastUses(numNodes, 0, &arenaResource);
+		for (uint32 passIndex = 0; passIndex < (uint32)schedule.passes.size(); passIndex++)
+		{
+			for (const auto& state : schedule.passes[passIndex]->textureStates)
+			{
+				const uint32 index = state.texture->GetIndex();
+				firstUses[index] = Math::Min(firstUses[index], passIndex);
+				lastUses[index] = passIndex;
+			}
+		}
+		std::pmr::vector<TransientTexture> transientTextures(&arenaResource);
+		for (RenderGraphTexture* texture : schedule.textures)
+		{
+			if (texture->IsImported())
+			{
+				continue;
+			}
+			if (texture->exported)
+			{
+				// Has to outlive the frame, so it can't share memory with anything.
+				RenderBackendTextureHandle handle = gRenderGraphResourcePool->FindOrCreateTexture(renderBackend, &texture->GetDesc(), texture->GetName());
+				gRenderGraphResourcePool->ExportTexture(handle);
+				texture->SetRenderBackendTexture(handle, RenderBackendResourceState::Undefined);
+				continue;
+			}
+			const RenderBackendMemoryRequirements& memoryRequirements = gRenderGraphResourcePool->GetTextureMemoryRequirements(renderBackend, &texture->GetDesc());
+			transientTextures.push_back(TransientTexture{
+				.texture = texture,
+				.firstUse = firstUses[texture->GetIndex()],
+				.lastUse = lastUses[texture->GetIndex()],
+				.size = memoryRequirements.size,
+				.alignment = memoryRequirements.alignment,
+				.offset = 0,
+			});
+		}
+		std::stable_sort(transientTextures.begin(), transientTextures.end(), [](const TransientTexture& lhs, const TransientTexture& rhs) { return lhs.size > rhs.size; });
+
+		// Textures that can't share a memory type with the larger ones get memory of their own.
+		uint32 memoryTypeBits = ~0u;
+		uint64 heapSize = 0;
+		uint64 heapAlignment = 1;
+		std::pmr::vector<TransientTexture*> placedTextures(&arenaResource);
+		std::pmr::vector<std::pair<uint64, uint64>> occupiedRanges(&arenaResource);
+		for (TransientTexture& transientTexture : transientTextures)
+		{
+			const uint32 textureMemoryTypeBits = gRenderGraphResourcePool->GetTextureMemoryRequirements(renderBackend, &transientTexture.texture->GetDesc()).memoryTypeBits;
+			if ((memoryTypeBits & textureMemoryTypeBits) == 0)
+			{
+				RenderBackendTextureHandle handle = gRenderGraphResourcePool->FindOrCreateTexture(renderBackend, &transientTexture.texture->GetDesc(), transientTexture.texture->GetName());
+				transientTexture.texture->SetRenderBackendTexture(handle, RenderBackendResourceState::Undefined);
+				continue;
+			}
+			memoryTypeBits &= textureMemoryTypeBits;
+
+			// Lowest aligned gap between the memory of the placed textures alive at the same time.
+			occupiedRanges.clear();
+			for (const TransientTexture* placedTexture : placedTextures)
+			{
+				if (placedTexture->firstUse <= transientTexture.lastUse && transientTexture.firstUse <= placedTexture->lastUse)
+				{
+					occupiedRanges.emplace_back(placedTexture->offset, placedTexture->offset + placedTexture->size);
+				}
+			}
+			std::sort(occupiedRanges.begin(), occupiedRanges.end());
+			uint64 offset = 0;
+			for (const auto& [begin, end] : occupiedRanges)
+			{
+				if (offset + transientTexture.size <= begin)
+				{
+					break;
+				}
+				offset = Math::Max(offset, (end + transientTexture.alignment - 1) & ~(transientTexture.alignment - 1));
+			}
+			transientTexture.offset = offset;
+			heapSize = Math::Max(heapSize, offset + transientTexture.size);
+			heapAlignment = Math::Max(heapAlignment, transientTexture.alignment);
+			placedTextures.push_back(&transientTexture);
+		}
+		if (placedTextures.empty())
+		{
+			return;
+		}
+
+		gRenderGraphResourcePool->GetTransientHeap(renderBackend, heapSize, heapAlignment, memoryTypeBits);
+		for (TransientTexture* transientTexture : placedTextures)
+		{
+			// Other textures may have used the memory earlier in the frame or in the previous one.
+			for (const TransientTexture* other : placedTextures)
+			{
+				if (other != transientTexture
+					&& other->offset < transientTexture->offset + transientTexture->size
+					&& transientTexture->offset < other->offset + other->size)
+				{
+					transientTexture->texture->aliased = true;
+					break;
+				}
+			}
+			RenderBackendTextureHandle handle = gRenderGraphResourcePool->FindOrCreatePlacedTexture(renderBackend, transientTexture->offset, &transientTexture->texture->GetDesc(), transientTexture->texture->GetName());
+			transientTexture->texture->SetRenderBackendTexture(handle, RenderBackendResourceState::Undefined);
+		}
+	}
+
+	void RenderGraph::AddTextureBarriers(RenderGraphPass* pass, RenderGraphTexture* texture, RenderBackendResourceState state, const RenderGraphTextureSubresourceRange& range)
+	{
+		const RenderGraphTextureSubresourceLayout& layout = texture->subresourceLayout;
+		const uint32 baseMipLevel = range.baseMipLevel;
+		const uint32 baseArrayLayer = range.baseArrayLayer;
+		const uint32 endMipLevel = (range.numMipLevels == REMAINING_MIP_LEVELS) ? layout.numMipLevels : baseMipLevel + range.numMipLevels;
+		const uint32 endArrayLayer = (range.numArrayLayers == REMAINING_ARRAY_LAYERS) ? layout.numArrayLayers : baseArrayLayer + range.numArrayLayers;
+		ASSERT(endMipLevel <= layout.numMipLevels && endArrayLayer <= layout.numArrayLayers);
+
+		// Every barrier from here on is for this texture.
+		const uint32 firstBarrier = (uint32)pass->barriers.size();
+		for (uint32 mipLevel = baseMipLevel; mipLevel < endMipLevel; mipLevel++)
+		{
+			uint32 layer = baseArrayLayer;
+			while (layer < endArrayLayer)
+			{
+				const RenderBackendResourceState oldState = texture->subresourceStates[layout.GetSubresourceIndex(RenderGraphTextureSubresource(mipLevel, layer))];
+				uint32 endLayer = layer + 1;
+				while (endLayer < endArrayLayer && texture->subresourceStates[layout.GetSubresourceIndex(RenderGraphTextureSubresource(mipLevel, endLayer))] == oldState)
+				{
+					endLayer++;
+				}
+
+				// Unordered access in consecutive passes needs a barrier too, the earlier pass may have written the texture.
+				if (oldState != state || state == RenderBackendResourceState::UnorderedAccess)
+				{
+					bool merged = false;
+					for (uint32 i = firstBarrier; i < (uint32)pass->barriers.size(); i++)
+					{
+						RenderBackendTextureSubresourceRange& barrierRange = pass->barriers[i].textureRange;
+						if (pass->barriers[i].srcState == oldState
+							&& barrierRange.firstLevel + barrierRange.mipLevels == mipLevel
+							&& barrierRange.firstLayer == layer
+							&& barrierRange.arrayLayers == endLayer - layer)
+						{
+							barrierRange.mipLevels++;
+							merged = true;
+							break;
+						}
+					}
+					if (!merged)
+					{
+						RenderBackendBarrier barrier = RenderBackendBarrier(
+							texture->GetRenderBackendTexture(),
+							RenderBackendTextureSubresourceRange(mipLevel, 1, layer, endLayer - layer),
+							oldState,
+							state);
+						barrier.aliasing = texture->aliased && (oldState == RenderBackendResourceState::Undefined);
+						pass->barriers.push_back(barrier);
+					}
+				}
+
+				for (; layer < endLayer; layer++)
+				{
+					texture->subresourceStates[layout.GetSubresourceIndex(RenderGraphTextureSubresource(mipLevel, layer))] = state;
+				}
+			}
+		}
+	}
+
 	void RenderGraph::Clear()
 	{
+		schedule.Clear();
 		dag.Clear();
 		passes.clear();
 		textures.clear();
 		buffers.clear();
 		externalTextures.clear();
 		externalBuffers.clear();
+		exportedTextures.clear();
+		for (auto it = objects.rbegin(); it != objects.rend(); ++it)
+		{
+			it->destroy(it->ptr);
+			HE_ARENA_ALIGNED_FREE(objectArena, it->ptr, it->size, it->alignment);
+		}
+		objects.clear();
 	}
 
 	void RenderGraph::Execute(RenderContext* context)
@@ -176,47 +430,47 @@ namespace HE
 		//HE_LOG_INFO("{}", temp);
 
 		RenderBackend* renderBackend = context->renderBackend;
-		RenderCommandList* commandList = AllocObject<RenderCommandList>(arena);
-
-		for (auto& texture : textures)
+		// Outlives the graph until it is submitted, so it comes from the per-frame arena.
+		RenderCommandList* commandList = (RenderCommandList*)HE_ARENA_ALIGNED_ALLOC(arena, sizeof(RenderCommandList), alignof(RenderCommandList));
+		ASSERT(commandList);
+		commandList = new(commandList) RenderCommandList(arena);
+
+		// Resources only used by culled passes get no memory.
+		AllocateTransientTextures(renderBackend);
+		for (RenderGraphBuffer* buffer : schedule.buffers)
 		{
-			if (!texture->IsImported())
-				// if (!texture->IsCulled() && !texture->IsImported() && !texture->HasRenderBackendTexture())
+			if (!buffer->IsImported())
 			{
-				RenderBackendTextureHandle handle = gRenderGraphResourcePool->FindOrCreateTexture(renderBackend, &texture->GetDesc(), texture->GetName());
-				texture->SetRenderBackendTexture(handle, RenderBackendResourceState::Undefined);
+				RenderBackendBufferHandle handle = gRenderGraphResourcePool->FindOrCreateBuffer(renderBackend, &buffer->GetDesc(), buffer->GetName());
+				buffer->SetRenderBackendBuffer(handle, RenderBackendResourceState::Undefined);
 			}
 		}
 
-		for (auto& pass : passes)
+		for (RenderGraphPass* pass : schedule.passes)
 		{
-			/*if (pass->IsCulled())
+			for (const auto& state : pass->textureStates)
 			{
-				continue;
-			}*/
-			for (auto& state : pass->textureStates)
+				AddTextureBarriers(pass, state.texture, state.state, state.subresourceRange);
+			}
+			for (auto& state : pass->bufferStates)
 			{
-				RenderGraphTexture* texture = state.texture;
-				if (state.state != texture->tempState)
+				RenderGraphBuffer* buffer = state.buffer;
+				// Unordered access in consecutive passes needs a barrier too, the earlier pass may have written the buffer.
+				if (state.state != buffer->tempState || state.state == RenderBackendResourceState::UnorderedAccess)
 				{
 					RenderBackendBarrier barrier = RenderBackendBarrier(
-						texture->GetRenderBackendTexture(),
-						RenderBackendTextureSubresourceRange(0, REMAINING_MIP_LEVELS, 0, REMAINING_ARRAY_LAYERS),
-						texture->tempState,
+						buffer->GetRenderBackendBuffer(),
+						BufferSubresourceRange{ 0, buffer->GetDesc().size },
+						buffer->tempState,
 						state.state);
-					texture->tempState = state.state;
+					buffer->tempState = state.state;
 					pass->barriers.push_back(barrier);
 				}
 			}
 		}
 
-		for (auto& pass : passes)
+		for (RenderGraphPass* pass : schedule.passes)
 		{
-			/*if (pass->IsCulled())
-			{
-				continue;
-			}
-			*/
 			RenderGraphPassFlags flags = pass->GetFlags();
 			RenderGraphRegistry registry(this, pass);
 
@@ -265,6 +519,43 @@ namespace HE
 			// commandList.EndTimingQuery();
 		}
 
+		// An exported texture is imported with a single state, bring all of its subresources to the state of the first one.
+		std::pmr::vector<RenderBackendBarrier> exportBarriers(&arenaResource);
+		for (const auto& [handle, persistentTexture] : exportedTextures)
+		{
+			RenderGraphTexture* texture = textures[handle.GetIndex()];
+			if (!texture->IsImported() && !texture->firstPass)
+			{
+				// No pass that ran uses it, so it got no memory this frame.
+				*persistentTexture = {};
+				continue;
+			}
+			const RenderBackendResourceState state = texture->subresourceStates[0];
+			const RenderGraphTextureSubresourceLayout& layout = texture->subresourceLayout;
+			for (uint32 mipLevel = 0; mipLevel < layout.numMipLevels; mipLevel++)
+			{
+				for (uint32 layer = 0; layer < layout.numArrayLayers; layer++)
+				{
+					RenderBackendResourceState& subresourceState = texture->subresourceStates[layout.GetSubresourceIndex(RenderGraphTextureSubresource(mipLevel, layer))];
+					if (subresourceState != state)
+					{
+						exportBarriers.push_back(RenderBackendBarrier(texture->GetRenderBackendTexture(), RenderBackendTextureSubresourceRange(mipLevel, 1, layer, 1), subresourceState, state));
+						subresourceState = state;
+					}
+				}
+			}
+			*persistentTexture = {
+				.active = true,
+				.texture = texture->GetRenderBackendTexture(),
+				.desc = texture->GetDesc(),
+				.initialState = state,
+			};
+		}
+		if (!exportBarriers.empty())
+		{
+			commandList->Transitions(exportBarriers.data(), (uint32)exportBarriers.size());
+		}
+
 		context->commandLists.push_back(commandList);
 
 		Clear();
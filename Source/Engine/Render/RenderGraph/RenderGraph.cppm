@@ -3,6 +3,7 @@ module;
 #include <map>
 #include <vector>
 #include <functional>
+#include <memory_resource>
 
 export module HorizonEngine.Render.RenderGraph;
 
@@ -103,8 +104,8 @@ export namespace HE
 			return imported;
 		}
 	protected:
-		RenderGraphResource(const char* name, RenderGraphResourceType type)
-			: RenderGraphNode(name, RenderGraphNodeType::Resource)
+		RenderGraphResource(const char* name, RenderGraphResourceType type, std::pmr::memory_resource* resource)
+			: RenderGraphNode(name, RenderGraphNodeType::Resource, resource)
 			, type(type) {}
 		bool imported = false;
 		bool transient = false;
@@ -146,10 +147,11 @@ export namespace HE
 		}
 	private:
 		friend class RenderGraph;
-		RenderGraphTexture(const char* name, const RenderGraphTextureDesc& desc)
-			: RenderGraphResource(name, RenderGraphResourceType::Texture)
+		RenderGraphTexture(const char* name, const RenderGraphTextureDesc& desc, std::pmr::memory_resource* resource)
+			: RenderGraphResource(name, RenderGraphResourceType::Texture, resource)
 			, desc(desc)
 			, subresourceLayout(desc.mipLevels, desc.arrayLayers)
+			, subresourceStates(subresourceLayout.GetSubresourceCount(), RenderBackendResourceState::Undefined, resource)
 		{
 
 		}
@@ -159,10 +161,17 @@ export namespace HE
 			this->texture = texture;
 			this->initialState = initialState;
 			this->finalState = initialState;
+			// Barriers are tracked per subresource, the first one of each has to start from the state the texture comes in.
+			subresourceStates.assign(subresourceStates.size(), initialState);
 		}
 		const RenderGraphTextureDesc desc;
-		RenderBackendResourceState tempState = RenderBackendResourceState::Undefined;
+		/** Placed in heap memory that other textures of the graph use too, its first barriers are aliasing barriers. */
+		bool aliased = false;
+		/** Handed out of the graph with ExportTextureDeferred(), so it gets pooled memory of its own. */
+		bool exported = false;
 		RenderGraphTextureSubresourceLayout subresourceLayout;
+		/** State of every mip level and array layer while Execute() generates barriers, indexed through subresourceLayout. */
+		std::pmr::vector<RenderBackendResourceState> subresourceStates;
 		RenderBackendTextureHandle texture = RenderBackendTextureHandle::NullHandle;
 	};
 
@@ -292,16 +301,18 @@ export namespace HE
 		}
 	private:
 		friend class RenderGraph;
-		RenderGraphBuffer(const char* name, const RenderGraphBufferDesc& desc)
-			: RenderGraphResource(name, RenderGraphResourceType::Buffer), desc(desc) {}
+		RenderGraphBuffer(const char* name, const RenderGraphBufferDesc& desc, std::pmr::memory_resource* resource)
+			: RenderGraphResource(name, RenderGraphResourceType::Buffer, resource), desc(desc) {}
 		void SetRenderBackendBuffer(RenderBackendBufferHandle buffer, RenderBackendResourceState initialState)
 		{
 			this->imported = true;
 			this->buffer = buffer;
 			this->initialState = initialState;
 			this->finalState = initialState;
+			this->tempState = initialState;
 		}
 		const RenderGraphBufferDesc desc;
+		RenderBackendResourceState tempState = RenderBackendResourceState::Undefined;
 		RenderBackendBufferHandle buffer;
 	};
 
@@ -336,6 +347,8 @@ export namespace HE
 		RenderBackendTextureHandle texture;
 		RenderBackendTextureDesc desc;
 		RenderBackendResourceState initialState;
+		/** Exported by a graph, stays out of the pool until it is handed back with RenderGraphResourcePool::CacheTexture(). */
+		bool exported = false;
 	};
 
 	struct RenderGraphPersistentBuffer
@@ -346,15 +359,45 @@ export namespace HE
 		RenderBackendResourceState initialState;
 	};
 
+	struct RenderGraphPlacedTexture
+	{
+		bool active;
+		RenderBackendTextureHandle texture;
+		RenderBackendTextureDesc desc;
+		uint64 offset;
+		/** Frame counter of the pool when the texture was last handed out. */
+		uint32 lastUsedFrame;
+	};
+
 	class RenderGraphResourcePool
 	{
 	public:
-		void Tick();
+		/** Placed textures that no graph has used for this many frames are destroyed, their offset or desc went out of use. */
+		static constexpr uint32 MaxNumUnusedPlacedTextureFrames = 8;
+		/** Hands out the textures of the last frame again, call once the graph using them has been submitted. */
+		void Tick(RenderBackend* backend);
+		/** Hands a texture exported by an earlier graph back to the pool, it may be reused after the current frame. */
 		void CacheTexture(const RenderGraphPersistentTexture& texture);
+		/** Keeps a pooled texture from being handed out again until it is passed to CacheTexture(). */
+		void ExportTexture(RenderBackendTextureHandle texture);
 		RenderBackendTextureHandle FindOrCreateTexture(RenderBackend* backend, const RenderBackendTextureDesc* desc, const char* name);
+		RenderBackendBufferHandle FindOrCreateBuffer(RenderBackend* backend, const RenderBackendBufferDesc* desc, const char* name);
+		/** Queried once per desc, the backend creates a texture to find out. */
+		const RenderBackendMemoryRequirements& GetTextureMemoryRequirements(RenderBackend* backend, const RenderBackendTextureDesc* desc);
+		/**
+		 * Returns the heap that transient textures are placed in, grown to hold at least size bytes of a memory type in
+		 * memoryTypeBits. Growing it destroys the textures placed in the old heap.
+		 */
+		RenderBackendHeapHandle GetTransientHeap(RenderBackend* backend, uint64 size, uint64 alignment, uint32 memoryTypeBits);
+		RenderBackendTextureHandle FindOrCreatePlacedTexture(RenderBackend* backend, uint64 offset, const RenderBackendTextureDesc* desc, const char* name);
 	private:
 		friend class RenderGraph;
 		std::pmr::vector<RenderGraphPersistentTexture> allocatedTextures;
+		std::pmr::vector<RenderGraphPersistentBuffer> allocatedBuffers;
+		std::pmr::vector<std::pair<RenderBackendTextureDesc, RenderBackendMemoryRequirements>> textureMemoryRequirements;
+		RenderBackendHeapHandle transientHeap = RenderBackendHeapHandle::NullHandle;
+		RenderBackendHeapDesc transientHeapDesc = {};
+		std::pmr::vector<RenderGraphPlacedTexture> placedTextures;
 		uint32 frameCounter = 0;
 	};
 
@@ -366,6 +409,10 @@ export namespace HE
 		RenderGraphBuilder(RenderGraph* renderGraph, RenderGraphPass* pass)
 			: renderGraph(renderGraph), pass(pass) {}
 		~RenderGraphBuilder() = default;
+		/**
+		 * Creates a resource for the passes set up from here on, like RenderGraph::CreateTexture() and CreateBuffer() do.
+		 * Its memory is only reserved from its first to its last use in the compiled schedule.
+		 */
 		RenderGraphTextureHandle CreateTransientTexture(const RenderGraphTextureDesc& desc, const char* name);
 		RenderGraphBufferHandle CreateTransientBuffer(const RenderGraphBufferDesc& desc, const char* name);
 		RenderGraphTextureHandle ReadTexture(RenderGraphTextureHandle handle, RenderBackendResourceState initalState, const RenderGraphTextureSubresourceRange& range = RenderGraphTextureSubresourceRange::WholeRange);
@@ -429,9 +476,12 @@ export namespace HE
 		friend class RenderGraph;
 		friend class RenderGraphBuilder;
 
-		RenderGraphPass(const char* name, RenderGraphPassFlags flags)
-			: RenderGraphNode(name, RenderGraphNodeType::Pass)
-			, flags(flags) {}
+		RenderGraphPass(const char* name, RenderGraphPassFlags flags, std::pmr::memory_resource* resource)
+			: RenderGraphNode(name, RenderGraphNodeType::Pass, resource)
+			, flags(flags)
+			, textureStates(resource)
+			, bufferStates(resource)
+			, barriers(resource) {}
 
 		RenderGraphPassFlags flags;
 
@@ -452,10 +502,10 @@ export namespace HE
 			RenderBackendResourceState state;
 		};
 
-		std::vector<TextureState> textureStates;
-		std::vector<BufferState> bufferStates;
+		std::pmr::vector<TextureState> textureStates;
+		std::pmr::vector<BufferState> bufferStates;
 
-		std::vector<RenderBackendBarrier> barriers;
+		std::pmr::vector<RenderBackendBarrier> barriers;
 
 		struct ColorRenderTarget
 		{
@@ -484,7 +534,7 @@ export namespace HE
 		~RenderGraphLambdaPass() = default;
 	private:
 		friend class RenderGraph;
-		RenderGraphLambdaPass(const char* name, RenderGraphPassFlags flags) : RenderGraphPass(name, flags) {}
+		RenderGraphLambdaPass(const char* name, RenderGraphPassFlags flags, std::pmr::memory_resource* resource) : RenderGraphPass(name, flags, resource) {}
 		void SetExecuteCallback(Lambda&& execute) { executeCallback = std::move(execute); }
 		void Execute(RenderGraphRegistry& registry, RenderCommandList& commandList) override
 		{
@@ -494,10 +544,35 @@ export namespace HE
 		Lambda executeCallback;
 	};
 
+	/** Result of RenderGraph::Compile(), rebuilt every frame in the frame arena. */
+	struct RenderGraphSchedule
+	{
+		RenderGraphSchedule(std::pmr::memory_resource* resource)
+			: passes(resource), textures(resource), buffers(resource) {}
+		void Clear()
+		{
+			passes.clear();
+			textures.clear();
+			buffers.clear();
+			numCulledPasses = 0;
+		}
+		/** Passes that contribute to imported textures or have the NeverGetCulled flag, in the order they were added. */
+		std::pmr::vector<RenderGraphPass*> passes;
+		/** Textures used by the scheduled passes in order of first use, with firstPass and lastPass set. */
+		std::pmr::vector<RenderGraphTexture*> textures;
+		/** Buffers used by the scheduled passes in order of first use, with firstPass and lastPass set. */
+		std::pmr::vector<RenderGraphBuffer*> buffers;
+		uint32 numCulledPasses = 0;
+	};
+
 	class RenderGraph
 	{
 	public:
-		RenderGraph(MemoryArena* arena);
+		/**
+		 * Per-frame data (blackboard, command lists, the edge and state arrays of passes and resources) comes from arena,
+		 * passes and resources themselves from objectArena until Clear().
+		 */
+		RenderGraph(MemoryArena* arena, MemoryArena* objectArena = GetDefaultPoolArena());
 		RenderGraph(const RenderGraph& other) = delete;
 		virtual ~RenderGraph();
 
@@ -515,12 +590,22 @@ export namespace HE
 		 */
 		std::string Graphviz() const;
 
+		/** Valid from Compile() in Execute() until Clear(). */
+		const RenderGraphSchedule& GetSchedule() const
+		{
+			return schedule;
+		}
+
 		RenderGraphTextureHandle CreateTexture(const RenderGraphTextureDesc& desc, const char* name);
 		RenderGraphBufferHandle CreateBuffer(const RenderGraphBufferDesc& desc, const char* name);
 		//RenderGraphTextureSRVHandle CreateTextureSRV(RenderGraphTextureHandle texture, const RenderGraphTextureSRVDesc& desc);
 		//RenderGraphTextureUAVHandle CreateTextureUAV(RenderGraphTextureHandle texture, uint32 mipLevel);
 		RenderGraphTextureHandle ImportExternalTexture(RenderBackendTextureHandle renderBackendTexture, const RenderBackendTextureDesc& desc, RenderBackendResourceState initialState, char const* name);
 		RenderGraphBufferHandle ImportExternalBuffer(RenderBackendBufferHandle renderBackendBuffer, const RenderBackendBufferDesc& desc, RenderBackendResourceState initialState, char const* name);
+		/**
+		 * The texture is never culled and keeps its contents after the graph. outPersistentTexture is filled in by Execute(),
+		 * import it into a later graph and pass it to RenderGraphResourcePool::CacheTexture() once that graph is done with it.
+		 */
 		void ExportTextureDeferred(RenderGraphTextureHandle texture, RenderGraphPersistentTexture* outPersistentTexture);
 
 		RenderGraphBlackboard blackboard;
@@ -529,7 +614,25 @@ export namespace HE
 		friend class RenderGraphBuilder;
 		friend class RenderGraphRegistry;
 	
+		/**
+		 * Culls the passes that don't contribute to imported or exported resources or passes with the NeverGetCulled flag,
+		 * together with the resources only they use. The remaining passes keep the order of AddPass().
+		 */
 		bool Compile();
+		void CullPasses();
+
+		/**
+		 * Gives the textures of the schedule that aren't imported their memory. Textures whose first to last use don't overlap
+		 * in the schedule share memory: largest first, each is placed at the lowest offset of the transient heap that no texture
+		 * in use at the same time occupies.
+		 */
+		void AllocateTransientTextures(RenderBackend* renderBackend);
+
+		/**
+		 * Adds the barriers that bring range of texture to state before pass. Consecutive array layers in the same state form
+		 * one barrier, which grows over the following mip levels as long as they have the same layers in that state.
+		 */
+		void AddTextureBarriers(RenderGraphPass* pass, RenderGraphTexture* texture, RenderBackendResourceState state, const RenderGraphTextureSubresourceRange& range);
 
 		void* Alloc(uint32 size)
 		{
@@ -541,16 +644,31 @@ export namespace HE
 			return HE_ARENA_ALIGNED_ALLOC(arena, size, alignment);
 		}
 
+		/** Objects live until Clear(), which destroys them and returns their memory to objectArena. */
 		template <typename ObjectType, typename... Args>
 		FORCEINLINE ObjectType* AllocObject(Args&&... args)
 		{
-			ObjectType* result = (ObjectType*)HE_ARENA_ALLOC(arena, sizeof(ObjectType));
+			ObjectType* result = (ObjectType*)HE_ARENA_ALIGNED_ALLOC(objectArena, sizeof(ObjectType), alignof(ObjectType));
 			ASSERT(result);
 			result = new(result) ObjectType(std::forward<Args>(args)...);
+			objects.push_back({ result, sizeof(ObjectType), alignof(ObjectType), [](void* object) { ((ObjectType*)object)->~ObjectType(); } });
 			return result;
 		}
 
+		struct Object
+		{
+			void* ptr;
+			uint64 size;
+			uint64 alignment;
+			void (*destroy)(void*);
+		};
+
 		MemoryArena* arena;
+		MemoryArena* objectArena;
+		MemoryArenaResource arenaResource;
+		std::vector<Object> objects;
+
+		RenderGraphSchedule schedule;
 
 		RenderGraphDAG dag;
 
@@ -561,15 +679,21 @@ export namespace HE
 
 		std::map<RenderBackendTextureHandle, RenderGraphTextureHandle> externalTextures;
 		std::map<RenderBackendBufferHandle, RenderGraphBufferHandle> externalBuffers;
+
+		std::vector<std::pair<RenderGraphTextureHandle, RenderGraphPersistentTexture*>> exportedTextures;
 	};
 
 	template<typename SetupLambdaType>
 	void RenderGraph::AddPass(const char* name, RenderGraphPassFlags flags, SetupLambdaType setup)
 	{
-		RenderGraphLambdaPass* pass = AllocObject<RenderGraphLambdaPass>(name, flags);
+		RenderGraphLambdaPass* pass = AllocObject<RenderGraphLambdaPass>(name, flags, &arenaResource);
 		RenderGraphBuilder builder(this, pass);
 		const auto& execute = setup(builder);
 		pass->SetExecuteCallback(std::move(execute));
+		if (HAS_ANY_FLAGS(flags, RenderGraphPassFlags::NeverGetCulled))
+		{
+			pass->NeverCull();
+		}
 		passes.emplace_back(pass);
 		dag.RegisterNode(pass);
 	}
@@ -4,12 +4,16 @@ namespace HE
 {
 	RenderGraphTextureHandle RenderGraphBuilder::CreateTransientTexture(const RenderGraphTextureDesc& desc, const char* name)
 	{
-		return RenderGraphTextureHandle();
+		RenderGraphTextureHandle handle = renderGraph->CreateTexture(desc, name);
+		renderGraph->textures[handle.GetIndex()]->transient = true;
+		return handle;
 	}
 
 	RenderGraphBufferHandle RenderGraphBuilder::CreateTransientBuffer(const RenderGraphBufferDesc& desc, const char* name)
 	{
-		return RenderGraphBufferHandle();
+		RenderGraphBufferHandle handle = renderGraph->CreateBuffer(desc, name);
+		renderGraph->buffers[handle.GetIndex()]->transient = true;
+		return handle;
 	}
 
 	RenderGraphTextureHandle RenderGraphBuilder::ReadTexture(RenderGraphTextureHandle handle, RenderBackendResourceState finalState, const RenderGraphTextureSubresourceRange& range)
@@ -19,8 +23,10 @@ namespace HE
 			.state = finalState,
 			.subresourceRange = range,
 		});
-		pass->inputs.push_back(renderGraph->textures[handle.GetIndex()]);
-		renderGraph->textures[handle.GetIndex()]->refCount++;
+		RenderGraphTexture* texture = renderGraph->textures[handle.GetIndex()];
+		pass->inputs.push_back(texture);
+		texture->outputs.push_back(pass);
+		texture->AddRef();
 		return handle;
 	}
 
@@ -31,9 +37,11 @@ namespace HE
 			.state = finalState,
 			.subresourceRange = range,
 		});
-		pass->outputs.push_back(renderGraph->textures[handle.GetIndex()]);
+		RenderGraphTexture* texture = renderGraph->textures[handle.GetIndex()];
+		pass->outputs.push_back(texture);
+		texture->inputs.push_back(pass);
 		//handle = RenderGraphTextureHandle::CreateNewVersion(handle);
-		pass->refCount++;
+		pass->AddRef();
 		return handle;
 	}
 
@@ -44,41 +52,60 @@ namespace HE
 			.state = finalState,
 			.subresourceRange = range,
 		});
-		//pass->readResourceInfos[pass->numReadResourceInfos++] = {
-		//	.type = RenderGraphResourceType::Texture,
-		//	.readTexture = {
-		//		.handle = handle,
-		//		.finalState = finalState,
-		//		.subresourceRange = range,
-		//	}
-		//};
-		//renderGraph->textures[handle.GetIndex()].refCount++;
+		// Both a read and a write. The reference the pass takes on the texture is dropped again by RenderGraph::CullPasses(),
+		// otherwise the two would keep each other alive.
+		RenderGraphTexture* texture = renderGraph->textures[handle.GetIndex()];
+		pass->inputs.push_back(texture);
+		texture->outputs.push_back(pass);
+		texture->AddRef();
+		pass->outputs.push_back(texture);
+		texture->inputs.push_back(pass);
 		//handle = RenderGraphTextureHandle::CreateNewVersion(handle);
-		//pass->writeResourceInfos[pass->numWriteResourceInfos++] = {
-		//	.type = RenderGraphResourceType::Texture,
-		//	.writeTexture = {
-		//		.handle = handle,
-		//		.finalState = finalState,
-		//		.subresourceRange = range,
-		//	}
-		//};
-		//pass->refCount++;
+		pass->AddRef();
 		return handle;
 	}
 
-	RenderGraphBufferHandle RenderGraphBuilder::ReadBuffer(RenderGraphBufferHandle handle, RenderBackendResourceState initalState)
+	RenderGraphBufferHandle RenderGraphBuilder::ReadBuffer(RenderGraphBufferHandle handle, RenderBackendResourceState finalState)
 	{
-		return RenderGraphBufferHandle();
+		RenderGraphBuffer* buffer = renderGraph->buffers[handle.GetIndex()];
+		pass->bufferStates.push_back(RenderGraphPass::BufferState{
+			.buffer = buffer,
+			.state = finalState,
+		});
+		pass->inputs.push_back(buffer);
+		buffer->outputs.push_back(pass);
+		buffer->AddRef();
+		return handle;
 	}
 
-	RenderGraphBufferHandle RenderGraphBuilder::WriteBuffer(RenderGraphBufferHandle handle, RenderBackendResourceState initalState)
+	RenderGraphBufferHandle RenderGraphBuilder::WriteBuffer(RenderGraphBufferHandle handle, RenderBackendResourceState finalState)
 	{
-		return RenderGraphBufferHandle();
+		RenderGraphBuffer* buffer = renderGraph->buffers[handle.GetIndex()];
+		pass->bufferStates.push_back(RenderGraphPass::BufferState{
+			.buffer = buffer,
+			.state = finalState,
+		});
+		pass->outputs.push_back(buffer);
+		buffer->inputs.push_back(pass);
+		pass->AddRef();
+		return handle;
 	}
 
-	RenderGraphBufferHandle RenderGraphBuilder::ReadWriteBuffer(RenderGraphBufferHandle handle, RenderBackendResourceState initalState)
+	RenderGraphBufferHandle RenderGraphBuilder::ReadWriteBuffer(RenderGraphBufferHandle handle, RenderBackendResourceState finalState)
 	{
-		return RenderGraphBufferHandle();
+		RenderGraphBuffer* buffer = renderGraph->buffers[handle.GetIndex()];
+		pass->bufferStates.push_back(RenderGraphPass::BufferState{
+			.buffer = buffer,
+			.state = finalState,
+		});
+		// Same as ReadWriteTexture(), the reference on the buffer is dropped again when culling.
+		pass->inputs.push_back(buffer);
+		buffer->outputs.push_back(pass);
+		buffer->AddRef();
+		pass->outputs.push_back(buffer);
+		buffer->inputs.push_back(pass);
+		pass->AddRef();
+		return handle;
 	}
 
 	void RenderGraphBuilder::BindColorTarget(uint32 slot, RenderGraphTextureHandle handle, RenderTargetLoadOp loadOp, RenderTargetStoreOp storeOp, uint32 mipLevel, uint32 arraylayer)
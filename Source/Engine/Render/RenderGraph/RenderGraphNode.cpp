@@ -4,6 +4,7 @@ namespace HE
 {
 	void RenderGraphDAG::RegisterNode(RenderGraphNode* node)
 	{
+		node->index = (uint32)nodes.size();
 		nodes.push_back(node);
 	}
 
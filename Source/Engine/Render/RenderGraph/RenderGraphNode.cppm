@@ -1,6 +1,7 @@
 module;
 
 #include <vector>
+#include <memory_resource>
 
 export module HorizonEngine.Render.RenderGraph:RenderGraphNode;
 
@@ -18,8 +19,9 @@ export namespace HE
 	class RenderGraphNode
 	{
 	public:
-		RenderGraphNode(const char* name, RenderGraphNodeType type)
-			: name(name), type(type) {}
+		/** Inputs and outputs are rebuilt every frame, resource is usually backed by the render graph's frame arena. */
+		RenderGraphNode(const char* name, RenderGraphNodeType type, std::pmr::memory_resource* resource)
+			: name(name), type(type), inputs(resource), outputs(resource) {}
 		virtual ~RenderGraphNode() = default;
 		void NeverCull()
 		{ 
@@ -37,11 +39,16 @@ export namespace HE
 		{
 			return refCount;
 		}
-		const std::vector<RenderGraphNode*>& GetInputs() const 
+		/** Position in the DAG, indexes per-node data while compiling. */
+		uint32 GetIndex() const
+		{
+			return index;
+		}
+		const std::pmr::vector<RenderGraphNode*>& GetInputs() const 
 		{
 			return inputs;
 		}
-		const std::vector<RenderGraphNode*>& GetOutputs() const
+		const std::pmr::vector<RenderGraphNode*>& GetOutputs() const
 		{
 			return outputs;
 		}
@@ -49,12 +56,31 @@ export namespace HE
 		friend class RenderGraph;
 		friend class RenderGraphDAG;
 		friend class RenderGraphBuilder;
+		/** References of a node that never gets culled are not counted. */
+		void AddRef()
+		{
+			if (refCount != InfRefCount)
+			{
+				refCount++;
+			}
+		}
+		/** Returns true when the last reference is gone. */
+		bool ReleaseRef()
+		{
+			if (refCount == InfRefCount)
+			{
+				return false;
+			}
+			ASSERT(refCount > 0);
+			return --refCount == 0;
+		}
 		const char* name;
 		RenderGraphNodeType type;
+		uint32 index = 0;
 		uint32 refCount = 0;
 		static const uint32 InfRefCount = (uint32)-1;
-		std::vector<RenderGraphNode*> inputs;
-		std::vector<RenderGraphNode*> outputs;
+		std::pmr::vector<RenderGraphNode*> inputs;
+		std::pmr::vector<RenderGraphNode*> outputs;
 	};
 
 	class RenderGraphDAG
@@ -6,18 +6,60 @@ namespace HE
 
 	RenderGraphResourcePool* gRenderGraphResourcePool = new RenderGraphResourcePool();
 
-	void RenderGraphResourcePool::Tick()
+	void RenderGraphResourcePool::Tick(RenderBackend* backend)
 	{
 		for (auto& pooledTexture : allocatedTextures)
 		{
-			pooledTexture.active = false;
+			// Exported textures are still read by a later graph.
+			if (!pooledTexture.exported)
+			{
+				pooledTexture.active = false;
+			}
+		}
+		for (uint32 i = 0; i < (uint32)placedTextures.size();)
+		{
+			RenderGraphPlacedTexture& placedTexture = placedTextures[i];
+			if (frameCounter - placedTexture.lastUsedFrame >= MaxNumUnusedPlacedTextureFrames)
+			{
+				// The backend defers the destruction until the GPU is done with the texture.
+				RenderBackendDestroyTexture(backend, placedTexture.texture);
+				placedTexture = placedTextures.back();
+				placedTextures.pop_back();
+				continue;
+			}
+			placedTexture.active = false;
+			i++;
+		}
+		for (auto& pooledBuffer : allocatedBuffers)
+		{
+			pooledBuffer.active = false;
 		}
 		frameCounter++;
 	}
 
 	void RenderGraphResourcePool::CacheTexture(const RenderGraphPersistentTexture& texture)
 	{
+		for (auto& pooledTexture : allocatedTextures)
+		{
+			if (pooledTexture.texture == texture.texture)
+			{
+				// Stays active until Tick(), the current frame may still read it.
+				pooledTexture.exported = false;
+				return;
+			}
+		}
+	}
 
+	void RenderGraphResourcePool::ExportTexture(RenderBackendTextureHandle texture)
+	{
+		for (auto& pooledTexture : allocatedTextures)
+		{
+			if (pooledTexture.texture == texture)
+			{
+				pooledTexture.exported = true;
+				return;
+			}
+		}
 	}
 
 	RenderBackendTextureHandle RenderGraphResourcePool::FindOrCreateTexture(RenderBackend* backend, const RenderBackendTextureDesc* desc, const char* name)
@@ -49,4 +91,108 @@ namespace HE
 
 		return allocatedTextures.back().texture;
 	}
+
+	RenderBackendBufferHandle RenderGraphResourcePool::FindOrCreateBuffer(RenderBackend* backend, const RenderBackendBufferDesc* desc, const char* name)
+	{
+		for (auto& pooledBuffer : allocatedBuffers)
+		{
+			if (pooledBuffer.active)
+			{
+				continue;
+			}
+			if (pooledBuffer.desc.size == desc->size && pooledBuffer.desc.elementSize == desc->elementSize && pooledBuffer.desc.flags == desc->flags)
+			{
+				pooledBuffer.active = true;
+				return pooledBuffer.buffer;
+			}
+		}
+
+		uint32 deviceMask = ~0u;
+		RenderBackendBufferHandle buffer = RenderBackendCreateBuffer(backend, deviceMask, desc, name);
+		RenderGraphPersistentBuffer pooledBuffer = {
+			.active = true,
+			.buffer = buffer,
+			.desc = *desc,
+			.initialState = RenderBackendResourceState::Undefined,
+		};
+		allocatedBuffers.emplace_back(pooledBuffer);
+
+		return allocatedBuffers.back().buffer;
+	}
+
+	const RenderBackendMemoryRequirements& RenderGraphResourcePool::GetTextureMemoryRequirements(RenderBackend* backend, const RenderBackendTextureDesc* desc)
+	{
+		for (const auto& [textureDesc, memoryRequirements] : textureMemoryRequirements)
+		{
+			if (textureDesc == *desc)
+			{
+				return memoryRequirements;
+			}
+		}
+
+		uint32 deviceMask = ~0u;
+		RenderBackendMemoryRequirements memoryRequirements = {};
+		RenderBackendGetTextureMemoryRequirements(backend, deviceMask, desc, &memoryRequirements);
+		textureMemoryRequirements.emplace_back(*desc, memoryRequirements);
+		return textureMemoryRequirements.back().second;
+	}
+
+	RenderBackendHeapHandle RenderGraphResourcePool::GetTransientHeap(RenderBackend* backend, uint64 size, uint64 alignment, uint32 memoryTypeBits)
+	{
+		// The heap got one of the memory types it was created with, so it only fits if all of them do.
+		if (transientHeap != RenderBackendHeapHandle::NullHandle
+			&& transientHeapDesc.size >= size
+			&& transientHeapDesc.alignment % alignment == 0
+			&& (transientHeapDesc.memoryTypeBits & ~memoryTypeBits) == 0)
+		{
+			return transientHeap;
+		}
+
+		if (transientHeap != RenderBackendHeapHandle::NullHandle)
+		{
+			for (const auto& placedTexture : placedTextures)
+			{
+				RenderBackendDestroyTexture(backend, placedTexture.texture);
+			}
+			placedTextures.clear();
+			RenderBackendDestroyHeap(backend, transientHeap);
+		}
+
+		uint32 deviceMask = ~0u;
+		transientHeapDesc = {
+			.size = Math::Max(size, transientHeapDesc.size),
+			.alignment = Math::Max(alignment, transientHeapDesc.alignment),
+			.memoryTypeBits = memoryTypeBits,
+		};
+		transientHeap = RenderBackendCreateHeap(backend, deviceMask, &transientHeapDesc, "RenderGraphTransientHeap");
+		return transientHeap;
+	}
+
+	RenderBackendTextureHandle RenderGraphResourcePool::FindOrCreatePlacedTexture(RenderBackend* backend, uint64 offset, const RenderBackendTextureDesc* desc, const char* name)
+	{
+		ASSERT(transientHeap != RenderBackendHeapHandle::NullHandle);
+		for (auto& placedTexture : placedTextures)
+		{
+			if (placedTexture.active)
+			{
+				continue;
+			}
+			if (placedTexture.offset == offset && placedTexture.desc == *desc)
+			{
+				placedTexture.active = true;
+				placedTexture.lastUsedFrame = frameCounter;
+				return placedTexture.texture;
+			}
+		}
+
+		RenderBackendTextureHandle texture = RenderBackendCreatePlacedTexture(backend, transientHeap, offset, desc, name);
+		placedTextures.push_back(RenderGraphPlacedTexture{
+			.active = true,
+			.texture = texture,
+			.desc = *desc,
+			.offset = offset,
+			.lastUsedFrame = frameCounter,
+		});
+		return texture;
+	}
 }
\ No newline at end of file
@@ -20,20 +20,43 @@ namespace HE
 	{
 	}
 
-	RenderBackendTextureHandle LoadTextureFromHDRFile(RenderBackend* renderBackend, const char* filename)
+	struct LoadImageJobData
+	{
+		const char* filename;
+		bool hdr;
+		int width;
+		int height;
+		int numChannels;
+		void* data;
+	};
+
+	/** Reading and decoding block on the file, so from a job they run on an I/O thread. Never flips, stb's flip flag is global. */
+	static void LoadImageJob(void* data)
 	{
-		if (!stbi_is_hdr(filename))
+		LoadImageJobData* jobData = (LoadImageJobData*)data;
+		if (jobData->hdr)
 		{
-			return RenderBackendTextureHandle::NullHandle;
+			jobData->data = stbi_is_hdr(jobData->filename) ? stbi_loadf(jobData->filename, &jobData->width, &jobData->height, &jobData->numChannels, STBI_rgb_alpha) : nullptr;
+		}
+		else
+		{
+			jobData->data = stbi_load(jobData->filename, &jobData->width, &jobData->height, &jobData->numChannels, STBI_default);
 		}
+	}
 
-		int iw = 0, ih = 0, c = 0;
-		stbi_set_flip_vertically_on_load(false);
-		void* data = stbi_loadf(filename, &iw, &ih, &c, STBI_rgb_alpha);
+	RenderBackendTextureHandle LoadTextureFromHDRFile(RenderBackend* renderBackend, const char* filename)
+	{
+		LoadImageJobData jobData = {
+			.filename = filename,
+			.hdr = true,
+		};
+		JobSystemRunBlocking(LoadImageJob, &jobData);
+		void* data = jobData.data;
 		if (data == nullptr)
 		{
 			return RenderBackendTextureHandle::NullHandle;
 		}
+		int iw = jobData.width, ih = jobData.height;
 		uint64 bufferSize = iw * ih * 4 * sizeof(float);
 
 		RenderBackendTextureDesc desc = RenderBackendTextureDesc::CreateTexture2D(iw, ih, 1, PixelFormat::RGBA32Float);
@@ -45,51 +68,58 @@ namespace HE
 
 	RenderBackendTextureHandle LoadTextureFromFile(RenderBackend* renderBackend, const char* filename, bool autoMipmaps = true, bool filpY = true)
 	{
-		int iw = 0, ih = 0, c = 0;
-		stbi_set_flip_vertically_on_load(filpY);
-		unsigned char* data = stbi_load(filename, &iw, &ih, &c, STBI_default);
+		LoadImageJobData jobData = {
+			.filename = filename,
+			.hdr = false,
+		};
+		JobSystemRunBlocking(LoadImageJob, &jobData);
+		unsigned char* data = (unsigned char*)jobData.data;
 		if (data == nullptr)
 		{
 			return RenderBackendTextureHandle::NullHandle;
 		}
+		int iw = jobData.width, ih = jobData.height, c = jobData.numChannels;
 		uint64 bufferSize = iw * ih * 4;
 		unsigned char* buffer = (unsigned char*)_aligned_malloc(bufferSize, 32);
 
 		for (uint32 y = 0; y < (uint32)ih; y++)
 		{
+			// The flip happens here while converting, see LoadImageJob().
+			const uint32 srcY = filpY ? ((uint32)ih - 1 - y) : y;
 			for (uint32 x = 0; x < (uint32)iw; x++)
 			{
 				uint32 idx = x + y * iw;
+				uint32 srcIdx = x + srcY * iw;
 				switch (c)
 				{
 				case STBI_grey:
 				{
-					buffer[idx * 4 + 0] = data[idx];
+					buffer[idx * 4 + 0] = data[srcIdx];
 					buffer[idx * 4 + 2] = buffer[idx * 4 + 1] = buffer[idx * 4 + 0];
 					buffer[idx * 4 + 3] = 255;
 					break;
 				}
 				case STBI_grey_alpha:
 				{
-					buffer[idx * 4 + 0] = data[idx * 2 + 0];
+					buffer[idx * 4 + 0] = data[srcIdx * 2 + 0];
 					buffer[idx * 4 + 2] = buffer[idx * 4 + 1] = buffer[idx * 4 + 0];
-					buffer[idx * 4 + 3] = data[idx * 2 + 1];
+					buffer[idx * 4 + 3] = data[srcIdx * 2 + 1];
 					break;
 				}
 				case STBI_rgb:
 				{
-					buffer[idx * 4 + 0] = data[idx * 3 + 0];
-					buffer[idx * 4 + 1] = data[idx * 3 + 1];
-					buffer[idx * 4 + 2] = data[idx * 3 + 2];
+					buffer[idx * 4 + 0] = data[srcIdx * 3 + 0];
+					buffer[idx * 4 + 1] = data[srcIdx * 3 + 1];
+					buffer[idx * 4 + 2] = data[srcIdx * 3 + 2];
 					buffer[idx * 4 + 3] = 255;
 					break;
 				}
 				case STBI_rgb_alpha:
 				{
-					buffer[idx * 4 + 0] = data[idx * 4 + 0];
-					buffer[idx * 4 + 1] = data[idx * 4 + 1];
-					buffer[idx * 4 + 2] = data[idx * 4 + 2];
-					buffer[idx * 4 + 3] = data[idx * 4 + 3];
+					buffer[idx * 4 + 0] = data[srcIdx * 4 + 0];
+					buffer[idx * 4 + 1] = data[srcIdx * 4 + 1];
+					buffer[idx * 4 + 2] = data[srcIdx * 4 + 2];
+					buffer[idx * 4 + 3] = data[srcIdx * 4 + 3];
 					break;
 				}
 				default: break;
@@ -332,11 +362,13 @@ namespace HE
 		
 		skyLight->filteredEnvironmentMap = RenderBackendCreateTexture(renderBackend, deviceMask, &cubemapDesc, nullptr, "FilteredEnvironmentMap");
 
-		RenderCommandList* commandList = new RenderCommandList(arena);
+		RenderCommandList* commandList = new RenderCommandList();
 
 		EquirectangularToCubemap(*commandList, equirectangular, skyLight->environmentMap, cubemapSize);
 		ComputeEnviromentCubemaps(*commandList, skyLight->environmentMap, cubemapSize, skyLight->irradianceEnvironmentMap, skyLight->filteredEnvironmentMap);
 
 		RenderBackendSubmitRenderCommandLists(renderBackend, &commandList, 1);
+		// Submitting records the commands into backend command buffers, the list is no longer needed.
+		delete commandList;
 	}
 }
\ No newline at end of file
@@ -152,5 +152,8 @@ export namespace HE
 		uint32 numCommandLists = (uint32)renderContext->commandLists.size();
 		RenderCommandList** commandLists = renderContext->commandLists.data();
 		RenderBackendSubmitRenderCommandLists(renderBackend, commandLists, numCommandLists);
+		gRenderGraphResourcePool->Tick(renderBackend);
+		// Destroys what the render graph and the pool released this frame, e.g. textures placed in an outgrown transient heap.
+		RenderBackendTick(renderBackend);
 	}
 }
\ No newline at end of file
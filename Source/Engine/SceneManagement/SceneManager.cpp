@@ -74,6 +74,11 @@ namespace HE
 		delete entityManager;
 	}
 
+	/**
+	 * Updates the transform of the entity and of its clean descendants.
+	 * Dirty descendants are updated from their own entry in the dirty list, so every transform is written exactly once
+	 * and subtrees can be updated in parallel. Only reads the registry.
+	 */
 	static void UpdateTransform(EntityManager* manager, EntityHandle entity)
 	{
 		const auto& hierarchy = manager->GetComponent<SceneHierarchyComponent>(entity);
@@ -82,14 +87,12 @@ namespace HE
 		auto currentEntity = hierarchy.first;
 		for (uint32 i = 0; i < hierarchy.numChildren; i++)
 		{
-			if (manager->HasComponent<TransformDirtyComponent>(currentEntity))
+			if (!manager->HasComponent<TransformDirtyComponent>(currentEntity))
 			{
-				continue;
+				UpdateTransform(manager, currentEntity);
 			}
-			UpdateTransform(manager, currentEntity);
 			currentEntity = manager->GetComponent<SceneHierarchyComponent>(currentEntity).next;
 		}
-		manager->RemoveComponent<TransformDirtyComponent>(entity);
 	}
 
 	void Scene::Update(float timestep)
@@ -104,9 +107,12 @@ namespace HE
 			return lc.depth < rc.depth;
 		});
 
-		entityManager->GetView<TransformDirtyComponent>().each([&](EntityHandle entity)
+		auto dirtyView = entityManager->GetView<TransformDirtyComponent>();
+		std::vector<EntityHandle> dirtyEntities(dirtyView.begin(), dirtyView.end());
+		ParallelFor(0, (uint32)dirtyEntities.size(), 0, [&](uint32 i)
 		{
-			UpdateTransform(entityManager, entity);
+			UpdateTransform(entityManager, dirtyEntities[i]);
 		});
+		entityManager->Get()->clear<TransformDirtyComponent>();
 	}
 }
\ No newline at end of file
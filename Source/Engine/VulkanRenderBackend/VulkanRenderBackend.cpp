@@ -167,6 +167,16 @@ struct VulkanBindlessManager
 		freeAccelerationStructures.pop_back();
 		return index;
 	}
+
+	void FreeSampledImageIndex(uint32 index)
+	{
+		freeSampledImages.push_back(index);
+	}
+
+	void FreeStorageImageIndex(uint32 index)
+	{
+		freeStorageImages.push_back(index);
+	}
 };
 
 struct VulkanPhysicalDevice
@@ -289,6 +299,13 @@ struct VulkanBuffer
 	VulkanRayTracingShaderBindingTable* shaderBindingTable;
 };
 
+/** Device memory that textures are placed into, several of them may share a range when they are not used at the same time. */
+struct VulkanHeap
+{
+	VmaAllocation allocation;
+	uint64 size;
+};
+
 
 struct PipelineState
 {
@@ -365,6 +382,8 @@ struct VulkanCommandBuffer
 	VkCommandBuffer handle;
 	VkFence fence;
 	VkSemaphore semaphore;
+	/** VulkanDevice::numSubmissions of the last submission that used it, 0 if it has never been submitted. */
+	uint64 submissionIndex = 0;
 };
 
 struct VulkanSubmitContext
@@ -426,13 +445,17 @@ struct ResourceToDestroy
 	{
 		Buffer,
 		Texture,
+		TextureView,
 		Sampler,
+		Heap,
 	};
 	Type type;
 	uint64 vkHandle;
 	VmaAllocation allocation;
 	int32 bindlessSRV;
 	int32 bindlessUAV;
+	/** The resource is destroyed once this submission has completed, see VulkanDevice::QueueResourceToDestroy(). */
+	uint64 submissionIndex;
 };
 
 class VulkanDevice
@@ -444,6 +467,8 @@ public:
 	void Shutdown();
 	void Tick();
 	void WaitIdle();
+	void QueueResourceToDestroy(ResourceToDestroy resource);
+	void DestroyPendingResources(uint64 numCompletedSubmissions);
 	bool IsDeviceExtensionEnabled(const char* extension);
 	void ResizeSwapChain(uint32 index, uint32* width, uint32* height);
 	VulkanSwapchain::Status AcquireImageIndex(uint32 index);
@@ -459,8 +484,12 @@ public:
 	uint64 GetBufferDeviceAddress(RenderBackendBufferHandle bufferHandle);
 	void* MapBuffer(uint32 index);
 	void UnmapBuffer(uint32 index);
-	uint32 CreateTexture(const RenderBackendTextureDesc* desc, const void* data, const char* name);
+	/** Creates the texture with memory of its own, or bound to heap at heapOffset without initial data. */
+	uint32 CreateTexture(const RenderBackendTextureDesc* desc, const void* data, const char* name, const VulkanHeap* heap = nullptr, uint64 heapOffset = 0);
 	void DestroyTexture(uint32 index);
+	void GetTextureMemoryRequirements(const RenderBackendTextureDesc* desc, VkMemoryRequirements* outRequirements);
+	uint32 CreateHeap(const RenderBackendHeapDesc* desc, const char* name);
+	void DestroyHeap(uint32 index);
 	uint32 CreateTextureSRV(uint32 textureIndex, const RenderBackendTextureSRVDesc* desc, const char* name);
 	int32 GetTextureSRVDescriptorIndex(uint32 textureIndex);
 	uint32 CreateTextureUAV(uint32 textureIndex, const RenderBackendTextureUAVDesc* desc, const char* name);
@@ -572,6 +601,8 @@ public:
 	}
 	std::vector<VkSemaphore> renderCompleteSemaphores;
 	VulkanCommandBufferManager* commandBufferManager;
+	/** Number of command buffers submitted with a fence, resources queued for destruction wait for the next one to complete. */
+	uint64 numSubmissions = 0;
 	RenderStatistics renderStatistics;
 	std::vector<VulkanSwapchain> swapchains;
 	void CreateVmaAllocator();
@@ -611,6 +642,8 @@ public:
 	std::vector<uint32> freeBuffers;
 	std::vector<VulkanTexture> textures;
 	std::vector<uint32> freeTextures;
+	std::vector<VulkanHeap> heaps;
+	std::vector<uint32> freeHeaps;
 	std::vector<VulkanSampler> samplers;
 	std::vector<uint32> freeSamplers;
 	std::vector<VulkanShader> shaders;
@@ -689,6 +722,10 @@ public:
 		}
 		return AllocateCommandBuffer();
 	}
+	const std::vector<VulkanCommandBuffer>& GetCommandBuffers() const
+	{
+		return commandBuffers;
+	}
 private:
 	VulkanDevice* device;
 	QueueFamily queueFamily;
@@ -1200,7 +1237,33 @@ static void GetRenderPassDescAndClearValues(VulkanDevice* device, const RenderPa
 
 void VulkanDevice::Tick()
 {
-	while (!resourcesToDestroy.empty())
+	if (resourcesToDestroy.empty())
+	{
+		return;
+	}
+	// Everything before the oldest submission that is still running has completed.
+	uint64 numCompletedSubmissions = numSubmissions;
+	for (const VulkanCommandBuffer& commandBuffer : commandBufferManager->GetCommandBuffers())
+	{
+		if (commandBuffer.submissionIndex != 0 && commandBuffer.submissionIndex <= numCompletedSubmissions && vkGetFenceStatus(handle, commandBuffer.fence) == VK_NOT_READY)
+		{
+			numCompletedSubmissions = commandBuffer.submissionIndex - 1;
+		}
+	}
+	DestroyPendingResources(numCompletedSubmissions);
+}
+
+void VulkanDevice::QueueResourceToDestroy(ResourceToDestroy resource)
+{
+	// Submissions up to the one being recorded right now may still use the resource.
+	resource.submissionIndex = numSubmissions + 1;
+	resourcesToDestroy.emplace(resource);
+}
+
+void VulkanDevice::DestroyPendingResources(uint64 numCompletedSubmissions)
+{
+	// Queued in submission order, so the first one that is still in use ends the walk.
+	while (!resourcesToDestroy.empty() && resourcesToDestroy.front().submissionIndex <= numCompletedSubmissions)
 	{
 		const auto& resource = resourcesToDestroy.front();
 		switch (resource.type)
@@ -1208,6 +1271,31 @@ void VulkanDevice::Tick()
 		case ResourceToDestroy::Type::Buffer:
 			vmaDestroyBuffer(vmaAllocator, (VkBuffer)resource.vkHandle, resource.allocation);
 			break;
+		case ResourceToDestroy::Type::Texture:
+			if (resource.allocation != VK_NULL_HANDLE)
+			{
+				vmaDestroyImage(vmaAllocator, (VkImage)resource.vkHandle, resource.allocation);
+			}
+			else
+			{
+				// Placed in a heap, the memory is freed with the heap.
+				vkDestroyImage(handle, (VkImage)resource.vkHandle, VULKAN_ALLOCATION_CALLBACKS);
+			}
+			break;
+		case ResourceToDestroy::Type::TextureView:
+			vkDestroyImageView(handle, (VkImageView)resource.vkHandle, VULKAN_ALLOCATION_CALLBACKS);
+			if (resource.bindlessSRV >= 0)
+			{
+				bindlessManager.FreeSampledImageIndex((uint32)resource.bindlessSRV);
+			}
+			if (resource.bindlessUAV >= 0)
+			{
+				bindlessManager.FreeStorageImageIndex((uint32)resource.bindlessUAV);
+			}
+			break;
+		case ResourceToDestroy::Type::Heap:
+			vmaFreeMemory(vmaAllocator, resource.allocation);
+			break;
 		default:
 			break;
 		}
@@ -1304,7 +1392,7 @@ void VulkanDevice::ResizeBuffer(uint32 index, uint64 size)
 			.vkHandle = (uint64)buffer.handle,
 			.allocation = buffer.allocation,
 		};
-		resourcesToDestroy.emplace(resource);
+		QueueResourceToDestroy(resource);
 	}
 	if (size > 0)
 	{
@@ -1395,7 +1483,80 @@ void VulkanDevice::UnmapBuffer(uint32 index)
 	}
 }
 
-uint32 VulkanDevice::CreateTexture(const RenderBackendTextureDesc* desc, const void* data, const char* name)
+static VkImageCreateInfo GetVkImageCreateInfo(const RenderBackendTextureDesc* desc)
+{
+	VkImageCreateFlags flags = 0;
+	if (desc->type == TextureType::TextureCube)
+	{
+		flags |= VK_IMAGE_CREATE_CUBE_COMPATIBLE_BIT;
+	}
+	VkImageCreateInfo imageInfo = {
+		.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO,
+		.flags = flags,
+		.imageType = ConvertToVkImageType(desc->type),
+		.format = ConvertToVkFormat(desc->format),
+		.extent = { desc->width, desc->height, desc->depth },
+		.mipLevels = desc->mipLevels,
+		.arrayLayers = desc->arrayLayers,
+		.samples = VK_SAMPLE_COUNT_1_BIT,
+		.tiling = VK_IMAGE_TILING_OPTIMAL,
+		.usage = GetVkImageUsageFlags(desc->flags),
+		.sharingMode = VK_SHARING_MODE_EXCLUSIVE
+	};
+	return imageInfo;
+}
+
+void VulkanDevice::GetTextureMemoryRequirements(const RenderBackendTextureDesc* desc, VkMemoryRequirements* outRequirements)
+{
+	// The requirements only depend on the create info, a throwaway image without memory is enough to query them.
+	VkImageCreateInfo imageInfo = GetVkImageCreateInfo(desc);
+	VkImage image = VK_NULL_HANDLE;
+	VK_CHECK(vkCreateImage(handle, &imageInfo, VULKAN_ALLOCATION_CALLBACKS, &image));
+	vkGetImageMemoryRequirements(handle, image, outRequirements);
+	vkDestroyImage(handle, image, VULKAN_ALLOCATION_CALLBACKS);
+}
+
+uint32 VulkanDevice::CreateHeap(const RenderBackendHeapDesc* desc, const char* name)
+{
+	uint32 heapIndex = 0;
+	if (!freeHeaps.empty())
+	{
+		heapIndex = freeHeaps.back();
+		freeHeaps.pop_back();
+	}
+	else
+	{
+		heapIndex = (uint32)heaps.size();
+		heaps.emplace_back();
+	}
+
+	VulkanHeap& heap = heaps[heapIndex];
+	heap.size = desc->size;
+	VkMemoryRequirements memoryRequirements = {
+		.size = desc->size,
+		.alignment = desc->alignment,
+		.memoryTypeBits = desc->memoryTypeBits,
+	};
+	VmaAllocationCreateInfo memoryInfo = {};
+	memoryInfo.usage = VMA_MEMORY_USAGE_GPU_ONLY;
+	VK_CHECK(vmaAllocateMemory(vmaAllocator, &memoryRequirements, &memoryInfo, &heap.allocation, nullptr));
+	return heapIndex;
+}
+
+void VulkanDevice::DestroyHeap(uint32 index)
+{
+	VulkanHeap& heap = heaps[index];
+	ResourceToDestroy resource = {
+		.type = ResourceToDestroy::Type::Heap,
+		.vkHandle = 0,
+		.allocation = heap.allocation,
+	};
+	QueueResourceToDestroy(resource);
+	heap = {};
+	freeHeaps.push_back(index);
+}
+
+uint32 VulkanDevice::CreateTexture(const RenderBackendTextureDesc* desc, const void* data, const char* name, const VulkanHeap* heap, uint64 heapOffset)
 {
 	uint32 textureIndex = 0;
 	if (!freeTextures.empty())
@@ -1426,33 +1587,26 @@ uint32 VulkanDevice::CreateTexture(const RenderBackendTextureDesc* desc, const v
 		.clearValue = *(VkClearValue*)&desc->clearValue,
 	};
 
-	VkImageCreateFlags flags = 0;
-	if (desc->type == TextureType::TextureCube)
+	VkImageCreateInfo imageInfo = GetVkImageCreateInfo(desc);
+
+	if (heap)
 	{
-		flags |= VK_IMAGE_CREATE_CUBE_COMPATIBLE_BIT;
+		// The heap owns the memory, the texture has no allocation to free.
+		ASSERT(data == nullptr);
+		VK_CHECK(vkCreateImage(handle, &imageInfo, VULKAN_ALLOCATION_CALLBACKS, &texture.handle));
+		VK_CHECK(vmaBindImageMemory2(vmaAllocator, heap->allocation, heapOffset, texture.handle, nullptr));
+		texture.allocation = VK_NULL_HANDLE;
 	}
-	VkImageUsageFlags usage = GetVkImageUsageFlags(desc->flags);
-	VkImageCreateInfo imageInfo = {
-		.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO,
-		.flags = flags,
-		.imageType = texture.type,
-		.format = texture.format,
-		.extent = { texture.width, texture.height, texture.depth },
-		.mipLevels = texture.mipLevels,
-		.arrayLayers = texture.arrayLayers,
-		.samples = VK_SAMPLE_COUNT_1_BIT,
-		.tiling = VK_IMAGE_TILING_OPTIMAL,
-		.usage = usage,
-		.sharingMode = VK_SHARING_MODE_EXCLUSIVE
-	};
-
-	VmaAllocationCreateInfo memoryInfo = {};
-	memoryInfo.usage = VMA_MEMORY_USAGE_GPU_ONLY;
-	if (imageInfo.usage & VK_IMAGE_USAGE_TRANSIENT_ATTACHMENT_BIT)
+	else
 	{
-		memoryInfo.preferredFlags = VK_MEMORY_PROPERTY_LAZILY_ALLOCATED_BIT;
+		VmaAllocationCreateInfo memoryInfo = {};
+		memoryInfo.usage = VMA_MEMORY_USAGE_GPU_ONLY;
+		if (imageInfo.usage & VK_IMAGE_USAGE_TRANSIENT_ATTACHMENT_BIT)
+		{
+			memoryInfo.preferredFlags = VK_MEMORY_PROPERTY_LAZILY_ALLOCATED_BIT;
+		}
+		VK_CHECK(vmaCreateImage(vmaAllocator, &imageInfo, &memoryInfo, &texture.handle, &texture.allocation, VULKAN_ALLOCATION_CALLBACKS));
 	}
-	VK_CHECK(vmaCreateImage(vmaAllocator, &imageInfo, &memoryInfo, &texture.handle, &texture.allocation, VULKAN_ALLOCATION_CALLBACKS));
 	
 	if (name)
 	{
@@ -1752,7 +1906,41 @@ uint32 VulkanDevice::CreateTexture(const RenderBackendTextureDesc* desc, const v
 
 void VulkanDevice::DestroyTexture(uint32 index)
 {
-
+	VulkanTexture& texture = textures[index];
+	// Swapchain buffers belong to the swapchain.
+	ASSERT(!texture.swapchainBuffer);
+	auto DestroyView = [&](VkImageView view, int32 bindlessSRV, int32 bindlessUAV)
+	{
+		if (view == VK_NULL_HANDLE)
+		{
+			return;
+		}
+		ResourceToDestroy resource = {
+			.type = ResourceToDestroy::Type::TextureView,
+			.vkHandle = (uint64)view,
+			.allocation = VK_NULL_HANDLE,
+			.bindlessSRV = bindlessSRV,
+			.bindlessUAV = bindlessUAV,
+		};
+		QueueResourceToDestroy(resource);
+	};
+	DestroyView(texture.srv, texture.srvIndex, -1);
+	DestroyView(texture.rtv, -1, -1);
+	DestroyView(texture.dsv, -1, -1);
+	for (const VulkanTexture::UAV& uav : texture.uavs)
+	{
+		DestroyView(uav.uav, -1, uav.uavIndex);
+	}
+	ResourceToDestroy resource = {
+		.type = ResourceToDestroy::Type::Texture,
+		.vkHandle = (uint64)texture.handle,
+		.allocation = texture.allocation,
+		.bindlessSRV = -1,
+		.bindlessUAV = -1,
+	};
+	QueueResourceToDestroy(resource);
+	texture = {};
+	freeTextures.push_back(index);
 }
 
 uint32 VulkanDevice::CreateTextureSRV(uint32 textureIndex, const RenderBackendTextureSRVDesc* desc, const char* name)
@@ -3068,6 +3256,7 @@ bool VulkanDevice::Init(VulkanRenderBackend* backend, VulkanPhysicalDevice* phys
 void VulkanDevice::Shutdown()
 {
 	WaitIdle();
+	DestroyPendingResources(UINT64_MAX);
 	DestroyBindlessManager();
 	for (uint32 i = 0; i < (uint32)swapchains.size(); i++)
 	{
@@ -3502,7 +3691,8 @@ bool VulkanRenderCompileContext::CompileRenderCommand(const RenderCommandTransit
 	for (uint32 i = 0; i < command.numTransitions; i++)
 	{
 		const auto& transition = command.transitions[i];
-		ASSERT(transition.srcState != transition.dstState);
+		// UnorderedAccess to UnorderedAccess orders the writes of one pass before the accesses of the next.
+		ASSERT(transition.srcState != transition.dstState || transition.srcState == RenderBackendResourceState::UnorderedAccess);
 		if (transition.type == RenderBackendBarrier::ResourceType::Texture)
 		{
 			VulkanTexture* texture = device->GetTexture(transition.texture);
@@ -3519,6 +3709,13 @@ bool VulkanRenderCompileContext::CompileRenderCommand(const RenderCommandTransit
 				&dstStageMask,
 				&srcAccessMask,
 				&dstAccessMask);
+			if (transition.aliasing)
+			{
+				// The memory was last used by another texture, wait for everything that may still access it.
+				ASSERT(transition.srcState == RenderBackendResourceState::Undefined);
+				srcStageMask = VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT;
+				srcAccessMask = VK_ACCESS_2_MEMORY_WRITE_BIT;
+			}
 			VkImageMemoryBarrier2 imageBarrier = {
 				.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER_2,
 				.srcStageMask = srcStageMask,
@@ -3542,11 +3739,11 @@ bool VulkanRenderCompileContext::CompileRenderCommand(const RenderCommandTransit
 		}
 		else if (transition.type == RenderBackendBarrier::ResourceType::Buffer)
 		{
-			/*VulkanBuffer* buffer = device->GetBuffer(transition.buffer);
-			VkPipelineStageFlags srcStageMask = VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT;
-			VkPipelineStageFlags dstStageMask = VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT;
-			VkAccessFlags srcAccessMask, dstAccessMask;
-			GetBarrierInfo(
+			VulkanBuffer* buffer = device->GetBuffer(transition.buffer);
+			VkPipelineStageFlags2 srcStageMask = VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT;
+			VkPipelineStageFlags2 dstStageMask = VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT;
+			VkAccessFlags2 srcAccessMask, dstAccessMask;
+			GetBarrierInfo2(
 				transition.srcState,
 				transition.dstState,
 				nullptr,
@@ -3554,11 +3751,12 @@ bool VulkanRenderCompileContext::CompileRenderCommand(const RenderCommandTransit
 				&srcStageMask,
 				&dstStageMask,
 				&srcAccessMask,
-				&dstAccessMask
-			);
-			VkBufferMemoryBarrier bufferMemoryBarrier = {
-				.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER,
+				&dstAccessMask);
+			VkBufferMemoryBarrier2 bufferBarrier = {
+				.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER_2,
+				.srcStageMask = srcStageMask,
 				.srcAccessMask = srcAccessMask,
+				.dstStageMask = dstStageMask,
 				.dstAccessMask = dstAccessMask,
 				.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
 				.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
@@ -3566,27 +3764,18 @@ bool VulkanRenderCompileContext::CompileRenderCommand(const RenderCommandTransit
 				.offset = transition.bufferRange.offset,
 				.size = transition.bufferRange.size,
 			};
-			vkCmdPipelineBarrier(
-				commandBuffer,
-				srcStageMask,
-				dstStageMask,
-				0,
-				0,
-				nullptr,
-				1,
-				&bufferMemoryBarrier,
-				0,
-				nullptr);*/
+			bufferBarriers.push_back(std::move(bufferBarrier));
 		}
 	}
 	VkDependencyInfo dependency = {
 		.sType = VK_STRUCTURE_TYPE_DEPENDENCY_INFO,
-		//.bufferMemoryBarrierCount = ,
-		//.pBufferMemoryBarriers = ,
+		.bufferMemoryBarrierCount = (uint32)bufferBarriers.size(),
+		.pBufferMemoryBarriers = bufferBarriers.data(),
 		.imageMemoryBarrierCount = (uint32)imageBarriers.size(),
 		.pImageMemoryBarriers = imageBarriers.data(),
 	};
 	vkCmdPipelineBarrier2(commandBuffer, &dependency);
+	bufferBarriers.clear();
 	imageBarriers.clear();
 	statistics.transitions += command.numTransitions;
 	return true;
@@ -4392,6 +4581,87 @@ static RenderBackendTextureHandle CreateTexture(void* instance, uint32 deviceMas
 	return handle;
 }
 
+static RenderBackendTextureHandle CreatePlacedTexture(void* instance, RenderBackendHeapHandle heap, uint64 offset, const RenderBackendTextureDesc* desc, const char* name)
+{
+	VulkanRenderBackend* backend = (VulkanRenderBackend*)instance;
+	uint32 deviceMask = heap.GetDeviceMask();
+	RenderBackendTextureHandle handle = backend->handleManager.Allocate<RenderBackendTextureHandle>(deviceMask);
+	for (uint32 deviceIndex = 0; deviceIndex < backend->numDevices; deviceIndex++)
+	{
+		VulkanDevice& device = backend->devices[deviceIndex];
+		if ((device.GetDeviceMask() & deviceMask) == 0)
+		{
+			continue;
+		}
+		uint32 heapIndex = 0;
+		if (!device.TryGetRenderBackendHandleRepresentation(heap.GetIndex(), &heapIndex))
+		{
+			continue;
+		}
+		uint32 index = device.CreateTexture(desc, nullptr, name, &device.heaps[heapIndex], offset);
+		device.SetRenderBackendHandleRepresentation(handle.GetIndex(), index);
+	}
+	return handle;
+}
+
+static void GetTextureMemoryRequirements(void* instance, uint32 deviceMask, const RenderBackendTextureDesc* desc, RenderBackendMemoryRequirements* outRequirements)
+{
+	VulkanRenderBackend* backend = (VulkanRenderBackend*)instance;
+	// What every device in the mask can place the texture with.
+	*outRequirements = { .size = 0, .alignment = 1, .memoryTypeBits = ~0u };
+	for (uint32 deviceIndex = 0; deviceIndex < backend->numDevices; deviceIndex++)
+	{
+		VulkanDevice& device = backend->devices[deviceIndex];
+		if ((device.GetDeviceMask() & deviceMask) == 0)
+		{
+			continue;
+		}
+		VkMemoryRequirements memoryRequirements = {};
+		device.GetTextureMemoryRequirements(desc, &memoryRequirements);
+		outRequirements->size = std::max(outRequirements->size, (uint64)memoryRequirements.size);
+		outRequirements->alignment = std::max(outRequirements->alignment, (uint64)memoryRequirements.alignment);
+		outRequirements->memoryTypeBits &= memoryRequirements.memoryTypeBits;
+	}
+}
+
+static RenderBackendHeapHandle CreateHeap(void* instance, uint32 deviceMask, const RenderBackendHeapDesc* desc, const char* name)
+{
+	VulkanRenderBackend* backend = (VulkanRenderBackend*)instance;
+	RenderBackendHeapHandle handle = backend->handleManager.Allocate<RenderBackendHeapHandle>(deviceMask);
+	for (uint32 deviceIndex = 0; deviceIndex < backend->numDevices; deviceIndex++)
+	{
+		VulkanDevice& device = backend->devices[deviceIndex];
+		if ((device.GetDeviceMask() & deviceMask) == 0)
+		{
+			continue;
+		}
+		uint32 index = device.CreateHeap(desc, name);
+		device.SetRenderBackendHandleRepresentation(handle.GetIndex(), index);
+	}
+	return handle;
+}
+
+static void DestroyHeap(void* instance, RenderBackendHeapHandle handle)
+{
+	VulkanRenderBackend* backend = (VulkanRenderBackend*)instance;
+	uint32 deviceMask = handle.GetDeviceMask();
+	for (uint32 deviceIndex = 0; deviceIndex < backend->numDevices; deviceIndex++)
+	{
+		VulkanDevice& device = backend->devices[deviceIndex];
+		if ((device.GetDeviceMask() & deviceMask) == 0)
+		{
+			continue;
+		}
+		uint32 index = 0;
+		if (!device.TryGetRenderBackendHandleRepresentation(handle.GetIndex(), &index))
+		{
+			continue;
+		}
+		device.DestroyHeap(index);
+		device.RemoveRenderBackendHandleRepresentation(handle.GetIndex());
+	}
+}
+
 static void DestroyTexture(void* instance, RenderBackendTextureHandle handle)
 {
 	VulkanRenderBackend* backend = (VulkanRenderBackend*)instance;
@@ -4562,6 +4832,7 @@ static void SubmitRenderCommandLists(void* instance, RenderCommandList** command
 			continue;
 		}
 		VulkanCommandBuffer* primaryCommandBuffer = device.commandBufferManager->PrepareForNextCommandBuffer();
+		primaryCommandBuffer->submissionIndex = ++device.numSubmissions;
 		submitContext.completeFence = primaryCommandBuffer->fence;
 		vkResetFences(device.GetHandle(), 1, &submitContext.completeFence);
 
@@ -4937,6 +5208,10 @@ namespace HE
 			.DestroyBuffer = DestroyBuffer,
 			.CreateTexture = CreateTexture,
 			.DestroyTexture = DestroyTexture,
+			.GetTextureMemoryRequirements = GetTextureMemoryRequirements,
+			.CreateHeap = CreateHeap,
+			.DestroyHeap = DestroyHeap,
+			.CreatePlacedTexture = CreatePlacedTexture,
 			.CreateTextureSRV = CreateTextureSRV,
 			.GetTextureSRVDescriptorIndex = GetTextureSRVDescriptorIndex,
 			.CreateTextureUAV = CreateTextureUAV,